@@ -0,0 +1,46 @@
+function instance = hhgmax_binary_file_tiled(filename, structure)
+% Backend for the chunked cache format (see tiled_cache.hpp for a description
+% of the file format). Unlike the other backends, it does not provide generic
+% variables but stores the spectra of a z slice in tiles of points x omega,
+% so that single points can be written and omega ranges can be read without
+% transposing the file.
+
+instance.filename = filename;
+instance.header_size = 128;
+
+if exist(filename, 'file')
+  % read dimensions and tile size from file
+  fd = fopen(filename, 'r');
+  magic = fread(fd, 8, 'char=>char')';
+  header = fread(fd, 15, 'uint64=>double');
+  fclose(fd);
+
+  if ~strcmp(magic, 'HHGCACHE') || length(header)~=15
+    error([filename ' is not a tiled cache file']);
+  end
+  if header(1)~=1
+    error([filename ' has an unsupported format version']);
+  end
+
+  instance.xn = header(2);
+  instance.yn = header(3);
+  instance.components = header(4);
+  instance.omegan = header(5);
+  instance.tile_points = header(6);
+  instance.tile_omega = header(7);
+else
+  instance.xn = structure.dimensions.x;
+  instance.yn = structure.dimensions.y;
+  instance.components = structure.dimensions.component;
+  instance.omegan = structure.dimensions.omega;
+
+  % default tile size; small slices are not padded to the full tile size
+  instance.tile_points = max(min(64, instance.xn*instance.yn), 1);
+  instance.tile_omega = max(min(64, instance.omegan), 1);
+end
+
+instance.point_blocks = ceil(instance.xn*instance.yn / instance.tile_points);
+instance.omega_blocks = ceil(instance.omegan / instance.tile_omega);
+instance.tile_size = instance.tile_points*instance.components*instance.tile_omega*2; % in numbers, not bytes
+
+instance = class(instance, 'hhgmax_binary_file_tiled');
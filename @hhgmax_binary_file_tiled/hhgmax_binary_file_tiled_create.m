@@ -0,0 +1,24 @@
+function ret = hhgmax_binary_file_tiled_create(instance)
+
+% open file
+fd = fopen(instance.filename,'w');
+
+% write header
+fwrite(fd, 'HHGCACHE', 'char');
+fwrite(fd, [1 instance.xn instance.yn instance.components instance.omegan instance.tile_points instance.tile_omega 0 zeros(1,7)], 'uint64');
+
+% fill file with zeros
+total_size = instance.omega_blocks * instance.point_blocks * instance.tile_size;
+blocksize = 1024*1024/8; % in numbers, not bytes
+
+numbers_written = 0;
+while numbers_written<total_size
+  write_numbers = min(total_size-numbers_written, blocksize);
+
+  fwrite(fd, zeros([1 write_numbers]), 'double');
+  numbers_written = numbers_written + write_numbers;
+end
+
+fclose(fd);
+
+ret = [];
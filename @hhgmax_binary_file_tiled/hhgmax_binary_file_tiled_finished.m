@@ -0,0 +1,8 @@
+function finished = hhgmax_binary_file_tiled_finished(instance)
+
+fd = fopen(instance.filename,'r');
+fseek(fd, 64, 'bof');
+finished = fread(fd, 1, 'uint64');
+fclose(fd);
+
+finished = length(finished) && finished==1;
@@ -0,0 +1,39 @@
+function data = hhgmax_binary_file_tiled_read_omega(instance, query_start, query_end)
+% returns the spectra of all points for omega indices query_start:query_end
+% as array data(yi,xi,C,omega_i)
+
+points = instance.xn*instance.yn;
+C = instance.components;
+K = query_end-query_start+1;
+
+data_real = nan(points, C, K);
+data_imag = nan(points, C, K);
+
+% open file
+fd = fopen(instance.filename,'r');
+
+for ob=floor((query_start-1)/instance.tile_omega):floor((query_end-1)/instance.tile_omega)
+  % omega indices covered by this block, within the tile and within data
+  omega_i = max(ob*instance.tile_omega+1, query_start) : min((ob+1)*instance.tile_omega, query_end);
+  local = omega_i - ob*instance.tile_omega;
+  target = omega_i - query_start + 1;
+
+  % the tiles of all point blocks of this omega block are consecutive
+  fseek(fd, instance.header_size + ob*instance.point_blocks*instance.tile_size*8, 'bof');
+
+  for pb=0:instance.point_blocks-1
+    tile = fread(fd, instance.tile_size, 'double');
+    tile = reshape(tile, [2 instance.tile_omega C instance.tile_points]);
+
+    p = pb*instance.tile_points + (1:instance.tile_points);
+    valid = find(p<=points);
+
+    data_real(p(valid),:,target) = permute(tile(1,local,:,valid), [4 3 2 1]);
+    data_imag(p(valid),:,target) = permute(tile(2,local,:,valid), [4 3 2 1]);
+  end
+end
+
+% close file
+fclose(fd);
+
+data = reshape(complex(data_real, data_imag), [instance.yn instance.xn C K]);
@@ -0,0 +1,8 @@
+function ret = hhgmax_binary_file_tiled_set_finished(instance)
+
+fd = fopen(instance.filename,'r+');
+fseek(fd, 64, 'bof');
+fwrite(fd, 1, 'uint64');
+fclose(fd);
+
+ret = [];
@@ -0,0 +1,31 @@
+function ret = hhgmax_binary_file_tiled_write_point(instance, xi, yi, d_omega)
+% stores the spectrum d_omega(C,omega_i) of the point (xi,yi)
+
+d_omega = reshape(d_omega, [instance.components instance.omegan]);
+
+% open file
+fd = fopen(instance.filename,'r+');
+
+% point index (yi is fastest) and position within the tiles
+p = (yi-1) + instance.yn*(xi-1);
+pb = floor(p/instance.tile_points);
+p_in = mod(p, instance.tile_points);
+
+% write one run of components x tile_omega values per omega block
+for ob=0:instance.omega_blocks-1
+  omega_i = ob*instance.tile_omega+1 : min((ob+1)*instance.tile_omega, instance.omegan);
+
+  run = zeros(2, instance.tile_omega, instance.components);
+  run(1,1:length(omega_i),:) = permute(real(d_omega(:,omega_i)), [3 2 1]);
+  run(2,1:length(omega_i),:) = permute(imag(d_omega(:,omega_i)), [3 2 1]);
+
+  tile_start = (ob*instance.point_blocks + pb) * instance.tile_size;
+  offset = tile_start + p_in*instance.components*instance.tile_omega*2;
+  fseek(fd, instance.header_size + offset*8, 'bof');
+  fwrite(fd, run, 'double');
+end
+
+% close file
+fclose(fd);
+
+ret = [];
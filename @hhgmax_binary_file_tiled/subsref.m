@@ -0,0 +1,4 @@
+function ret = subsref(instance, idx)
+% map instance.method(...) to classname_method(instance,...)
+
+hhgmax_method_syntax_workaround
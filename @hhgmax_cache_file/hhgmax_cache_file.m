@@ -102,10 +102,16 @@ instance.zv = zv;
 % chose backend
 instance.backend = @hhgmax_binary_file_netcdf; % default
 instance.extension = '.nc';
+instance.tiled = 0;
 if isfield(config, 'backend')
   if strcmpi(config.backend, 'fallback')
     instance.backend = @hhgmax_binary_file_fallback;
     instance.extension = '.dat';
+  elseif strcmpi(config.backend, 'tiled')
+    % stores points x omega tiles in a single file, no transpose step needed
+    instance.backend = @hhgmax_binary_file_tiled;
+    instance.extension = '.hcc';
+    instance.tiled = 1;
   elseif ~strcmpi(config.backend, 'NetCDF')
     error('invalid file cache backend');
   end
@@ -4,6 +4,20 @@ function ret = hhgmax_cache_file_finish_slice(instance, zi)
 filename = fullfile(instance.fast_directory, ['dipole_response_z' num2str(instance.zv(zi)) instance.extension]);
 f = instance.backend(filename, instance.structure);
 
+% the tiled backend needs no transpose step
+if instance.tiled
+  f.set_finished();
+
+  % move to slow storage if fast_directory in use
+  if ~strcmp(instance.directory, instance.fast_directory)
+    destination = fullfile(instance.directory, ['dipole_response_z' num2str(instance.zv(zi)) instance.extension]);
+    movefile(filename, destination);
+  end
+
+  ret = [];
+  return
+end
+
 % set finished flag
 f.write('finished', 1, 1);
 
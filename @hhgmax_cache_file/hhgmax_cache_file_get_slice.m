@@ -5,6 +5,24 @@ dims = instance.structure.dimensions;
 data_size = [dims.y,dims.x,dims.component,query_end-query_start+1];
 slice_data = complex(nan(data_size), nan(data_size));
 
+% the tiled backend can be read directly by omega range
+if instance.tiled
+  filename = fullfile(instance.directory, ['dipole_response_z' num2str(instance.zv(zi)) instance.extension]);
+  if ~exist(filename, 'file')
+    slice_data = [];
+    return
+  end
+
+  f = instance.backend(filename, instance.structure);
+  if ~f.finished()
+    slice_data = [];
+    return
+  end
+
+  slice_data = f.read_omega(query_start, query_end);
+  return
+end
+
 % open file
 filename_t = fullfile(instance.directory, ['dipole_response_z' num2str(instance.zv(zi)) '_transposed' instance.extension]);
 f_t = instance.backend(filename_t, instance.structure_t);
@@ -21,7 +21,17 @@ resources.ram = max(min(instance.transpose_RAM, slice_size), omegan*components*8
   % consume the configured size of transpose RAM, but at most slice_size.
   % set_point will consume some RAM because of taking real/imaginary part.
 
-if strcmp(instance.directory, instance.fast_directory)
+if instance.tiled
+  % no transpose step, set_point and get_slice work on single tiles
+  resources.ram = omegan*components*8*2;
+  if strcmp(instance.directory, instance.fast_directory)
+    resources.disk_fast = 0;
+    resources.disk_slow = slice_size*zn;
+  else
+    resources.disk_fast = slice_size;
+    resources.disk_slow = slice_size*zn;
+  end
+elseif strcmp(instance.directory, instance.fast_directory)
   resources.disk_fast = 0;
   resources.disk_slow = slice_size*zn + slice_size;
     % +slice_size for transpose step
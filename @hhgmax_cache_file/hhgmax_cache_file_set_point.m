@@ -9,6 +9,13 @@ if ~exist(filename, 'file')
   f.create()
 end
 
+% the tiled backend stores whole points
+if instance.tiled
+  f.write_point(xi, yi, d_omega);
+  ret = [];
+  return
+end
+
 % get dimensions
 omegan = instance.structure.dimensions.omega;
 components = instance.structure.dimensions.component;
@@ -0,0 +1,50 @@
+/*
+
+Command line program computing the dipole response for all points of the
+x/y/z grid, like hhgmax_dipole_response.m with the config.precomputed_driving_field
+option (or with the gh_driving_field and plane_wave_driving_field driving
+fields, which are generated natively), but without Matlab/Octave. The spectra are written to the cache
+directory, from which hhgmax_dipole_response.m (called with the same config)
+and the other modules can read them. See dipole_response.hpp and the
+documentation (doc/source/reference/native_dipole_response.rst).
+
+Usage:
+  ./dipole_response [--worker | --propagate] config.txt
+
+With --worker, several instances (on one machine or on several nodes sharing
+the cache directory) divide the points among themselves through a work queue
+in the cache directory, see work_queue.hpp. With --propagate, only the
+integration along z of the propagation.* options is done, for slices that are
+all in the cache already, see propagation.hpp.
+
+Compilation for Linux:
+  # g++ -o dipole_response dipole_response.cpp -fopenmp -O3 -ansi
+or just `make`.
+
+*/
+
+#include "dipole_response.hpp"
+
+int main(int argc, char **argv) {
+  bool worker = argc==3 && !strcmp(argv[1], "--worker");
+  bool propagate = argc==3 && !strcmp(argv[1], "--propagate");
+  if (argc!=2 && !worker && !propagate) {
+    fprintf(stderr, "usage: %s [--worker | --propagate] config_file\n", argv[0]);
+    return 2;
+  }
+
+  dipole_response_config config;
+  if (!config.read(argv[argc-1])) {
+    fprintf(stderr, "error: %s\n", config.get_error().c_str());
+    return 1;
+  }
+
+  dipole_response driver(config);
+  bool ok = worker ? driver.run_worker() : propagate ? driver.run_propagation() : driver.run();
+  if (!ok) {
+    fprintf(stderr, "error: %s\n", driver.get_error().c_str());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,1432 @@
+// This file implements the pipeline of hhgmax_dipole_response.m natively, for
+// driving fields that are precomputed and saved to disk (see the
+// config.precomputed_driving_field option of hhgmax_dipole_response.m) or
+// generated natively for the driving fields of hhgmax_gh_driving_field.m and
+// hhgmax_plane_wave_driving_field.m, see driving_field.hpp:
+// for all points of the x/y/z grid, the dipole response is computed with the
+// Lewenstein model, windowed and Fourier transformed, and the spectra are
+// written to the cache directory in the format of the 'fallback' or 'tiled'
+// backend of hhgmax_cache, so that hhgmax_dipole_response.m (with the same
+// config) and the other Matlab/Octave modules can read them. Optionally, the
+// slices are integrated along z as in hhgmax_harmonic_propagation.m as soon
+// as they are available, see propagation.hpp, and the far field of the
+// result is computed, see farfield.hpp.
+// The configuration is read from a text file, see dipole_response.cpp.
+
+// include guard
+#ifndef DIPOLE_RESPONSE_HPP
+#define DIPOLE_RESPONSE_HPP
+
+#include "lewenstein.hpp"
+#include "spectrum.hpp"
+#include "matfile.hpp"
+#include "tiled_cache.hpp"
+#include "work_queue.hpp"
+#include "propagation.hpp"
+#include "farfield.hpp"
+#include "driving_field.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// number of points whose driving fields are passed to the Lewenstein model at
+// once; limits the memory needed for the intermediate arrays
+#define DIPOLE_RESPONSE_BATCH 64
+
+// Configuration given as text file with one `key = value` assignment per
+// line. Values can be numbers, strings in single or double quotes, or
+// matrices in Matlab syntax like [1 2; 3 4]. Keys can contain dots to set
+// fields of sub-structs, e.g. cache.directory = 'cache'. Everything after #
+// or % is a comment. The config is stored as struct, so that it can be saved
+// as config variable of the cache metadata.
+class dipole_response_config {
+  private:
+    matfile_value root;
+    string error;
+
+    static string trim(const string &s) {
+      size_t begin = s.find_first_not_of(" \t\r\n");
+      if (begin==string::npos) return "";
+      size_t end = s.find_last_not_of(" \t\r\n");
+      return s.substr(begin, end-begin+1);
+    }
+
+    // parses a number; returns false if s is not a number
+    static bool parse_number(const string &s, double &value) {
+      if (s.empty()) return false;
+      char *end;
+      value = strtod(s.c_str(), &end);
+      return *end==0;
+    }
+
+    bool parse_value(const string &s, matfile_value &value) {
+      double number;
+
+      if (s.size()>=2 && (s[0]=='\'' || s[0]=='"') && s[s.size()-1]==s[0]) {
+        value = matfile_value::string_value(s.substr(1, s.size()-2));
+        return true;
+      }
+
+      if (s.size()>=2 && s[0]=='[' && s[s.size()-1]==']') {
+        // split into rows and columns
+        vector<vector<double> > rows;
+        string body = s.substr(1, s.size()-2) + ";";
+        size_t start = 0, end;
+        while ((end = body.find(';', start))!=string::npos) {
+          string row = body.substr(start, end-start);
+          for (size_t i=0; i<row.size(); i++) if (row[i]==',') row[i] = ' ';
+
+          vector<double> columns;
+          size_t pos = 0;
+          while (pos<row.size()) {
+            size_t token_start = row.find_first_not_of(" \t", pos);
+            if (token_start==string::npos) break;
+            size_t token_end = row.find_first_of(" \t", token_start);
+            if (token_end==string::npos) token_end = row.size();
+            if (!parse_number(row.substr(token_start, token_end-token_start), number)) return false;
+            columns.push_back(number);
+            pos = token_end;
+          }
+          if (!columns.empty()) rows.push_back(columns);
+          start = end+1;
+        }
+
+        // store in column-major order
+        value = matfile_value();
+        value.dims.push_back((int)rows.size());
+        value.dims.push_back(rows.empty() ? 0 : (int)rows[0].size());
+        for (int col=0; col<value.dims[1]; col++) {
+          for (int row=0; row<value.dims[0]; row++) {
+            if ((int)rows[row].size()!=value.dims[1]) return false;
+            value.real.push_back(rows[row][col]);
+          }
+        }
+        return true;
+      }
+
+      if (parse_number(s, number)) {
+        value = matfile_value::scalar(number);
+        return true;
+      }
+
+      // unquoted strings
+      value = matfile_value::string_value(s);
+      return true;
+    }
+
+    void set(const string &key, const matfile_value &value) {
+      matfile_value *node = &root;
+      size_t start = 0, dot;
+      while ((dot = key.find('.', start))!=string::npos) {
+        node = &member(*node, key.substr(start, dot-start), true);
+        start = dot+1;
+      }
+      member(*node, key.substr(start), false) = value;
+    }
+
+    static matfile_value &member(matfile_value &node, const string &name, bool is_struct) {
+      for (size_t i=0; i<node.field_names.size(); i++) {
+        if (node.field_names[i]==name) {
+          if (is_struct && node.fields[i].kind!=matfile_value::STRUCT) node.fields[i] = matfile_value::struct_value();
+          return node.fields[i];
+        }
+      }
+      node.field_names.push_back(name);
+      node.fields.push_back(is_struct ? matfile_value::struct_value() : matfile_value());
+      return node.fields.back();
+    }
+
+  public:
+    dipole_response_config() {
+      root = matfile_value::struct_value();
+    };
+
+    // reads the config file; returns false on error
+    bool read(const string &filename) {
+      FILE *fd = fopen(filename.c_str(), "r");
+      if (!fd) {
+        error = "cannot open " + filename;
+        return false;
+      }
+
+      char line_buffer[65536];
+      int line_number = 0;
+      while (fgets(line_buffer, sizeof(line_buffer), fd)) {
+        line_number++;
+        string line = line_buffer;
+
+        // strip comments outside of quotes
+        char quote = 0;
+        for (size_t i=0; i<line.size(); i++) {
+          if (quote) {
+            if (line[i]==quote) quote = 0;
+          }
+          else if (line[i]=='\'' || line[i]=='"') quote = line[i];
+          else if (line[i]=='#' || line[i]=='%') {
+            line = line.substr(0, i);
+            break;
+          }
+        }
+
+        line = trim(line);
+        if (line.empty()) continue;
+        if (line[line.size()-1]==';') line = trim(line.substr(0, line.size()-1));
+
+        size_t equals = line.find('=');
+        matfile_value value;
+        if (equals==string::npos || !parse_value(trim(line.substr(equals+1)), value)) {
+          char number[32];
+          sprintf(number, "%d", line_number);
+          error = filename + ", line " + number + ": syntax error";
+          fclose(fd);
+          return false;
+        }
+
+        set(trim(line.substr(0, equals)), value);
+      }
+
+      fclose(fd);
+      return true;
+    };
+
+    // returns the value for the given key (which may contain dots), or 0
+    const matfile_value *get(const string &key) const {
+      const matfile_value *node = &root;
+      size_t start = 0, dot;
+      while (node && (dot = key.find('.', start))!=string::npos) {
+        node = node->field(key.substr(start, dot-start));
+        start = dot+1;
+      }
+      return node ? node->field(key.substr(start)) : 0;
+    };
+
+    bool has(const string &key) const {
+      return get(key)!=0;
+    };
+
+    double number(const string &key, double default_value) const {
+      const matfile_value *value = get(key);
+      if (!value || value->kind!=matfile_value::NUMERIC || value->real.empty()) return default_value;
+      return value->real[0];
+    };
+
+    string text(const string &key, const string &default_value) const {
+      const matfile_value *value = get(key);
+      if (!value || value->kind!=matfile_value::CHAR) return default_value;
+      return value->text;
+    };
+
+    const matfile_value &get_struct() const {
+      return root;
+    };
+
+    const string &get_error() const {
+      return error;
+    };
+};
+
+// computes the dipole responses of a batch of points, with one of the
+// lewenstein_plan instantiations chosen at runtime
+class dipole_response_kernel {
+  public:
+    virtual ~dipole_response_kernel() {};
+
+    // Et - points x N x dim, at - points x N or 0 (no ground state depletion,
+    // unless the ionization rate was given), output like Et
+    virtual void execute(int points, double *Et, double *at, double *output) = 0;
+};
+
+// evaluates the integrand with type Type and sums up with type Acc; for
+// Acc=float, the arguments are converted
+template <int dim, typename Type, typename Acc>
+class dipole_response_kernel_H : public dipole_response_kernel {
+  private:
+    int N;
+    dipole_elements_H<dim,Type> dp;
+    lewenstein_plan<dim,Type,dipole_elements_H<dim,Type>,Acc> *plan;
+
+  public:
+    dipole_response_kernel_H(int n, double *t, int weights_length, double *weights, double ip, double epsilon_t, double alpha, const vector<int> &nodes, bool filon, bool periodic, simd_accuracy accuracy, const ionization_rate_table *ionization) : dp(Type(alpha)) {
+      N = n;
+      vector<Acc> t_acc(t, t+N);
+      vector<Acc> weights_acc(weights, weights+weights_length);
+      plan = new lewenstein_plan<dim,Type,dipole_elements_H<dim,Type>,Acc>(N, &t_acc[0], weights_length, &weights_acc[0], Acc(ip), Acc(epsilon_t), dp, (int)nodes.size(), nodes.empty() ? 0 : &nodes[0], filon, periodic);
+      plan->set_accuracy(accuracy);
+      plan->set_ionization_rate(ionization);
+    };
+
+    ~dipole_response_kernel_H() {
+      delete plan;
+    };
+
+    void execute(int points, double *Et, double *at, double *output) {
+      vector<Acc> Et_acc(Et, Et+points*N*dim);
+      vector<Acc> at_acc;
+      if (at) at_acc.assign(at, at+points*N);
+      vector<Acc> output_acc(points*N*dim);
+
+      plan->execute(points, &Et_acc[0], at ? &at_acc[0] : 0, N, &output_acc[0]);
+
+      for (int i=0; i<points*N*dim; i++) output[i] = output_acc[i];
+    };
+};
+
+template <int dim>
+dipole_response_kernel *dipole_response_create_kernel(const string &precision, int N, double *t, int weights_length, double *weights, double ip, double epsilon_t, double alpha, const vector<int> &nodes, bool filon, bool periodic, simd_accuracy accuracy, const ionization_rate_table *ionization) {
+  if (precision=="single") return new dipole_response_kernel_H<dim,float,float>(N, t, weights_length, weights, ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+  if (precision=="mixed") return new dipole_response_kernel_H<dim,float,double>(N, t, weights_length, weights, ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+  return new dipole_response_kernel_H<dim,double,double>(N, t, weights_length, weights, ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+}
+
+// string representation of numbers as given by Matlab's num2str, which is
+// used for the file names of the cache
+inline string matlab_num2str(double x) {
+  char buffer[64];
+  if (x==floor(x) && fabs(x)<1e15) {
+    sprintf(buffer, "%.0f", x==0 ? 0.0 : x);
+  }
+  else {
+    int digits = (int)floor(log10(fabs(x)));
+    digits = max(digits+5, 5);
+    if (digits>16) digits = 16;
+    sprintf(buffer, "%.*g", digits, x);
+  }
+  return buffer;
+}
+
+// conversion of scaled atomic units to SI units (see hhgmax_sau_convert.m);
+// wavelength in millimeters
+struct dipole_response_units {
+  double t, U, E;
+
+  dipole_response_units(double wavelength) {
+    const double pi = 4.0*atan(1.0);
+    const double c = 299792458;
+    const double hbar = 1.054571726e-34;
+    const double eq = 1.602176565e-19;
+    const double a0 = 5.2917721092e-11;
+    const double Ry = 13.60569253*eq;
+
+    t = (wavelength*1e-3) / c / (2*pi);
+    U = hbar / t;
+    double s = a0 * sqrt(2*Ry/U);
+    E = U / eq / s;
+  };
+};
+
+class dipole_response {
+  private:
+    const dipole_response_config &config;
+    string error;
+
+    // axes
+    vector<double> t_cmc, xv, yv, zv, ax_zv;
+    matfile_value xv_value, yv_value;
+    double zv_precision;
+    double t0, deltat;
+
+    // setup
+    int components;
+    int fft_length;
+    vector<double> weights, t_window, omega;
+    vector<int> cache_keep;
+    int cache_xn, cache_yn;
+    vector<int> cache_yi;
+    int symmetry_x, symmetry_y, symmetry_rotational;
+    ionization_rate_table *ionization;
+    dipole_response_kernel *kernel;
+    bool tiled;
+    harmonic_propagation *propagation;
+    gh_driving_field *generator;
+
+    // output of the current slice, see begin_slice
+    tiled_cache_file slice_file;
+    vector<complex<double> > slice_data;
+
+    // work queue and the block currently computed, for renewing its lease
+    work_queue *queue;
+    string lease;
+
+    // progress
+    int points_computed, points_effective;
+    time_t time_start, last_status;
+
+    bool fail(const string &message) {
+      error = message;
+      return false;
+    }
+
+    static string join(const string &directory, const string &filename) {
+      if (directory.empty()) return filename;
+      char last = directory[directory.size()-1];
+      if (last=='/' || last=='\\') return directory + filename;
+      return directory + "/" + filename;
+    }
+
+    static bool file_exists(const string &filename) {
+      struct stat info;
+      return stat(filename.c_str(), &info)==0;
+    }
+
+    // the axes are read from the axes.mat file of the precomputed driving
+    // field, or from the file given by the axes option
+    bool load_axes() {
+      string directory = config.text("precomputed_driving_field", "");
+      string filename = config.text("axes", directory.empty() ? "" : join(directory, "axes.mat"));
+      if (filename.empty()) return fail("config needs a precomputed_driving_field option, or an axes option for natively generated driving fields");
+
+      matfile_reader reader;
+      vector<string> names;
+      vector<matfile_value> values;
+      if (!reader.read(filename, names, values)) return fail(reader.get_error());
+
+      bool found_t = false, found_x = false, found_y = false, found_z = false;
+      zv_precision = 1e-6;
+      for (size_t i=0; i<names.size(); i++) {
+        if (names[i]=="t_cmc") { t_cmc = values[i].real; found_t = true; }
+        if (names[i]=="xv") { xv = values[i].real; xv_value = values[i]; found_x = true; }
+        if (names[i]=="yv") { yv = values[i].real; yv_value = values[i]; found_y = true; }
+        if (names[i]=="zv") { ax_zv = values[i].real; found_z = true; }
+        if (names[i]=="zv_precision") zv_precision = values[i].real[0];
+      }
+      // the zv variable is only needed for precomputed driving fields
+      const matfile_value *zv_config = config.get("zv");
+      if (!found_z && !directory.empty()) return fail("axes.mat must contain t_cmc, xv, yv and zv");
+      if (!found_t || !found_x || !found_y || (!found_z && !zv_config)) return fail(filename + " must contain t_cmc, xv, yv and zv (or give a zv option)");
+      if (t_cmc.size()<2) return fail("t_cmc must have at least two elements");
+
+      // by default, all z slices are computed
+      zv = zv_config ? zv_config->real : ax_zv;
+
+      return true;
+    }
+
+    // sets up the native generator for the driving_field option, with the
+    // options of hhgmax_pulse.m for the pulse and of hhgmax_gh_mode.m for the
+    // modes; must be called before the time axis is shifted, as the pulse is
+    // defined on the original t_cmc axis
+    bool setup_driving_field() {
+      string name = config.text("driving_field", "");
+      if (name.empty()) return fail("config needs a precomputed_driving_field or a driving_field option");
+      // like hhgmax_dipole_response.m, *.name stands for hhgmax_name
+      size_t dot = name.find('.');
+      if (dot!=string::npos) name = "hhgmax_" + name.substr(dot+1);
+      if (name.substr(0, 7)=="hhgmax_") name = name.substr(7);
+      const bool plane_wave = name=="plane_wave_driving_field";
+      if (name!="gh_driving_field" && !plane_wave) return fail("only precomputed driving fields and the gh_driving_field and plane_wave_driving_field driving fields are supported");
+
+      if (!config.has("peak_intensity")) return fail("config needs a peak_intensity option");
+      dipole_response_units units(config.number("wavelength", 0));
+
+      pulse_parameters pulse;
+      pulse.shape = config.text("pulse_shape", pulse.shape);
+      for (size_t i=0; i<pulse.shape.size(); i++) pulse.shape[i] = (char)tolower(pulse.shape[i]);
+      pulse.carrier = config.text("carrier", pulse.carrier);
+      pulse.elliptical = config.has("ellipticity");
+      pulse.ellipticity = config.number("ellipticity", 0);
+      pulse.ce_phase = config.number("ce_phase", 0);
+      if (pulse.shape!="constant") {
+        if (!config.has("pulse_duration")) return fail("config needs a pulse_duration option for pulse shape " + pulse.shape);
+        pulse.fwhm = config.number("pulse_duration", 0)*1e-15 / units.t;
+        if (t_cmc[0]/(pulse.fwhm/2)>-2.5) fprintf(stderr, "warning: lower limit of t interval might cut pulse\n");
+        if (t_cmc[t_cmc.size()-1]/(pulse.fwhm/2)<2.5) fprintf(stderr, "warning: upper limit of t interval might cut pulse\n");
+      }
+
+      vector<double> pulse_omega;
+      vector<complex<double> > coefficients;
+      int pulse_components;
+      string message = pulse_coefficients(t_cmc, pulse, pulse_omega, coefficients, pulse_components);
+      if (!message.empty()) return fail(message);
+      if (pulse_components!=components) return fail("components must be " + matlab_num2str(pulse_components) + (pulse.elliptical ? " for elliptical" : " for linear") + " polarization");
+      if (t_cmc.size()<3) return fail("omega axis should go from -pi/N/dt to +pi/N/dt");
+
+      const double E0 = sqrt(2 * config.number("peak_intensity", 0)*1e4 / 299792458 / 8.854187817e-12) / units.E;
+
+      vector<int> mode_n, mode_m;
+      vector<double> mode_coefficients;
+      double rotation[9];
+      bool rotated = false;
+      double beam_waist = 0;
+      if (!plane_wave) {
+        if (!config.has("beam_waist")) return fail("config needs a beam_waist option");
+        beam_waist = config.number("beam_waist", 0);
+        if (!(beam_waist>0)) return fail("beam_waist must be positive");
+
+        if (config.has("mode")) {
+          if (!gh_mode_coefficients(config.text("mode", ""), mode_n, mode_m, mode_coefficients)) return fail("unknown mode name");
+        }
+        else {
+          if (!config.has("mode_n") || !config.has("mode_m") || !config.has("mode_coefficients")) return fail("config needs a mode option, or mode_n, mode_m and mode_coefficients options");
+          const vector<double> &n = config.get("mode_n")->real, &m = config.get("mode_m")->real;
+          mode_coefficients = config.get("mode_coefficients")->real;
+          if (n.size()!=mode_coefficients.size() || m.size()!=mode_coefficients.size()) return fail("mode_n, mode_m and mode_coefficients must have the same length");
+          for (size_t i=0; i<n.size(); i++) {
+            if (n[i]<0 || m[i]<0 || n[i]!=floor(n[i]) || m[i]!=floor(m[i])) return fail("mode_n and mode_m must be non-negative integers");
+            mode_n.push_back((int)n[i]);
+            mode_m.push_back((int)m[i]);
+          }
+        }
+
+        const matfile_value *rotation_value = config.get("rotation");
+        if (rotation_value) {
+          if (rotation_value->dims.size()!=2 || rotation_value->dims[0]!=3 || rotation_value->dims[1]!=3) return fail("rotation must be a 3x3 matrix");
+          for (int i=0; i<9; i++) rotation[i] = rotation_value->real[i];
+          rotated = true;
+        }
+      }
+
+      const int modes = (int)mode_coefficients.size();
+      generator = new gh_driving_field((int)t_cmc.size(), &pulse_omega[0], components, &coefficients[0], E0,
+        config.number("wavelength", 0), beam_waist, modes, modes ? &mode_n[0] : 0, modes ? &mode_m[0] : 0, modes ? &mode_coefficients[0] : 0, rotated ? rotation : 0);
+
+      return true;
+    }
+
+    bool setup() {
+      const double pi = 4.0*atan(1.0);
+
+      if (!config.has("wavelength")) return fail("config needs a wavelength option");
+      if (!config.has("ionization_potential")) return fail("config needs an ionization_potential option");
+      if (config.has("ionization_fraction")) return fail("the ionization_fraction option needs a Matlab callback, use static_ionization_rate or tong_lin_ionization instead");
+
+      dipole_response_units units(config.number("wavelength", 0));
+      components = (int)config.number("components", 1);
+      if (components<1 || components>3) return fail("components must be 1, 2 or 3");
+
+      delete generator;
+      generator = 0;
+      if (!config.has("precomputed_driving_field") && !setup_driving_field()) return false;
+
+      // shift time axis to zero
+      t0 = t_cmc[0];
+      for (size_t i=0; i<t_cmc.size(); i++) t_cmc[i] -= t0;
+      deltat = t_cmc[1];
+      int N = (int)t_cmc.size();
+
+      // weights for tau integration
+      double tau_interval_length = config.number("tau_interval_length", 0);
+      double tau_window_length = config.number("tau_window_length", 0);
+      int tau_interval_pts = 0, tau_window_pts = 0;
+      for (int i=0; i<N; i++) {
+        if (t_cmc[i]<=2*pi*tau_interval_length) tau_interval_pts++;
+        if (t_cmc[i]<2*pi*tau_window_length) tau_window_pts++;
+      }
+      weights.assign(tau_interval_pts+tau_window_pts, 1.0);
+      double tau_window_factor = tau_window_pts!=1 ? pi/2 / (tau_window_pts-1) : 0.5;
+      for (int i=0; i<tau_window_pts; i++) weights[tau_interval_pts+i] *= SQR(cos(tau_window_factor*i));
+
+      // omega axis and data reduction (see hhgmax_get_omega_axis.m)
+      double domega = 2*pi/deltat/N;
+      vector<double> omega_full(N);
+      for (int i=0; i<N; i++) omega_full[i] = (i>N/2.0 ? i-N : i) * domega;
+
+      bool raw = config.number("raw", 0)!=0;
+      const matfile_value *omega_ranges = config.get("omega_ranges");
+      cache_keep.clear();
+      if (omega_ranges) {
+        if (raw) return fail("omega_ranges option not possible in raw mode");
+        if (omega_ranges->dims.size()!=2 || omega_ranges->dims[1]!=2) return fail("omega_ranges must have two columns");
+
+        double omega_max = omega_full[0];
+        for (int i=0; i<N; i++) omega_max = max(omega_max, omega_full[i]);
+
+        int ranges = omega_ranges->dims[0];
+        for (int r=0; r<ranges; r++) {
+          double from = omega_ranges->real[r], to = omega_ranges->real[ranges+r];
+          if (to>omega_max) return fail("need finer t axis to be able to give data for omega_ranges");
+          for (int i=0; i<N; i++) if (omega_full[i]>=from && omega_full[i]<=to) cache_keep.push_back(i);
+        }
+      }
+      else {
+        for (int i=0; i<N; i++) if (raw || omega_full[i]>=0) cache_keep.push_back(i);
+      }
+      omega.resize(cache_keep.size());
+      for (size_t i=0; i<cache_keep.size(); i++) omega[i] = omega_full[cache_keep[i]];
+
+      // periodic mode: the kernel computes d(t) for one period, with t-tau
+      // wrapping around into the preceding periods
+      double t_window_length;
+      fft_length = N;
+      if (config.number("periodic", 0)) {
+        if (fabs(t_cmc[N-1]+deltat - 2*pi)>1e-15) return fail("for periodic mode, time axis must be a periodically continuable subdivision of the [0,2*pi) interval");
+        if (config.number("t_window_length", 0)!=0) return fail("for periodic mode, t_window_length must be zero");
+        t_window_length = 0;
+      }
+      else {
+        t_window_length = config.number("t_window_length", 0);
+        if ((int)weights.size()>N) fprintf(stderr, "warning: tau_interval_length + tau_window_length is longer than considered time interval\n");
+      }
+
+      // window for d(t)
+      int t_window_pts = 0;
+      for (size_t i=0; i<t_cmc.size(); i++) if (t_cmc[i]<2*pi*t_window_length) t_window_pts++;
+      double t_window_factor = t_window_pts!=1 ? pi/2 / (t_window_pts-1) : 0.5;
+      t_window.resize(t_window_pts);
+      for (int i=0; i<t_window_pts; i++) t_window[i] = SQR(cos(t_window_factor*i));
+
+      // symmetry
+      string symmetry = config.text("symmetry", "");
+      symmetry_x = symmetry_y = symmetry_rotational = 0;
+      if (symmetry=="x" || symmetry=="X") symmetry_x = 1;
+      else if (symmetry=="y" || symmetry=="Y") symmetry_y = 1;
+      else if (symmetry=="xy" || symmetry=="XY") symmetry_x = symmetry_y = 1;
+      else if (symmetry=="rotational") symmetry_x = symmetry_y = symmetry_rotational = 1;
+      else if (!symmetry.empty() || config.number("symmetry", 0)) return fail("symmetry must be one of 'x', 'y', 'xy', 'rotational' or a false value");
+
+      int xn = (int)xv.size(), yn = (int)yv.size();
+      for (int i=0; i<xn && symmetry_x; i++) {
+        if (fabs(xv[i]+xv[xn-1-i])>=1e-10 || xn%2==0) return fail("x axis must be symmetric and contain 0 due to symmetry setting");
+      }
+      for (int i=0; i<yn && symmetry_y; i++) {
+        if (fabs(yv[i]+yv[yn-1-i])>=1e-10 || yn%2==0) return fail("y axis must be symmetric and contain 0 due to symmetry setting");
+      }
+
+      cache_xn = symmetry_x ? (xn-1)/2 + 1 : xn;
+      cache_yn = symmetry_y ? (yn-1)/2 + 1 : yn;
+      cache_yi.clear();
+      if (symmetry_rotational) {
+        int y0 = 0;
+        for (int i=0; i<yn; i++) if (fabs(yv[i])<fabs(yv[y0])) y0 = i;
+        cache_yn = 1;
+        cache_yi.push_back(y0);
+      }
+      else {
+        for (int i=0; i<cache_yn; i++) cache_yi.push_back(i);
+      }
+
+      // static ionization rates, converted to scaled atomic units, or the
+      // Tong-Lin formula (see hhgmax_tong_lin_ionization_rate.m); the ground
+      // state amplitude is computed from them by the Lewenstein plan
+      if (config.has("static_ionization_rate")) {
+        if (config.number("periodic", 0)) return fail("you cannot specify ionization rates for periodic mode");
+        if (!config.has("static_ionization_rate_field")) return fail("you need to specify a E axis for your ionization rates using the static_ionization_rate_field option");
+
+        vector<double> irate = config.get("static_ionization_rate")->real;
+        vector<double> irate_E = config.get("static_ionization_rate_field")->real;
+        if (irate.size()!=irate_E.size() || irate.size()<2) return fail("static_ionization_rate and static_ionization_rate_field must have the same length");
+        for (size_t i=0; i<irate.size(); i++) {
+          irate[i] *= units.t;
+          irate_E[i] /= units.E;
+        }
+        ionization = new ionization_rate_table((int)irate.size(), &irate_E[0], &irate[0]);
+      }
+      else if (config.has("tong_lin_ionization")) {
+        if (config.number("periodic", 0)) return fail("you cannot specify ionization rates for periodic mode");
+
+        tong_lin_parameters p;
+        string atom = config.text("tong_lin_ionization.atom", "");
+        if (!atom.empty()) {
+          if (!tong_lin_atom(atom, p)) return fail("tong_lin_ionization.atom " + atom + " is not implemented");
+        }
+        else {
+          if (!config.has("tong_lin_ionization.C") || !config.has("tong_lin_ionization.l") || !config.has("tong_lin_ionization.ionization_potential")) {
+            return fail("tong_lin_ionization needs an atom option, or C, l and ionization_potential options");
+          }
+          p.C = config.number("tong_lin_ionization.C", 0);
+          p.l = (int)config.number("tong_lin_ionization.l", 0);
+          p.ip = config.number("tong_lin_ionization.ionization_potential", 0);
+          p.Z = config.number("tong_lin_ionization.Z", 1);
+        }
+        p.m = (int)config.number("tong_lin_ionization.m", 0);
+        p.alpha = config.number("tong_lin_ionization.alpha", p.alpha);
+
+        // the table covers field strengths up to 0.5 atomic units
+        double E_unit, t_unit;
+        ionization_sau_units(config.number("wavelength", 0), E_unit, t_unit);
+        ionization = new ionization_rate_table(p, 0.5/E_unit, E_unit, t_unit);
+      }
+
+      // number of threads of all parallel regions, and the CPUs they are
+      // bound to (see threads.hpp), as config.threads and config.cpus of
+      // hhgmax_lewenstein.cpp
+      int threads = (int)config.number("threads", 0);
+      if (threads<0) return fail("threads must not be negative");
+      lewenstein_set_threads(threads);
+#ifdef _OPENMP
+      if (threads>0) omp_set_num_threads(threads);
+#endif
+      vector<int> cpus;
+      if (config.has("cpus")) {
+        const vector<double> &cpus_option = config.get("cpus")->real;
+        for (size_t i=0; i<cpus_option.size(); i++) {
+          if (cpus_option[i]<0) return fail("cpus must not be negative");
+          cpus.push_back((int)cpus_option[i]);
+        }
+      }
+      if (!lewenstein_set_affinity((int)cpus.size(), cpus.empty() ? 0 : &cpus[0])) return fail("cpus is only supported on Linux");
+
+      // Lewenstein model, with hydrogen-like dipole elements as in
+      // hhgmax_dipole_response.m
+      string precision = config.text("precision", "double");
+      if (precision!="double" && precision!="single" && precision!="mixed") return fail("precision must be one of 'double', 'single' or 'mixed'");
+
+      double ip = config.number("ionization_potential", 0)*1.602176565e-19 / units.U;
+      double alpha = config.has("alpha") ? config.number("alpha", 2)*ip : 2*ip;
+      double epsilon_t = config.number("epsilon_t", 1e-4);
+      bool periodic = config.number("periodic", 0)!=0;
+
+      // optional graded tau grid, as in hhgmax_lewenstein.cpp
+      string tau_quadrature = config.text("tau_quadrature", "trapezoid");
+      if (tau_quadrature!="trapezoid" && tau_quadrature!="filon") return fail("tau_quadrature must be one of 'trapezoid' or 'filon'");
+      int tau_grid_stride = (int)config.number("tau_grid_stride", 1);
+      vector<int> nodes;
+      if (tau_grid_stride>1 && N>1) {
+        int fine = (int)ceil(config.number("tau_grid_fine", 0.5)*2*pi/t_cmc[1]);
+        nodes.resize(lewenstein_graded_nodes((int)weights.size(), fine, tau_grid_stride, 0));
+        lewenstein_graded_nodes((int)weights.size(), fine, tau_grid_stride, &nodes[0]);
+      }
+      bool filon = tau_quadrature=="filon";
+      double tolerance = config.number("accuracy", 0);
+      if (!(tolerance>=0)) return fail("accuracy must not be negative");
+      simd_accuracy accuracy = simd_accuracy_for(tolerance);
+
+      if (components==1) kernel = dipole_response_create_kernel<1>(precision, N, &t_cmc[0], (int)weights.size(), &weights[0], ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+      else if (components==2) kernel = dipole_response_create_kernel<2>(precision, N, &t_cmc[0], (int)weights.size(), &weights[0], ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+      else kernel = dipole_response_create_kernel<3>(precision, N, &t_cmc[0], (int)weights.size(), &weights[0], ip, epsilon_t, alpha, nodes, filon, periodic, accuracy, ionization);
+
+      return true;
+    }
+
+    // creates the cache directory and its metadata file (see hhgmax_cache_file.m)
+    bool setup_cache() {
+      string directory = config.text("cache.directory", "");
+      if (directory.empty()) return fail("config needs a cache.directory option");
+      string backend = config.text("cache.backend", "NetCDF");
+      if (backend!="fallback" && backend!="tiled") return fail("only cache.backend = 'fallback' or 'tiled' is supported");
+      tiled = backend=="tiled";
+
+      if (!file_exists(directory)) {
+#ifdef _WIN32
+        if (mkdir(directory.c_str())) return fail("cannot create " + directory);
+#else
+        if (mkdir(directory.c_str(), 0777)) return fail("cannot create " + directory);
+#endif
+      }
+
+      string filename = join(directory, "metadata.mat");
+      if (!file_exists(filename)) {
+        matfile_writer writer;
+        writer.add("omega", matfile_value::row(omega));
+        writer.add("xv", xv_value);
+        writer.add("yv", yv_value);
+        writer.add("config", config.get_struct());
+        writer.add("symmetry_x", matfile_value::scalar(symmetry_x));
+        writer.add("symmetry_y", matfile_value::scalar(symmetry_y));
+        writer.add("symmetry_rotational", matfile_value::scalar(symmetry_rotational));
+        if (!writer.write(filename)) return fail("cannot write " + filename);
+      }
+
+      return true;
+    }
+
+    // sets up the integration along z of the propagation.* options, if given
+    bool setup_propagation() {
+      if (!config.has("propagation")) return true;
+      if (components>2) return fail("propagation of 3-dimensionally polarized harmonics not supported");
+
+      double density;
+      if (config.has("propagation.density")) density = config.number("propagation.density", 0)*1e9;
+      else if (config.has("propagation.pressure")) density = config.number("propagation.pressure", 0)*1e5 / 1.3806488e-23 / 295;
+      else return fail("propagation needs a density or pressure option");
+
+      vector<double> transmission, transmission_energy, delta, delta_energy;
+      if (config.has("propagation.transmission")) {
+        if (!config.has("propagation.transmission_photon_energy")) return fail("propagation.transmission needs a transmission_photon_energy option");
+        transmission = config.get("propagation.transmission")->real;
+        transmission_energy = config.get("propagation.transmission_photon_energy")->real;
+        if (transmission.size()!=transmission_energy.size() || transmission.empty()) return fail("propagation.transmission and propagation.transmission_photon_energy must have the same length");
+      }
+      if (config.has("propagation.refractive_index_delta")) {
+        if (!config.has("propagation.refractive_index_photon_energy")) return fail("propagation.refractive_index_delta needs a refractive_index_photon_energy option");
+        delta = config.get("propagation.refractive_index_delta")->real;
+        delta_energy = config.get("propagation.refractive_index_photon_energy")->real;
+        if (delta.size()!=delta_energy.size() || delta.empty()) return fail("propagation.refractive_index_delta and propagation.refractive_index_photon_energy must have the same length");
+      }
+
+      // the cache contains only a part of the grid for the symmetry options,
+      // which is extended like in hhgmax_dipole_response.m
+      const int xn = (int)xv.size(), yn = (int)yv.size();
+      const int cache_points = cache_xn*cache_yn;
+      propagation_grid_map map;
+      map.cache_points = cache_points*components;
+      map.index.assign(2*xn*yn*components, 0);
+      map.weight.assign(2*xn*yn*components, 0.0);
+
+      vector<double> rv(cache_xn);
+      for (int j=0; j<cache_xn; j++) rv[j] = -xv[cache_xn-1-j];
+
+      for (int k=0; k<components; k++) {
+        for (int xi=0; xi<xn; xi++) {
+          for (int yi=0; yi<yn; yi++) {
+            const int p = yi + yn*(xi + xn*k);
+            int *index = &map.index[2*p];
+            double *weight = &map.weight[2*p];
+
+            if (symmetry_rotational) {
+              // linear interpolation in r, 0 outside of the cached x axis
+              const double r = sqrt(SQR(xv[xi]) + SQR(yv[yi]));
+              if (!(r>=rv[0] && r<=rv[cache_xn-1])) continue;
+              int j = (int)(upper_bound(rv.begin(), rv.end(), r) - rv.begin()) - 1;
+              if (j>=cache_xn-1) j = max(cache_xn-2, 0);
+              const double w = cache_xn>1 ? (r-rv[j]) / (rv[j+1]-rv[j]) : 0;
+              index[0] = cache_xn-1-j + cache_points*k;
+              index[1] = cache_xn>1 ? cache_xn-2-j + cache_points*k : index[0];
+              weight[0] = 1-w;
+              weight[1] = w;
+              continue;
+            }
+
+            const int cache_xi = symmetry_x && xi>=cache_xn ? xn-1-xi : xi;
+            const int cache_yi = symmetry_y && yi>=cache_yn ? yn-1-yi : yi;
+            index[0] = index[1] = cache_yi + cache_yn*cache_xi + cache_points*k;
+            weight[0] = 1;
+          }
+        }
+      }
+
+      propagation = new harmonic_propagation(map, omega, zv, config.number("wavelength", 0), density);
+      propagation->set_gas_data(transmission_energy, transmission, delta_energy, delta);
+
+      return true;
+    }
+
+    // returns the name of the cache file of a z slice (the transposed one for
+    // the fallback backend)
+    string slice_filename(double z) const {
+      string suffix = tiled ? ".hcc" : "_transposed.dat";
+      return join(config.text("cache.directory", ""), "dipole_response_z" + matlab_num2str(z) + suffix);
+    }
+
+    // checks the finished flag of a cache file, which for the fallback backend
+    // is stored right before the trailer of dimensions (5 values) and total
+    // size
+    bool slice_finished(const string &filename) const {
+      if (tiled) {
+        tiled_cache_file file;
+        return file.open(filename) && file.finished();
+      }
+
+      FILE *fd = fopen(filename.c_str(), "rb");
+      if (!fd) return false;
+
+      double finished = 0;
+      bool ok = fseek(fd, -6*8-8, SEEK_END)==0 && fread(&finished, 8, 1, fd)==1;
+      fclose(fd);
+      return ok && finished==1;
+    }
+
+    // loads the precomputed driving field of a z slice, as array
+    // driving_field(DI,C,TI); the file may be split into data_ZI.1.mat,
+    // data_ZI.2.mat, ... along the DI index. Natively generated driving
+    // fields need no data.
+    bool load_driving_field(double z, vector<double> &data, int &points) {
+      if (generator) {
+        data.clear();
+        points = cache_xn*cache_yn;
+        return true;
+      }
+
+      int df_ZI = -1;
+      for (size_t i=0; i<ax_zv.size(); i++) {
+        if (fabs(ax_zv[i]-z)<=zv_precision) {
+          df_ZI = (int)i;
+          break;
+        }
+      }
+      if (df_ZI<0) return fail("precomputed data does not contain a slice at z=" + matlab_num2str(z) + "; consider increasing the zv_precision variable");
+
+      string directory = config.text("precomputed_driving_field", "");
+      string basefilename = "data_" + matlab_num2str(df_ZI+1);
+      vector<string> filenames;
+      if (file_exists(join(directory, basefilename + ".mat"))) {
+        filenames.push_back(join(directory, basefilename + ".mat"));
+      }
+      else {
+        for (int chunk=1; file_exists(join(directory, basefilename + "." + matlab_num2str(chunk) + ".mat")); chunk++) {
+          filenames.push_back(join(directory, basefilename + "." + matlab_num2str(chunk) + ".mat"));
+        }
+      }
+      if (filenames.empty()) return fail("no data for precomputed driving field at z=" + matlab_num2str(z));
+
+      // concatenate chunks along DI
+      const int t_length = (int)t_cmc.size();
+      vector<vector<double> > chunks;
+      points = 0;
+      for (size_t f=0; f<filenames.size(); f++) {
+        matfile_reader reader;
+        vector<string> names;
+        vector<matfile_value> values;
+        if (!reader.read(filenames[f], names, values)) return fail(reader.get_error());
+
+        size_t i;
+        for (i=0; i<names.size() && names[i]!="driving_field"; i++);
+        if (i==names.size()) return fail(filenames[f] + " contains no driving_field variable");
+
+        const matfile_value &df = values[i];
+        int dims = (int)df.dims.size();
+        if (df.dims[dims-1]!=t_length || df.numel()%(components*t_length)) {
+          return fail(filenames[f] + ": driving_field must have size ..., components, length(t_cmc)");
+        }
+
+        chunks.push_back(df.real);
+        points += df.numel() / components / t_length;
+      }
+
+      data.resize(points*components*t_length);
+      int offset = 0;
+      for (size_t f=0; f<chunks.size(); f++) {
+        int chunk_points = (int)chunks[f].size() / components / t_length;
+        for (int ct=0; ct<components*t_length; ct++) {
+          for (int p=0; p<chunk_points; p++) data[ct*points + offset+p] = chunks[f][ct*chunk_points + p];
+        }
+        offset += chunk_points;
+      }
+
+      return true;
+    }
+
+    void print_progress() {
+      time_t now = time(0);
+      if (difftime(now, last_status)<1) return;
+      last_status = now;
+
+      double time_spent = difftime(now, time_start);
+      double time_total = time_spent / points_computed * points_effective;
+      double time_left = time_total - time_spent;
+
+      printf("dipole_response: computed point %d of %02d (%d%%). Time spent: %02d:%02d:%02d; Time left: %02d:%02d:%02d of %02d:%02d:%02d (roughly). Computing at %g points per second.\n",
+        points_computed, points_effective, (int)floor(100.0*points_computed/points_effective + 0.5),
+        (int)time_spent/3600, ((int)time_spent/60)%60, (int)time_spent%60,
+        (int)time_left/3600, ((int)time_left/60)%60, (int)time_left%60,
+        (int)time_total/3600, ((int)time_total/60)%60, (int)time_total%60,
+        points_computed/time_spent);
+      fflush(stdout);
+    }
+
+    // computes the spectra of the points first..first+count-1 of the z slice
+    // at z into output(C,omega_i,point) (component index fastest); the points
+    // are in the order of hhgmax_dipole_response.m, which also determines the
+    // order in which they are taken from the data files
+    void compute_points(const vector<double> &df_data, int df_points, double z, int first, int count, complex<double> *output) {
+      const int N = (int)t_cmc.size();
+      const int omegan = (int)omega.size();
+
+      vector<double> Et(DIPOLE_RESPONSE_BATCH*N*components);
+      vector<double> d(DIPOLE_RESPONSE_BATCH*N*components);
+      dipole_spectrum<double> spectrum(fft_length, omegan, omegan ? &cache_keep[0] : 0, (int)t_window.size(), t_window.empty() ? 0 : &t_window[0], t0, deltat);
+
+      for (int batch_start=0; batch_start<count; batch_start+=DIPOLE_RESPONSE_BATCH) {
+        const int batch = min(DIPOLE_RESPONSE_BATCH, count-batch_start);
+        int batch_i;
+
+        // driving fields, layout points x N x components; the ground state
+        // amplitudes are computed from them by the kernel
+        if (generator) {
+          vector<double> x(batch), y(batch), zb(batch, z);
+          for (batch_i=0; batch_i<batch; batch_i++) {
+            const int point = first+batch_start+batch_i;
+            x[batch_i] = xv[point / cache_yn];
+            y[batch_i] = yv[cache_yi[point % cache_yn]];
+          }
+          generator->generate(batch, &x[0], &y[0], &zb[0], &Et[0]);
+        }
+        else {
+          #pragma omp parallel for
+          for (batch_i=0; batch_i<batch; batch_i++) {
+            const int DI = first+batch_start+batch_i;
+            double *E = &Et[batch_i*N*components];
+            for (int t_i=0; t_i<N; t_i++) {
+              for (int k=0; k<components; k++) {
+                E[t_i*components+k] = df_data[DI + df_points*(k + components*t_i)];
+              }
+            }
+          }
+        }
+
+        kernel->execute(batch, &Et[0], 0, &d[0]);
+
+        // window, Fourier transform and reduction to cache_keep
+        #pragma omp parallel for
+        for (batch_i=0; batch_i<batch; batch_i++) {
+          complex<double> *point_output = output + (size_t)(batch_start+batch_i)*components*omegan;
+          vector<complex<double> > d_omega(omegan+1);
+
+          for (int k=0; k<components; k++) {
+            spectrum.transform(&d[(batch_i*N + N-fft_length)*components + k], components, &d_omega[0]);
+            for (int o=0; o<omegan; o++) point_output[k + components*o] = d_omega[o];
+          }
+        }
+
+        points_computed += batch;
+        print_progress();
+        if (queue && !lease.empty()) queue->renew(lease);
+      }
+    }
+
+    // starts the output of a z slice: the tiled backend is written point by
+    // point, otherwise the whole slice is kept in memory and written at the end
+    bool begin_slice(double z) {
+      if (tiled) {
+        if (!slice_file.create(slice_filename(z), cache_xn, cache_yn, components, (int)omega.size())) return fail(slice_file.get_error());
+      }
+      else {
+        slice_data.assign(cache_yn*cache_xn*components*omega.size(), complex<double>(0));
+      }
+      return true;
+    }
+
+    // stores the spectra data(C,omega_i,point) of the points first..first+count-1
+    void store_points(int first, int count, const complex<double> *data) {
+      const int omegan = (int)omega.size();
+
+      for (int point=first; point<first+count; point++) {
+        const int xi = point / cache_yn;
+        const int yi = point % cache_yn;
+        const complex<double> *point_data = data + (size_t)(point-first)*components*omegan;
+
+        if (tiled) {
+          slice_file.write_point(xi, yi, point_data);
+          continue;
+        }
+        for (int o=0; o<omegan; o++) {
+          for (int k=0; k<components; k++) {
+            slice_data[yi + cache_yn*(xi + cache_xn*(k + components*o))] = point_data[k + components*o];
+          }
+        }
+      }
+    }
+
+    bool finish_slice(double z) {
+      if (tiled) {
+        bool ok = slice_file.set_finished();
+        slice_file.close();
+        if (!ok) return fail("cannot write " + slice_filename(z));
+        return true;
+      }
+
+      bool ok = write_slice(slice_filename(z), slice_data);
+      slice_data.clear();
+      return ok;
+    }
+
+    // computes all points of a z slice and writes its cache file
+    bool compute_slice(double z) {
+      vector<double> df_data;
+      int df_points;
+      if (!load_driving_field(z, df_data, df_points)) return false;
+
+      const int points = cache_xn*cache_yn;
+      if (points>df_points) return fail("no data for precomputed driving field left");
+
+      if (!begin_slice(z)) return false;
+
+      vector<complex<double> > data((size_t)DIPOLE_RESPONSE_BATCH*components*omega.size() + 1);
+      for (int first=0; first<points; first+=DIPOLE_RESPONSE_BATCH) {
+        const int count = min(DIPOLE_RESPONSE_BATCH, points-first);
+        compute_points(df_data, df_points, z, first, count, &data[0]);
+        store_points(first, count, &data[0]);
+      }
+
+      return finish_slice(z);
+    }
+
+    // name of a block of points of a z slice in the work queue
+    string block_name(double z, int block) const {
+      char number[32];
+      sprintf(number, "%d", block);
+      return "z" + matlab_num2str(z) + "_b" + number;
+    }
+
+    // computes the blocks of a z slice that are neither committed nor claimed
+    // by another worker; returns the number of computed blocks or -1 on error
+    int work_on_slice(double z, int block_points) {
+      const int points = cache_xn*cache_yn;
+      const int blocks = (points + block_points-1) / block_points;
+      const size_t point_size = components*omega.size();
+
+      vector<double> df_data;
+      int df_points = -1;
+      int computed = 0;
+
+      for (int block=0; block<blocks; block++) {
+        // once another worker merged the slice, its blocks are discarded and
+        // must not be computed again
+        if (slice_finished(slice_filename(z))) break;
+
+        const string name = block_name(z, block);
+        if (queue->is_done(name) || !queue->claim(name)) continue;
+        if (queue->is_done(name) || slice_finished(slice_filename(z))) {
+          // committed (or merged) in the meantime by a worker whose lease had
+          // expired
+          queue->release(name);
+          continue;
+        }
+
+        // the driving field is only loaded if there is work for this slice
+        if (df_points<0) {
+          if (!load_driving_field(z, df_data, df_points)) {
+            queue->release(name);
+            return -1;
+          }
+          if (points>df_points) {
+            queue->release(name);
+            fail("no data for precomputed driving field left");
+            return -1;
+          }
+        }
+
+        const int first = block*block_points;
+        const int count = min(block_points, points-first);
+        vector<complex<double> > data(count*point_size + 1);
+
+        lease = name;
+        compute_points(df_data, df_points, z, first, count, &data[0]);
+        lease = "";
+
+        if (slice_finished(slice_filename(z))) {
+          queue->release(name);
+          break;
+        }
+        bool ok = queue->commit(name, &data[0], count*point_size*sizeof(complex<double>));
+        queue->release(name);
+        if (!ok) {
+          fail("cannot commit " + name + " to the work queue");
+          return -1;
+        }
+        computed++;
+      }
+
+      return computed;
+    }
+
+    // writes the cache file of a z slice from the committed blocks once all of
+    // them are available; only the worker holding the merge lease does this
+    bool merge_slice(double z, int block_points) {
+      const int points = cache_xn*cache_yn;
+      const int blocks = (points + block_points-1) / block_points;
+      const size_t point_size = components*omega.size();
+
+      for (int block=0; block<blocks; block++) {
+        if (!queue->is_done(block_name(z, block))) return true;
+      }
+
+      const string name = "z" + matlab_num2str(z) + "_merge";
+      if (!queue->claim(name)) return true;
+      if (slice_finished(slice_filename(z))) {
+        queue->release(name);
+        return true;
+      }
+
+      if (!begin_slice(z)) {
+        queue->release(name);
+        return false;
+      }
+
+      vector<char> data;
+      for (int block=0; block<blocks; block++) {
+        const int first = block*block_points;
+        const int count = min(block_points, points-first);
+
+        if (!queue->read(block_name(z, block), data) || data.size()!=count*point_size*sizeof(complex<double>)) {
+          queue->release(name);
+          return fail("cannot read " + block_name(z, block) + " from the work queue");
+        }
+        store_points(first, count, (const complex<double> *)&data[0]);
+        queue->renew(name);
+      }
+
+      bool ok = finish_slice(z);
+      if (ok) {
+        for (int block=0; block<blocks; block++) queue->discard(block_name(z, block));
+      }
+      queue->release(name);
+      return ok;
+    }
+
+    // reads the cache file of the slice zv[zi] and adds it to the z integral
+    bool propagate_slice(int zi) {
+      const string filename = slice_filename(zv[zi]);
+      const size_t size = (size_t)cache_xn*cache_yn*components*omega.size();
+      vector<complex<double> > slice(size + 1);
+
+      if (tiled) {
+        tiled_cache_file file;
+        if (!file.open(filename)) return fail(file.get_error());
+        file.read_omega(0, (int)omega.size(), &slice[0]);
+        file.close();
+      }
+      else {
+        FILE *fd = fopen(filename.c_str(), "rb");
+        if (!fd) return fail("cannot read " + filename);
+
+        vector<double> buffer(size + 1);
+        bool ok = fread(&buffer[0], 8, size, fd)==size;
+        for (size_t j=0; j<size; j++) slice[j] = buffer[j];
+        ok = ok && fread(&buffer[0], 8, size, fd)==size;
+        for (size_t j=0; j<size; j++) slice[j] = complex<double>(real(slice[j]), buffer[j]);
+        fclose(fd);
+        if (!ok) return fail("cannot read " + filename);
+      }
+
+      propagation->add_slice(zi, &slice[0]);
+      printf("harmonic_propagation: added z slice %d of %d\n", zi+1, (int)zv.size());
+      fflush(stdout);
+      if (queue && !lease.empty()) queue->renew(lease);
+
+      return true;
+    }
+
+    // computes the far field E_plane(omega_i,component,yi,xi) of the field
+    // U(yi,xi,component,omega_i) in the plane z_max for the farfield.*
+    // options, like hhgmax_farfield.m
+    bool compute_farfield(const vector<complex<double> > &U, matfile_value &E_plane) {
+      if (!config.has("farfield.plane_distance")) return fail("farfield needs a plane_distance option");
+
+      // screen points given as meshgrid, or as its axes
+      vector<double> plane_x, plane_y;
+      vector<int> plane_dims;
+      if (config.has("farfield.plane_x") && config.has("farfield.plane_y")) {
+        plane_x = config.get("farfield.plane_x")->real;
+        plane_y = config.get("farfield.plane_y")->real;
+        plane_dims = config.get("farfield.plane_x")->dims;
+        if (plane_x.size()!=plane_y.size()) return fail("farfield.plane_x and farfield.plane_y must have the same size");
+      }
+      else if (config.has("farfield.plane_xv") && config.has("farfield.plane_yv")) {
+        const vector<double> &plane_xv = config.get("farfield.plane_xv")->real;
+        const vector<double> &plane_yv = config.get("farfield.plane_yv")->real;
+        for (size_t xi=0; xi<plane_xv.size(); xi++) {
+          for (size_t yi=0; yi<plane_yv.size(); yi++) {
+            plane_x.push_back(plane_xv[xi]);
+            plane_y.push_back(plane_yv[yi]);
+          }
+        }
+        plane_dims.push_back((int)plane_yv.size());
+        plane_dims.push_back((int)plane_xv.size());
+      }
+      else return fail("farfield needs plane_x and plane_y, or plane_xv and plane_yv options");
+
+      for (size_t i=2; i<xv.size(); i++) {
+        if (fabs(xv[i]-xv[i-1]-(xv[1]-xv[0]))>1e-6*fabs(xv[1]-xv[0])) return fail("farfield needs an equally spaced x axis");
+      }
+      for (size_t i=2; i<yv.size(); i++) {
+        if (fabs(yv[i]-yv[i-1]-(yv[1]-yv[0]))>1e-6*fabs(yv[1]-yv[0])) return fail("farfield needs an equally spaced y axis");
+      }
+      const int oversampling = (int)config.number("farfield.oversampling", FARFIELD_OVERSAMPLING);
+      if (oversampling<1) return fail("farfield.oversampling must be positive");
+
+      double R[9];
+      farfield_rotation(config.number("farfield.plane_theta", 0), config.number("farfield.plane_phi", 0), config.number("farfield.plane_psi", 0), R);
+      farfield_engine engine(xv, yv, propagation->get_z_max(), config.number("wavelength", 0), (int)plane_x.size(), plane_x.empty() ? 0 : &plane_x[0], plane_y.empty() ? 0 : &plane_y[0], config.number("farfield.plane_distance", 0), R, oversampling);
+
+      const size_t size = omega.size()*components*plane_x.size();
+      vector<complex<double> > E(size + 1);
+      engine.execute((int)omega.size(), omega.empty() ? 0 : &omega[0], components, &U[0], &E[0]);
+
+      E_plane.dims.push_back((int)omega.size());
+      E_plane.dims.push_back(components);
+      E_plane.dims.insert(E_plane.dims.end(), plane_dims.begin(), plane_dims.end());
+      E_plane.real.resize(size);
+      E_plane.imag.resize(size);
+      for (size_t j=0; j<size; j++) {
+        E_plane.real[j] = real(E[j]);
+        E_plane.imag[j] = imag(E[j]);
+      }
+
+      return true;
+    }
+
+    // writes z_max, omega and U(yi,xi,component,omega_i) of the propagation
+    // to propagation.output, and the far field E_plane if farfield.* options
+    // are given
+    bool write_propagation() {
+      const string filename = config.text("propagation.output", join(config.text("cache.directory", ""), "harmonic_propagation.mat"));
+      const vector<complex<double> > &U = propagation->finish();
+
+      matfile_value E_plane;
+      if (config.has("farfield") && !compute_farfield(U, E_plane)) return false;
+
+      matfile_value U_value;
+      U_value.dims.push_back((int)yv.size());
+      U_value.dims.push_back((int)xv.size());
+      U_value.dims.push_back(components);
+      U_value.dims.push_back((int)omega.size());
+      U_value.real.resize(U.size());
+      U_value.imag.resize(U.size());
+      for (size_t j=0; j<U.size(); j++) {
+        U_value.real[j] = real(U[j]);
+        U_value.imag[j] = imag(U[j]);
+      }
+
+      matfile_writer writer;
+      writer.add("z_max", matfile_value::scalar(propagation->get_z_max()));
+      writer.add("omega", matfile_value::row(omega));
+      writer.add("U", U_value);
+      if (!E_plane.dims.empty()) writer.add("E_plane", E_plane);
+      if (!writer.write(filename)) return fail("cannot write " + filename);
+
+      return true;
+    }
+
+    // writes a cache file with the structure of the transposed files of
+    // hhgmax_cache_file, i.e. variables E_real(y,x,component,omega),
+    // E_imag(y,x,component,omega) and finished, followed by the dimensions
+    // (x, y, component, omega, finished) and the total size in bytes
+    bool write_slice(const string &filename, const vector<complex<double> > &slice) {
+      string temp_filename = filename + ".part";
+      FILE *fd = fopen(temp_filename.c_str(), "wb");
+      if (!fd) return fail("cannot write " + temp_filename);
+
+      const size_t size = slice.size();
+      vector<double> buffer(size);
+      bool ok = true;
+
+      for (size_t j=0; j<size; j++) buffer[j] = real(slice[j]);
+      ok = ok && fwrite(&buffer[0], 8, size, fd)==size;
+      for (size_t j=0; j<size; j++) buffer[j] = imag(slice[j]);
+      ok = ok && fwrite(&buffer[0], 8, size, fd)==size;
+
+      double finished = 1;
+      ok = ok && fwrite(&finished, 8, 1, fd)==1;
+
+      unsigned long long trailer[6] = {
+        (unsigned long long)cache_xn, (unsigned long long)cache_yn,
+        (unsigned long long)components, (unsigned long long)omega.size(), 1,
+        (unsigned long long)(2*size+1)*8
+      };
+      ok = ok && fwrite(trailer, 8, 6, fd)==6;
+
+      ok = fclose(fd)==0 && ok;
+      remove(filename.c_str());
+      if (!ok || rename(temp_filename.c_str(), filename.c_str())) return fail("cannot write " + filename);
+
+      return true;
+    }
+
+  public:
+    dipole_response(const dipole_response_config &cfg) : config(cfg) {
+      kernel = 0;
+      ionization = 0;
+      tiled = false;
+      queue = 0;
+      propagation = 0;
+      generator = 0;
+    };
+
+    ~dipole_response() {
+      delete kernel;
+      delete ionization;
+      delete propagation;
+      delete generator;
+    };
+
+    // computes all z slices that are not in the cache yet, and adds each slice
+    // to the z integral of the propagation.* options as soon as it is
+    // available; returns false on error
+    bool run() {
+      if (!load_axes() || !setup() || !setup_cache() || !setup_propagation()) return false;
+
+      points_computed = 0;
+      points_effective = 0;
+      vector<double> todo;
+      for (size_t zi=0; zi<zv.size(); zi++) {
+        if (slice_finished(slice_filename(zv[zi]))) continue;
+        todo.push_back(zv[zi]);
+        points_effective += cache_xn*cache_yn;
+      }
+
+      time_start = last_status = time(0);
+      for (size_t zi=0, todo_i=0; zi<zv.size(); zi++) {
+        if (todo_i<todo.size() && todo[todo_i]==zv[zi]) {
+          if (!compute_slice(zv[zi])) return false;
+          todo_i++;
+        }
+        if (propagation && !propagate_slice((int)zi)) return false;
+      }
+
+      return !propagation || write_propagation();
+    };
+
+    // only integrates the slices along z as given by the propagation.*
+    // options, which must all be in the cache already
+    bool run_propagation() {
+      if (!load_axes() || !setup() || !setup_cache() || !setup_propagation()) return false;
+      if (!propagation) return fail("config needs propagation options");
+
+      for (size_t zi=0; zi<zv.size(); zi++) {
+        if (!slice_finished(slice_filename(zv[zi]))) return fail("the slice at z=" + matlab_num2str(zv[zi]) + " is not in the cache yet");
+        if (!propagate_slice((int)zi)) return false;
+      }
+
+      return write_propagation();
+    };
+
+    // like run(), but shares the work with other processes calling this
+    // function with the same config (on this or other nodes sharing the cache
+    // directory) through a work queue in <cache.directory>/queue; returns when
+    // all slices are finished. Then, the integration along z of the
+    // propagation.* options is done by one of the workers.
+    bool run_worker() {
+      if (!load_axes() || !setup() || !setup_cache() || !setup_propagation()) return false;
+
+      const int block_points = (int)config.number("queue.block_points", 256);
+      const int lease_seconds = (int)config.number("queue.lease_seconds", 600);
+      const int poll_seconds = (int)config.number("queue.poll_seconds", 10);
+      if (block_points<1 || lease_seconds<1 || poll_seconds<1) return fail("queue.block_points, queue.lease_seconds and queue.poll_seconds must be positive");
+
+      work_queue shared_queue(join(config.text("cache.directory", ""), "queue"), lease_seconds);
+      if (!shared_queue.init()) return fail("cannot create the work queue directory");
+      queue = &shared_queue;
+
+      points_computed = 0;
+      points_effective = 0;
+      for (size_t zi=0; zi<zv.size(); zi++) {
+        if (!slice_finished(slice_filename(zv[zi]))) points_effective += cache_xn*cache_yn;
+      }
+      time_start = last_status = time(0);
+
+      bool ok = true;
+      while (ok) {
+        bool finished = true;
+        int computed = 0;
+
+        for (size_t zi=0; ok && zi<zv.size(); zi++) {
+          if (slice_finished(slice_filename(zv[zi]))) continue;
+          finished = false;
+
+          int blocks = work_on_slice(zv[zi], block_points);
+          if (blocks<0) ok = false;
+          else computed += blocks;
+
+          ok = ok && merge_slice(zv[zi], block_points);
+        }
+        if (finished) break;
+
+        // nothing left to claim: wait for the other workers (or for their
+        // leases to expire)
+        if (ok && !computed) work_queue::wait(poll_seconds);
+      }
+
+      // the lease keeps the other workers from integrating at the same time;
+      // no result is left in the queue, so that later runs write the output
+      // again, e.g. with other propagation.* options
+      if (ok && propagation && shared_queue.claim("propagation")) {
+        lease = "propagation";
+        for (size_t zi=0; ok && zi<zv.size(); zi++) ok = propagate_slice((int)zi);
+        ok = ok && write_propagation();
+        lease = "";
+        shared_queue.release("propagation");
+      }
+
+      queue = 0;
+      return ok;
+    };
+
+    const string &get_error() const {
+      return error;
+    };
+};
+
+#endif // end of include guard
@@ -0,0 +1,257 @@
+// This file provides the driving fields of hhgmax_gh_driving_field.m (a
+// superposition of Gauss-Hermite modes, see hhgmax_gh_mode.m) and
+// hhgmax_plane_wave_driving_field.m natively, for a whole batch of (x, y, z)
+// points at once, together with the Fourier coefficients of the pulse as
+// computed by hhgmax_pulse.m. The pulse spectrum, the normalization of the
+// Hermite polynomials and the FFT are set up once; per point and frequency,
+// only one complex exponential is evaluated. The fields are written in the
+// layout of the input of the Lewenstein model (points x N x components).
+// Positions are in millimeters, times and fields in scaled atomic units.
+
+// include guard
+#ifndef DRIVING_FIELD_HPP
+#define DRIVING_FIELD_HPP
+
+#include "fft.hpp"
+
+#include <algorithm>
+#include <complex>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <ctype.h>
+
+// options of hhgmax_pulse.m
+struct pulse_parameters {
+  string shape, carrier;
+  double fwhm;        // pulse duration in scaled atomic units
+  bool elliptical;
+  double ellipticity, ce_phase;
+
+  pulse_parameters() : shape("constant"), carrier("cos"), fwhm(0), elliptical(false), ellipticity(0), ce_phase(0) {};
+};
+
+// computes the angular frequency axis omega and the Fourier coefficients
+// coefficients(C,omega_i) (component index fastest) of the pulse for the
+// equally spaced time axis t, like hhgmax_pulse.m; returns an error message,
+// or an empty string on success
+inline string pulse_coefficients(const vector<double> &t, const pulse_parameters &p, vector<double> &omega, vector<complex<double> > &coefficients, int &components) {
+  const double pi = 4.0*atan(1.0);
+  const int N = (int)t.size();
+  string shape = p.shape, carrier = p.carrier;
+  for (size_t i=0; i<shape.size(); i++) shape[i] = (char)tolower(shape[i]);
+  for (size_t i=0; i<carrier.size(); i++) carrier[i] = (char)tolower(carrier[i]);
+
+  double tau = 1;
+  if (shape=="gaussian") tau = p.fwhm/2/sqrt(log(sqrt(2.0)));
+  else if (shape=="super-gaussian") tau = p.fwhm/2/sqrt(sqrt(log(sqrt(2.0))));
+  else if (shape=="cos_sqr") tau = p.fwhm/2/acos(1/sqrt(sqrt(2.0)));
+  else if (shape!="constant") return "unknown pulse shape";
+  if (carrier!="cos" && carrier!="exp") return "invalid carrier: must be 'cos' or 'exp'";
+
+  components = p.elliptical ? 2 : 1;
+  const double scale = p.elliptical ? 1/sqrt(1 + SQR(1-p.ellipticity)) : 1;
+
+  // the Fourier coefficients are conj(fft(conj(amplitude)))
+  fft<double> transform(N);
+  vector<complex<double> > amplitude(N);
+  coefficients.resize(components*N);
+  for (int c=0; c<components; c++) {
+    for (int j=0; j<N; j++) {
+      double envelope = 1;
+      if (shape=="gaussian") envelope = exp(-SQR(t[j]/tau));
+      else if (shape=="super-gaussian") envelope = exp(-SQR(SQR(t[j]/tau)));
+      else if (shape=="cos_sqr") envelope = t[j]/tau<=-pi/2 || t[j]/tau>=pi/2 ? 0 : SQR(cos(t[j]/tau));
+
+      const double phase = t[j] + p.ce_phase - c*pi/2;
+      const complex<double> value = carrier=="cos" ? complex<double>(cos(phase)) : complex<double>(cos(phase), sin(phase));
+      amplitude[j] = conj(value * envelope * (c ? 1-p.ellipticity : 1.0) * scale);
+    }
+    transform.transform(&amplitude[0]);
+    for (int j=0; j<N; j++) coefficients[c + components*j] = conj(amplitude[j]);
+  }
+
+  // frequency axis, with the negative frequencies in the second half
+  omega.resize(N);
+  const double domega = 2*pi/(t[1]-t[0])/N;
+  for (int j=0; j<N; j++) omega[j] = (j>=(N+1)/2 ? j-N : j) * domega;
+
+  return "";
+}
+
+// sets the Gauss-Hermite modes for one of the mode names of hhgmax_gh_mode.m
+// (case-insensitive); returns false for unknown names
+inline bool gh_mode_coefficients(const string &mode, vector<int> &mode_n, vector<int> &mode_m, vector<double> &mode_coefficients) {
+  string name = mode;
+  for (size_t i=0; i<name.size(); i++) name[i] = (char)tolower(name[i]);
+
+  mode_n.clear();
+  mode_m.clear();
+  mode_coefficients.clear();
+  if (name=="tem00") {
+    mode_n.push_back(0); mode_m.push_back(0); mode_coefficients.push_back(1);
+  }
+  else if (name=="gh10") {
+    mode_n.push_back(1); mode_m.push_back(0); mode_coefficients.push_back(1);
+  }
+  else if (name=="1d-quasi-imaging") {
+    mode_n.push_back(0); mode_m.push_back(0); mode_coefficients.push_back(sqrt(3.0/11));
+    mode_n.push_back(0); mode_m.push_back(4); mode_coefficients.push_back(-sqrt(8.0/11));
+  }
+  else if (name=="2d-quasi-imaging") {
+    mode_n.push_back(0); mode_m.push_back(0); mode_coefficients.push_back(sqrt(3.0/11));
+    mode_n.push_back(0); mode_m.push_back(4); mode_coefficients.push_back(-sqrt(4.0/11));
+    mode_n.push_back(4); mode_m.push_back(0); mode_coefficients.push_back(-sqrt(4.0/11));
+  }
+  else return false;
+
+  return true;
+}
+
+class gh_driving_field {
+  private:
+    int N, components;
+    double E0;
+    vector<double> k;
+    vector<complex<double> > coefficients;
+    fft<double> transform;
+
+    // frequencies that are computed: k>0 with non-zero coefficients, and
+    // for k<0, the index of the bin with -k (or -1)
+    vector<int> computed, partner;
+
+    // modes; plane waves have no modes
+    bool plane_wave;
+    double w0;
+    vector<int> mode_n, mode_m;
+    vector<double> mode_coefficients;
+    vector<double> hermite_norm;
+    int max_n, max_m;
+    bool rotated;
+    double rotation[9];
+
+    // mode field of hhgmax_gh_mode.m at the wave number k > 0, times the
+    // factor exp(-i*k*(z-shift)) of the comoving frame, where z-shift is the
+    // z value before the rotation of the beam
+    complex<double> mode(double x, double y, double z, double shift, double k_i, double *Hx, double *Hy, complex<double> *gouy) const {
+      const double z_R = k_i*SQR(w0)/2;
+      const double q = z/z_R;
+      const double s = 1/sqrt(1+SQR(q)); // w0/w, cos(atan(q))
+      const double inv_w2 = SQR(s/w0);
+
+      // Gouy phase exp(-i*atan(q)) and its powers
+      const complex<double> g(s, -q*s);
+      gouy[0] = g;
+      for (int p=1; p<=max_n+max_m; p++) gouy[p] = gouy[p-1] * g;
+
+      // normalized Hermite polynomials by the recurrence of hhgmax_hermite.m
+      const double X = sqrt(2.0)*x*s/w0, Y = sqrt(2.0)*y*s/w0;
+      Hx[0] = Hy[0] = 1;
+      if (max_n>0) Hx[1] = 2*X;
+      if (max_m>0) Hy[1] = 2*Y;
+      for (int n=1; n<max_n; n++) Hx[n+1] = 2*X*Hx[n] - 2*n*Hx[n-1];
+      for (int m=1; m<max_m; m++) Hy[m+1] = 2*Y*Hy[m] - 2*m*Hy[m-1];
+
+      complex<double> sum = 0;
+      for (size_t i=0; i<mode_coefficients.size(); i++) {
+        const int n = mode_n[i], m = mode_m[i];
+        sum += mode_coefficients[i] * hermite_norm[n]*Hx[n] * hermite_norm[m]*Hy[m] * gouy[n+m];
+      }
+
+      // envelope with the curvature k*r^2/(2R) = k*r^2*z/(2*(z^2+z_R^2))
+      const double r2 = SQR(x) + SQR(y);
+      const complex<double> envelope = s * exp(complex<double>(-r2*inv_w2, k_i*r2*z/2/(SQR(z)+SQR(z_R)) + k_i*shift));
+      return envelope * sum;
+    }
+
+  public:
+    // N, omega - frequency axis of the pulse (from -pi/N/dt to +pi/N/dt, in
+    //            any order)
+    // C, coefficients_data - Fourier coefficients of the pulse, C x N
+    // E0_SAU - peak field strength of the corresponding Gaussian beam
+    // wavelength - in mm
+    // beam_waist - in mm; 0 for a plane wave (hhgmax_plane_wave_driving_field.m)
+    // modes, n, m, c - Gauss-Hermite modes and their coefficients
+    // rotation_matrix - 3x3 (column-major) rotation of the beam, or 0
+    gh_driving_field(int n_omega, const double *omega, int C, const complex<double> *coefficients_data, double E0_SAU, double wavelength, double beam_waist, int modes, const int *n, const int *m, const double *c, const double *rotation_matrix) :
+      N(n_omega), components(C), E0(E0_SAU), coefficients(coefficients_data, coefficients_data+C*n_omega), transform(n_omega),
+      plane_wave(beam_waist==0), w0(beam_waist), mode_n(n, n+modes), mode_m(m, m+modes), mode_coefficients(c, c+modes)
+    {
+      const double pi = 4.0*atan(1.0);
+
+      k.resize(N);
+      partner.assign(N, -1);
+      for (int j=0; j<N; j++) k[j] = 2*pi/wavelength * omega[j];
+      for (int j=0; j<N; j++) {
+        bool zero = true;
+        for (int ci=0; ci<C; ci++) zero = zero && coefficients[ci + C*j]==0.0;
+        if (zero || plane_wave) continue;
+        if (k[j]>0) computed.push_back(j);
+        if (k[j]<0) {
+          for (int l=0; l<N; l++) if (k[l]==-k[j]) partner[j] = l;
+          if (partner[j]<0) computed.push_back(j);
+        }
+      }
+
+      max_n = max_m = 0;
+      for (int i=0; i<modes; i++) {
+        max_n = max(max_n, n[i]);
+        max_m = max(max_m, m[i]);
+      }
+      hermite_norm.resize(max(max_n, max_m)+1);
+      double factorial = 1;
+      for (int i=0; i<(int)hermite_norm.size(); i++) {
+        if (i>0) factorial *= i;
+        hermite_norm[i] = 1/sqrt(pow(2.0, i) * factorial);
+      }
+
+      rotated = rotation_matrix!=0;
+      for (int i=0; i<9; i++) rotation[i] = rotated ? rotation_matrix[i] : i%4==0;
+    };
+
+    int get_components() const {
+      return components;
+    };
+
+    // writes the real driving fields of the points (x[p], y[p], z[p]) to
+    // Et(p,t_i,component) (component index fastest)
+    void generate(int points, const double *x, const double *y, const double *z, double *Et) const {
+      int p;
+
+      #pragma omp parallel for schedule(dynamic)
+      for (p=0; p<points; p++) {
+        vector<complex<double> > A(N, complex<double>(0)), spectrum(N);
+        vector<double> Hx(max_n+1), Hy(max_m+1);
+        vector<complex<double> > gouy(max_n+max_m+1);
+
+        // position in the frame of the beam: [x y z] * rotation
+        double px = x[p], py = y[p], pz = z[p];
+        if (rotated) {
+          px = x[p]*rotation[0] + y[p]*rotation[1] + z[p]*rotation[2];
+          py = x[p]*rotation[3] + y[p]*rotation[4] + z[p]*rotation[5];
+          pz = x[p]*rotation[6] + y[p]*rotation[7] + z[p]*rotation[8];
+        }
+
+        // A_nm*exp(-i*k*z) of hhgmax_gh_driving_field.m; 0 for k=0, for
+        // k<0 the conjugate of the mode at -k; 1 for plane waves
+        if (plane_wave) A.assign(N, complex<double>(1));
+        for (size_t i=0; i<computed.size(); i++) {
+          const int j = computed[i];
+          const complex<double> value = mode(px, py, pz, pz-z[p], fabs(k[j]), &Hx[0], &Hy[0], &gouy[0]);
+          A[j] = k[j]>0 ? value : conj(value);
+        }
+        for (int j=0; j<N; j++) if (partner[j]>=0) A[j] = conj(A[partner[j]]);
+
+        // E0*ifft(conj(coefficients.*A)), of which the real part is E0/N
+        // times the real part of fft(coefficients.*A)
+        double *Et_p = Et + (size_t)p*N*components;
+        for (int c=0; c<components; c++) {
+          for (int j=0; j<N; j++) spectrum[j] = coefficients[c + components*j] * A[j];
+          transform.transform(&spectrum[0]);
+          for (int j=0; j<N; j++) Et_p[j*components + c] = E0/N * real(spectrum[j]);
+        }
+      }
+    };
+};
+
+#endif // end of include guard
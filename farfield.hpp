@@ -0,0 +1,200 @@
+// This file provides the far field of hhgmax_farfield.m natively: for each
+// frequency, the angular spectrum
+//   F(kx,ky) = dx/2/pi * dy/2/pi * sum U(y,x) exp(-i*(kx*x + ky*y))
+// of the field in the input plane is needed at the k points k*x/r, k*y/r of
+// the screen points (x, y, z) at distance r. Instead of the zero padded FFT
+// and the linear interpolation of hhgmax_farfield.m, it is evaluated by
+// chirp-z transforms on a grid that only covers the k points of the screen,
+// with FARFIELD_OVERSAMPLING times the resolution of the FFT of the unpadded
+// input, and interpolated from there with cubic Lagrange polynomials. The
+// frequencies are computed in parallel. Lengths are in millimeters, U and
+// the far field are in scaled atomic units.
+
+// include guard
+#ifndef FARFIELD_HPP
+#define FARFIELD_HPP
+
+#include "fft.hpp"
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+#include <math.h>
+
+// resolution of the grid in k space, relative to the FFT of the unpadded input
+#define FARFIELD_OVERSAMPLING 8
+
+// rotation matrix R(row,column) (row index fastest) of the screen plane for
+// the rotations theta, phi and psi (in degrees) around the x, y and z axis,
+// as in hhgmax_farfield.m
+inline void farfield_rotation(double theta, double phi, double psi, double *R) {
+  const double degree = 4.0*atan(1.0)/180;
+  const double c[3] = {cos(theta*degree), cos(phi*degree), cos(psi*degree)};
+  const double s[3] = {sin(theta*degree), sin(phi*degree), sin(psi*degree)};
+  const double rotations[3][9] = {
+    {1, 0, 0, 0, c[0], -s[0], 0, s[0], c[0]},
+    {c[1], 0, s[1], 0, 1, 0, -s[1], 0, c[1]},
+    {c[2], -s[2], 0, s[2], c[2], 0, 0, 0, 1}
+  };
+
+  for (int i=0; i<9; i++) R[i] = i%4==0;
+  for (int r=0; r<3; r++) {
+    double product[9];
+    for (int row=0; row<3; row++) {
+      for (int column=0; column<3; column++) {
+        product[row + 3*column] = 0;
+        for (int j=0; j<3; j++) product[row + 3*column] += R[row + 3*j] * rotations[r][j + 3*column];
+      }
+    }
+    for (int i=0; i<9; i++) R[i] = product[i];
+  }
+}
+
+class farfield_engine {
+  private:
+    int xn, yn;
+    double dx, dy, xc, yc;
+    double z_U, wavelength;
+    int oversampling;
+
+    // screen points: direction cosines x/r and y/r, z/r and r
+    int points;
+    vector<double> a, b, cz, r;
+    double a_min, a_max, b_min, b_max;
+
+    // cubic Lagrange interpolation weights for the nodes -1, 0, 1, 2 at t
+    static void lagrange(double t, double *w) {
+      w[0] = -t*(t-1)*(t-2)/6;
+      w[1] = (t+1)*(t-1)*(t-2)/2;
+      w[2] = -(t+1)*t*(t-2)/2;
+      w[3] = (t+1)*t*(t-1)/6;
+    }
+
+    // grid of m values from start with the given step that covers the
+    // interval [low, high] with one additional node before and two after
+    static void cover(double low, double high, double step, double &start, int &m) {
+      start = low - step;
+      m = (int)floor((high-low)/step) + 4;
+    }
+
+  public:
+    // xv, yv - equally spaced axes of the input plane
+    // z_position - z position of the input plane
+    // wavelength_mm - wavelength of the driving field, which defines the
+    //                 scaled atomic units of omega
+    // screen_points, plane_x, plane_y - coordinates of the screen points
+    //                                   within the screen plane
+    // plane_distance - distance of the screen plane from the origin
+    // R - rotation matrix of the screen plane (see farfield_rotation)
+    farfield_engine(const vector<double> &xv, const vector<double> &yv, double z_position, double wavelength_mm, int screen_points, const double *plane_x, const double *plane_y, double plane_distance, const double *R, int oversampling_factor=FARFIELD_OVERSAMPLING) :
+      xn((int)xv.size()), yn((int)yv.size()), z_U(z_position), wavelength(wavelength_mm), oversampling(oversampling_factor), points(screen_points)
+    {
+      dx = xn>1 ? xv[1]-xv[0] : 1;
+      dy = yn>1 ? yv[1]-yv[0] : 1;
+      xc = (xv[0] + xv[xn-1])/2;
+      yc = (yv[0] + yv[yn-1])/2;
+
+      a.resize(points);
+      b.resize(points);
+      cz.resize(points);
+      r.resize(points);
+      a_min = b_min = 1;
+      a_max = b_max = -1;
+      for (int q=0; q<points; q++) {
+        const double x = R[0]*plane_x[q] + R[3]*plane_y[q] + R[6]*plane_distance;
+        const double y = R[1]*plane_x[q] + R[4]*plane_y[q] + R[7]*plane_distance;
+        const double z = R[2]*plane_x[q] + R[5]*plane_y[q] + R[8]*plane_distance - z_U;
+        r[q] = sqrt(x*x + y*y + z*z);
+        a[q] = x/r[q];
+        b[q] = y/r[q];
+        cz[q] = z/r[q];
+        a_min = min(a_min, a[q]);
+        a_max = max(a_max, a[q]);
+        b_min = min(b_min, b[q]);
+        b_max = max(b_max, b[q]);
+      }
+    };
+
+    // U(yi,xi,component,omega_i) (yi index fastest) - field in the input
+    // plane; E_plane(omega_i,component,point) - far field at the screen
+    // points, NaN for k points beyond the Nyquist frequency of the input
+    void execute(int omegan, const double *omega, int components, const complex<double> *U, complex<double> *E_plane) const {
+      const double pi = 4.0*atan(1.0);
+      const complex<double> i(0, 1);
+      const double nan = NAN;
+      const double kx_nyquist = pi/dx, ky_nyquist = pi/dy;
+      int omega_i;
+
+      #pragma omp parallel for schedule(dynamic)
+      for (omega_i=0; omega_i<omegan; omega_i++) {
+        const double k = 2*pi/wavelength * omega[omega_i];
+
+        // k grid covering the screen points below the Nyquist frequency
+        const double kx_low = max(k*a_min, -kx_nyquist), kx_high = min(k*a_max, kx_nyquist);
+        const double ky_low = max(k*b_min, -ky_nyquist), ky_high = min(k*b_max, ky_nyquist);
+        const double kx_step = 2*pi/dx/xn/oversampling, ky_step = 2*pi/dy/yn/oversampling;
+        double kx_start, ky_start;
+        int mx, my;
+        cover(kx_low, kx_high, kx_step, kx_start, mx);
+        cover(ky_low, ky_high, ky_step, ky_start, my);
+        const bool empty = k==0 || kx_low>kx_high || ky_low>ky_high;
+
+        vector<complex<double> > H, F, work;
+        chirp_z<double> *czt_x = 0, *czt_y = 0;
+        if (!empty) {
+          czt_x = new chirp_z<double>(xn, mx, kx_start*dx, kx_step*dx);
+          czt_y = new chirp_z<double>(yn, my, ky_start*dy, ky_step*dy);
+          H.resize((size_t)yn*mx);
+          F.resize((size_t)my*mx);
+          work.resize(max(czt_x->work_size(), czt_y->work_size()));
+        }
+
+        for (int component=0; component<components; component++) {
+          const complex<double> *U_c = U + (size_t)xn*yn*(component + components*omega_i);
+          complex<double> *E_c = E_plane + omega_i + (size_t)omegan*component;
+
+          // F(ky,kx) on the grid, referenced to the center of the input plane:
+          // transform the rows H(y,kx), then the columns
+          if (!empty) {
+            for (int yi=0; yi<yn; yi++) czt_x->transform(U_c + yi, yn, &H[yi], yn, &work[0]);
+            for (int mi=0; mi<mx; mi++) czt_y->transform(&H[(size_t)yn*mi], 1, &F[mi], mx, &work[0]);
+          }
+
+          for (int q=0; q<points; q++) {
+            complex<double> &E = E_c[(size_t)omegan*components*q];
+            const double kx = k*a[q], ky = k*b[q];
+            if (k==0) {
+              E = 0;
+              continue;
+            }
+            if (fabs(kx)>kx_nyquist || fabs(ky)>ky_nyquist) {
+              E = complex<double>(nan, nan);
+              continue;
+            }
+
+            const double u = (kx-kx_start)/kx_step, v = (ky-ky_start)/ky_step;
+            const int mi = max(1, min((int)u, mx-3)), ni = max(1, min((int)v, my-3));
+            double wx[4], wy[4];
+            lagrange(u-mi, wx);
+            lagrange(v-ni, wy);
+
+            complex<double> Fq = 0;
+            for (int jy=0; jy<4; jy++) {
+              const complex<double> *row = &F[(size_t)mx*(ni-1+jy) + mi-1];
+              Fq += wy[jy] * (wx[0]*row[0] + wx[1]*row[1] + wx[2]*row[2] + wx[3]*row[3]);
+            }
+            Fq *= exp(-i*(kx*xc + ky*yc)) * dx/2.0/pi * dy/2.0/pi;
+
+            // (2.2) from http://en.wikipedia.org/w/index.php?title=Fourier_optics&oldid=557985220#The_far_field_approximation_and_the_concept_of_angular_bandwidth
+            // but with different signs because we use the exp(ikr-iwt) convention
+            E = -2*pi*i * k*cz[q] * exp(i*k*r[q])/r[q] * Fq;
+          }
+        }
+
+        delete czt_x;
+        delete czt_y;
+      }
+    };
+};
+
+#endif // end of include guard
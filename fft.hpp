@@ -0,0 +1,193 @@
+// This file provides a fast Fourier transform for arbitrary lengths, with the
+// same sign convention as Matlab's fft(), i.e.
+//   X(k) = sum_n x(n) * exp(-2*pi*i*k*n/N).
+// Powers of two are transformed by an iterative radix-2 algorithm, all other
+// lengths are reduced to a power of two by Bluestein's algorithm, which also
+// gives the chirp-z transform at arbitrary equally spaced frequencies.
+
+// include guard
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <complex>
+#include <vector>
+#include <cmath>
+
+template <typename Type>
+class fft {
+  private:
+    typedef complex<Type> cType;
+
+    int length;
+    int pow2_length;
+    vector<int> bitreverse;
+    vector<cType> twiddle;
+
+    // only used by Bluestein's algorithm
+    vector<cType> chirp;
+    vector<cType> chirp_spectrum;
+
+    // in-place radix-2 transform of pow2_length values
+    void transform_pow2(cType *data, bool inverse) const {
+      for (int i=0; i<pow2_length; i++) {
+        if (i<bitreverse[i]) swap(data[i], data[bitreverse[i]]);
+      }
+
+      for (int half=1; half<pow2_length; half*=2) {
+        const int step = pow2_length / (2*half);
+        for (int start=0; start<pow2_length; start+=2*half) {
+          for (int j=0; j<half; j++) {
+            cType w = inverse ? conj(twiddle[j*step]) : twiddle[j*step];
+            cType a = data[start+j];
+            cType b = data[start+j+half] * w;
+            data[start+j] = a + b;
+            data[start+j+half] = a - b;
+          }
+        }
+      }
+    }
+
+  public:
+    fft(int n) {
+      const Type pi = 4.0*atan(1.0);
+
+      length = n;
+      pow2_length = 1;
+      while (pow2_length<n) pow2_length *= 2;
+      if (pow2_length!=n) {
+        // Bluestein: convolution of length >= 2n-1
+        pow2_length = 1;
+        while (pow2_length<2*n-1) pow2_length *= 2;
+      }
+
+      int bits = 0;
+      while ((1<<bits)<pow2_length) bits++;
+      bitreverse.resize(pow2_length);
+      for (int i=0; i<pow2_length; i++) {
+        int r = 0;
+        for (int b=0; b<bits; b++) if (i & (1<<b)) r |= 1<<(bits-1-b);
+        bitreverse[i] = r;
+      }
+
+      twiddle.resize(pow2_length/2 + 1);
+      for (int j=0; j<(int)twiddle.size(); j++) {
+        twiddle[j] = cType(cos(2*pi*j/pow2_length), -sin(2*pi*j/pow2_length));
+      }
+
+      if (pow2_length!=n) {
+        // chirp(k) = exp(-i*pi*k^2/n); k^2 is reduced modulo 2n to keep the
+        // argument small
+        chirp.resize(n);
+        for (int k=0; k<n; k++) {
+          long long k2 = ((long long)k*k) % (2*(long long)n);
+          chirp[k] = cType(cos(pi*k2/n), -sin(pi*k2/n));
+        }
+
+        chirp_spectrum.assign(pow2_length, cType(0));
+        chirp_spectrum[0] = conj(chirp[0]);
+        for (int k=1; k<n; k++) {
+          chirp_spectrum[k] = conj(chirp[k]);
+          chirp_spectrum[pow2_length-k] = conj(chirp[k]);
+        }
+        transform_pow2(&chirp_spectrum[0], false);
+      }
+    };
+
+    int size() const {
+      return length;
+    };
+
+    // estimated number of complex multiplications for transforming n values,
+    // used to decide whether evaluating single frequency bins directly is
+    // cheaper
+    static double cost(int n) {
+      int p = 1;
+      while (p<n) p *= 2;
+      if (p==n) return 0.5 * p * log((double)p)/log(2.0);
+
+      p = 1;
+      while (p<2*n-1) p *= 2;
+      return p * log((double)p)/log(2.0) + p + 2*n;
+    };
+
+    // transforms length values in-place
+    void transform(cType *data) const {
+      if (pow2_length==length) {
+        transform_pow2(data, false);
+        return;
+      }
+
+      vector<cType> work(pow2_length, cType(0));
+      for (int k=0; k<length; k++) work[k] = data[k] * chirp[k];
+
+      transform_pow2(&work[0], false);
+      for (int k=0; k<pow2_length; k++) work[k] *= chirp_spectrum[k];
+      transform_pow2(&work[0], true);
+
+      for (int k=0; k<length; k++) data[k] = work[k] * chirp[k] / Type(pow2_length);
+    };
+};
+
+// chirp-z transform ("zoom FFT"): evaluates the discrete-time Fourier
+// transform of n values, with the phase referenced to the middle sample,
+//   X(k) = sum_j x(j) * exp(-i*(theta0 + k*dtheta)*(j - (n-1)/2)),
+// for k = 0..m-1, i.e. at m arbitrary equally spaced frequencies, with one
+// convolution of power-of-two length by Bluestein's algorithm
+template <typename Type>
+class chirp_z {
+  private:
+    typedef complex<Type> cType;
+
+    int n, m;
+    fft<Type> convolution;
+    vector<cType> pre, post, kernel_spectrum;
+
+  public:
+    chirp_z(int n_in, int m_out, double theta0, double dtheta) : n(n_in), m(m_out), convolution(1) {
+      int length = 1;
+      while (length<n+m-1) length *= 2;
+      convolution = fft<Type>(length);
+
+      // with j*k = (j^2 + k^2 - (k-j)^2)/2, the sum becomes a convolution
+      // with the chirp exp(i*dtheta*d^2/2)
+      const double center = (n-1)/2.0;
+      pre.resize(n);
+      for (int j=0; j<n; j++) {
+        double phase = -theta0*(j-center) - dtheta*j*(double)j/2;
+        pre[j] = cType(cos(phase), sin(phase));
+      }
+      post.resize(m);
+      for (int k=0; k<m; k++) {
+        double phase = dtheta*k*center - dtheta*k*(double)k/2;
+        post[k] = cType(cos(phase)/length, sin(phase)/length);
+      }
+
+      kernel_spectrum.assign(length, cType(0));
+      for (int d=-(n-1); d<m; d++) {
+        double phase = dtheta*d*(double)d/2;
+        kernel_spectrum[(d+length)%length] = cType(cos(phase), sin(phase));
+      }
+      convolution.transform(&kernel_spectrum[0]);
+    };
+
+    // number of values of the work array passed to transform
+    int work_size() const {
+      return (int)kernel_spectrum.size();
+    };
+
+    // transforms x(j) = in[j*in_stride] into X(k) = out[k*out_stride]
+    void transform(const cType *in, int in_stride, cType *out, int out_stride, cType *work) const {
+      const int length = work_size();
+      for (int j=0; j<n; j++) work[j] = in[j*in_stride] * pre[j];
+      for (int j=n; j<length; j++) work[j] = cType(0);
+
+      // convolution; the inverse transform is done as conj(fft(conj(.)))
+      convolution.transform(work);
+      for (int j=0; j<length; j++) work[j] = conj(work[j] * kernel_spectrum[j]);
+      convolution.transform(work);
+
+      for (int k=0; k<m; k++) out[k*out_stride] = conj(work[k]) * post[k];
+    };
+};
+
+#endif // end of include guard
@@ -55,6 +55,11 @@
 %       to account for ground state depletion, in 1/s
 %     config.static_ionization_rate_field (optional) -
 %       E axis for static_ionization_rate option, in V/m
+%     config.tong_lin_ionization (optional) -
+%       instead of static_ionization_rate, you can specify a struct with the
+%       config fields of hhgmax_tong_lin_ionization_rate (atom, or C, l and
+%       ionization_potential; optionally m, Z, alpha); the ionization rate and
+%       the ground state amplitude are then computed inside hhgmax_lewenstein
 %     config.ionization_potential - in eV
 %     config.tau_interval_length - how far to integrate back in time, in
 %                                  driving field periods
@@ -99,6 +104,9 @@
 %                                  to the number of electric field vector components
 %   any config fields required by config.driving_field
 %     dipole-matrix-element-specific config fields required by hhgmax_lewenstein.cpp
+%   config.threads, config.cpus (optional) - number of threads of
+%                                  hhgmax_lewenstein.cpp and the CPUs they are
+%                                  bound to (see there)
 %   progress (optional) - a struct() that contains information about the
 %                         progress of the calculation, as returned as third
 %                         return value (useful if this function is called
@@ -262,12 +270,19 @@ if isfield(config,'periodic') && config.periodic
     t_window_length = 0;
   end
 
-  % extend time axis
-  repetitions = ceil(config.tau_interval_length+config.tau_window_length+1);
   fft_length = length(t_cmc);
-  t_cmc = (0:repetitions*fft_length-1) * deltat;
-  % Fourier transformation must only be applied to right block of d_t
-  % omega must be the omega for the original t_cmc
+  if isfield(config,'method') && strcmp(config.method,'yakovlev')
+    % extend time axis, as the saddle point approximation has no periodic mode
+    repetitions = ceil(config.tau_interval_length+config.tau_window_length+1);
+    t_cmc = (0:repetitions*fft_length-1) * deltat;
+    lewenstein_config.periodic = 0;
+    % Fourier transformation must only be applied to right block of d_t
+    % omega must be the omega for the original t_cmc
+  else
+    % hhgmax_lewenstein computes d(t) for one period only, with t-tau wrapping
+    % around into the preceding periods
+    repetitions = 1;
+  end
 else
   fft_length = length(t_cmc);
   repetitions = 1;
@@ -291,6 +306,13 @@ else % avoid division by zero
 end
 t_window = cos(t_window_factor * (0:t_window_pts-1) ) .^ 2;
 
+% let hhgmax_lewenstein apply the soft window, compute the spectrum and discard
+% its irrelevant part, so that only the kept part of it is returned
+lewenstein_config.spectrum_keep = cache_keep;
+lewenstein_config.spectrum_length = fft_length;
+lewenstein_config.spectrum_window = t_window;
+lewenstein_config.spectrum_t0 = t0;
+
 % preallocate memory for return value
 data_size = [length(yv),length(xv),length(zv),components,keep_end-keep_start+1];
 response_cmc = complex(nan(data_size), nan(data_size));
@@ -369,8 +391,16 @@ if isfield(config,'static_ionization_rate')
     error('You need to specify a E axis for your ionization rates using the static_ionization_rate_field config option.');
   end
 
-  irate = 1 ./ hhgmax_sau_convert(1./config.static_ionization_rate, 't', 'SAU', config);
-  irate_E = hhgmax_sau_convert(config.static_ionization_rate_field,'E','SAU',config);
+  % the ground state amplitude is computed from the rates by hhgmax_lewenstein
+  lewenstein_config.ionization_rate = 1 ./ hhgmax_sau_convert(1./config.static_ionization_rate, 't', 'SAU', config);
+  lewenstein_config.ionization_rate_field = hhgmax_sau_convert(config.static_ionization_rate_field,'E','SAU',config);
+elseif isfield(config,'tong_lin_ionization')
+  if isfield(config,'periodic') && config.periodic
+    error('You cannot specify ionization rates for periodic mode.');
+  end
+
+  lewenstein_config.tong_lin = config.tong_lin_ionization;
+  lewenstein_config.wavelength = config.wavelength;
 elseif isfield(config,'ionization_fraction')
   % create handle for driving field function
   dotpos = strfind(config.driving_field, '.');
@@ -381,9 +411,6 @@ elseif isfield(config,'ionization_fraction')
   else
     ionization_fraction = str2func(config.ionization_fraction);
   end
-else
-  % in this case prepare ground state amplitude already here for performance
-  lewenstein_config.ground_state_amplitude = ones(1,length(t_cmc));
 end
 
 % initialize progress struct
@@ -427,7 +454,10 @@ for zi=1:length(zv)
 
   % compute dipole response spectrum from driving field, applying the soft window
   for xi=1:cache_xn
-    for yi=cache_yi
+    % collect the driving fields of all points of this column, so that their
+    % dipole responses can be computed with a single call to hhgmax_lewenstein
+    for batch_i=1:length(cache_yi)
+      yi = cache_yi(batch_i);
 
       % get driving field
       if exist('driving_field', 'var')
@@ -469,51 +499,39 @@ for zi=1:length(zv)
       % prepare driving field (for case of periodic mode)
       Et_cmc = repmat(Et_cmc, 1, repetitions);
 
+      if batch_i==1
+        Et_batch = zeros([size(Et_cmc) length(cache_yi)]);
+        if isfield(config,'ionization_fraction')
+          at_batch = ones(length(t_cmc), length(cache_yi));
+        end
+      end
+      Et_batch(:,:,batch_i) = Et_cmc;
+
       % compute time-dependent ground state amplitude if callback specified
       if isfield(config,'ionization_fraction')
         ifrac = ionization_fraction(t_cmc,Et_cmc,config);
-        lewenstein_config.ground_state_amplitude = sqrt(1 - ifrac);
+        at_batch(:,batch_i) = sqrt(1 - ifrac);
       end
+    end
 
-      % compute time-dependent ground state amplitude if static ionization rates specified
-      if isfield(config,'static_ionization_rate')
-        Eabs = sqrt(sum(real(Et_cmc).^2,1)); % |\vec E_cmc|
-        w = interp1(irate_E, irate, Eabs);
-
-        % To compute ground state amplitude |a(t)|, use
-        %   P(Ionization) = 1 - |a(t)|^2 => |a(t)| = sqrt(1 - P(Ionization))
-        % together with (6) from Tong, Lin (2005):
-        %   P(Ionization) = 1 - exp( - \int w(t) dt )
-        % but do not integrate until infinity.
-        % Note: (4) of Cao et al. (2006) is wrong, it should be |a(t)|^2 so here
-        %       we use sqrt
-        lewenstein_config.ground_state_amplitude = sqrt(exp(-cumtrapz(t_cmc,w)));
-      end
+    % compute dipole response spectra of the whole column
+    if exist('at_batch', 'var')
+      lewenstein_config.ground_state_amplitude = at_batch;
+    end
+    d_omega_batch = hhgmax_lewenstein(t_cmc, Et_batch, lewenstein_config);
+    if size(d_omega_batch,2)~=length(cache_keep)
+      error('hhgmax_lewenstein returned d(t) instead of the spectrum; please recompile it.')
+    end
 
-      % compute dipole response
-      d_t = hhgmax_lewenstein(t_cmc, Et_cmc, lewenstein_config);
-      d_t = d_t(:,length(d_t)-fft_length+1:length(d_t));
-      if size(d_t,1)~=components
+    for batch_i=1:length(cache_yi)
+      yi = cache_yi(batch_i);
+
+      d_omega = d_omega_batch(:,:,batch_i);
+      if size(d_omega,1)~=components
         error(['Got more/less components than expected from dipole response module. '...
               'Probably the driving field is non-linearly polarized, so you need to set config.components to 2 or 3 as appropriate.'])
       end
 
-      % apply soft window
-      win_start = length(t_cmc)-t_window_pts+1;
-      win_end = length(t_cmc);
-      d_t(:,win_start:win_end) = d_t(:,win_start:win_end) .* repmat(t_window,components,1);
-
-      % compute spectrum
-      d_omega = conj(fft(d_t, [], 2));
-
-      % discard irrelevant part of spectrum
-      d_omega = d_omega(:,cache_keep);
-
-      % Integration of fft starts at 0, we want to start at
-      % t0, therefore apply following exponential term.
-      % Furthermore, multiply by deltat to get units right.
-      d_omega = d_omega .* repmat(exp(-i*omega*t0),components,1) * deltat;
-
       % save relevant part of spectrum
       d_cache.set_point(xi,yi-cache_yi(1)+1,zi,d_omega);
 
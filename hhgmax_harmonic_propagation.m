@@ -1,9 +1,10 @@
 % Computes the dipole response on a spatial grid using hhgmax_dipole_response.m and
 % calculates the resulting complex field amplitude in the last z plane.
 %
-% Note: Only absorption of harmonics is considered, but effects like change
-%       of refractive index by the gas and plasma is neglected. Moreover,
-%       the divergence of the harmonics over the given z interval is neglected.
+% Note: Only absorption of harmonics and optionally the real part of the
+%       refractive index of the neutral gas are considered, but the change of
+%       refractive index by the plasma is neglected. Moreover, the divergence
+%       of the harmonics over the given z interval is neglected.
 %
 % Arguments:
 %   t_cmc - the time axis in co-moving coordinates, in scaled atomic units,
@@ -26,6 +27,18 @@
 %                                         data of used gas, in eV (only
 %                                         necessary if config.transmission is
 %                                         given)
+%     config.refractive_index_delta (optional) - decrement delta of the real
+%                                                part of the refractive index
+%                                                n = 1 - delta + i*beta of
+%                                                used gas for a pressure of
+%                                                30 torr versus photon energy
+%                                                at the considered
+%                                                temperature, obtained e.g.
+%                                                from [2]. If not given, the
+%                                                real part is assumed to be 1.
+%     config.refractive_index_photon_energy - photon energy axis for
+%                                             config.refractive_index_delta,
+%                                             in eV
 %     config.density - number density of atoms in mm^-3
 %     config.pressure (optional) - gas pressure in bar, can be used instead of
 %                                  config.density; then the density will be
@@ -48,6 +61,7 @@
 %
 % References:
 %   [1] http://henke.lbl.gov/optical_constants/gastrn2.html
+%   [2] http://henke.lbl.gov/optical_constants/getdb2.html
 %
 % Example:
 %   see PDF documentation
@@ -75,15 +89,23 @@ else
   nochecks = 0;
 end
 
+% gas data is given for 30 torr
+torr = 1.3332e-3; % in bar
+reference_density = 30*torr*1e5 / 1.3806488e-23 / 295;
+
 % get absorption data
 if isfield(config, 'transmission')
-  % convert transmission energy from eV to scaled atomic units
-  absorption_omega = hhgmax_sau_convert(config.transmission_energy*1.602176565e-19, 'U', 'SAU', dipole_response_config);
+  % convert transmission energy from eV to scaled atomic units (the option
+  % used to be read as transmission_energy)
+  if isfield(config, 'transmission_photon_energy')
+    transmission_energy = config.transmission_photon_energy;
+  else
+    transmission_energy = config.transmission_energy;
+  end
+  absorption_omega = hhgmax_sau_convert(transmission_energy*1.602176565e-19, 'U', 'SAU', dipole_response_config);
 
   % convert transmission for 1cm to absorption coefficient in mm^-1
   alpha_30torr = -log(config.transmission)/10;
-  torr = 1.3332e-3; % in bar
-  reference_density = 30*torr*1e5 / 1.3806488e-23 / 295;
   alpha = alpha_30torr * density/reference_density;
 else
   % absorption coefficient==0 over whole omega range
@@ -91,6 +113,15 @@ else
   alpha = [0 0];
 end
 
+% get real part of refractive index
+if isfield(config, 'refractive_index_delta')
+  delta_omega = hhgmax_sau_convert(config.refractive_index_photon_energy*1.602176565e-19, 'U', 'SAU', dipole_response_config);
+  delta = config.refractive_index_delta * density/reference_density;
+else
+  delta_omega = [0 1];
+  delta = [0 0];
+end
+
 % set up array for complex amplitude in current plane
 U = 0;
 
@@ -127,15 +158,16 @@ for z_i=1:length(zv)
   % interpolate to get absorption data
   absorption_coefficient = interp1(absorption_omega, alpha, omega, 'linear', 'extrap');
 
-  % compute complex refractive index (assuming real part=1 for now)
+  % compute complex refractive index
   k = omega * 2*pi/dipole_response_config.wavelength;
   kappa = absorption_coefficient / 2 ./ k;
-  n = 1 + 1i * kappa;
+  n = 1 - interp1(delta_omega, delta, omega, 'linear', 'extrap') + 1i * kappa;
 
   % compute integrand for this z value (n-1 instead of n because d is in vacuum comoving coordinates)
-  current_integrand = d * diag(exp( -1i * (n-1) .* k * current_z ));
-    % note: intentionally not using element-wise multiplication but matrix multiplication, as d has two
-    %       indices: first one is position, second one is angular frequency
+  current_integrand = bsxfun(@times, d, reshape(exp( -1i * (n-1) .* k * current_z ), 1, []));
+    % note: d has two indices: first one is position, second one is angular frequency; the phase
+    %       factor is applied to each column rather than as d*diag(...), which would need a dense
+    %       length(omega) x length(omega) matrix
 
   % n is not defined for omega==0, so set current_integrand = 0 there
   current_integrand(:, omega==0) = 0;
@@ -206,8 +238,8 @@ c_SAU = hhgmax_sau_convert(299792458, 'v', 'SAU', dipole_response_config);
 epsilon0_SAU = 1/4/pi;
 density_SAU = 1/hhgmax_sau_convert(1/density, 'V', 'SAU', dipole_response_config);
 
-U = U * diag(1i/2/epsilon0_SAU/c_SAU * omega * density_SAU ./ n .* ...
-             exp(1i * n .* k * z_max) );
+U = bsxfun(@times, U, reshape(1i/2/epsilon0_SAU/c_SAU * omega * density_SAU ./ n .* ...
+                              exp(1i * n .* k * z_max), 1, []));
 
 % U is NaN for omega=0, as n is not defined there. As U is proportional to
 % omega, we can manually set it to zero there to get rid of the NaNs.
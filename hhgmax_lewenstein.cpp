@@ -24,33 +24,154 @@ Running under Windows/Matlab after compilation:
 Arguments:
   t - time axis in scaled atomic units; must be equally spaced and start at 0
   Et - time-dependent electric field in scaled atomic units; may be one-, two-
-       or three-dimensional and must have shape dimensions x length(t)
+       or three-dimensional and must have shape dimensions x length(t); to
+       compute the dipole responses of several points in one call, pass an
+       array of shape dimensions x length(t) x points
   config - a struct() with the following fields:
-    ip - the ionization potential in scaled atomic units
+    ip - the ionization potential in scaled atomic units; a vector of K
+         ionization potentials (e.g. of the species of a gas mixture, or a
+         scan) computes the dipole responses of all of them in one pass,
+         which is much faster than K calls (see "Several species" below)
     epsilon_t - specifies the spread of the returning wave packet
     weights - weights for integration; useful for implementing soft windows.
               length of this array determines length of integration interval
-    ground_state_amplitude - time-dependent ground state amplitude, allows to
-                             account for ground state depletion. length of this
-                             array must be the same as t argument
-    dipole_method (optional) - one of 'H' (default) or 'symmetric_interpolate'
+    ground_state_amplitude (optional) - time-dependent ground state
+                             amplitude, allows to account for ground state
+                             depletion. length of this array must be the same
+                             as t argument; for several points, it may also
+                             have shape length(t) x points. Without it (and
+                             without ionization rates), there is no depletion
+    ionization_rate, ionization_rate_field (optional) - static ionization
+                             rate as function of the field strength (like
+                             static_ionization_rate and
+                             static_ionization_rate_field of
+                             hhgmax_dipole_response.m, but in scaled atomic
+                             units); the ground state amplitude is then
+                             computed for each point inside the call
+    tong_lin (optional) - struct with the fields of
+                          hhgmax_tong_lin_ionization_rate.m (atom, or
+                          ionization_potential, C and l; optionally m, Z,
+                          alpha) to compute the ground state amplitude from
+                          the formula of Tong, Lin (2005) inside the call;
+                          needs config.wavelength (in mm)
+    dipole_method (optional) - one of 'H' (default), 'symmetric_interpolate' or
+                               'tabulated'
+    method (optional) - one of 'lewenstein' (default) or 'yakovlev'; the
+                        latter sums up the contributions of the returning
+                        classical trajectories (saddle point approximation),
+                        which is much faster, also for elliptical or
+                        multi-color fields. Requires dipole_method 'H' and
+                        always computes in double precision
+    precision (optional) - one of 'double' (default), 'single' or 'mixed';
+                           'single' computes everything in single precision,
+                           'mixed' evaluates the integrand in single precision
+                           but integrates in double precision. Both are about
+                           twice as fast, but less accurate (use
+                           precision_report of pylewenstein.py to check)
+    tau_grid_stride (optional) - if larger than 1, the tau integral only uses
+                                 every tau_grid_stride-th sample of t beyond
+                                 the first tau_grid_fine periods, which
+                                 shortens the inner loop for long weights
+                                 (use tau_grid_report of pylewenstein.py to
+                                 check the accuracy); defaults to 1
+    tau_grid_fine (optional) - number of periods of tau that are sampled with
+                               the full resolution of t; defaults to 0.5
+    tau_quadrature (optional) - one of 'trapezoid' (default) or 'filon'; the
+                                latter integrates the oscillation of the phase
+                                between the samples exactly, which is more
+                                accurate for rapidly varying phases, but
+                                slower per sample
+    periodic (optional) - if nonzero, t is one period of a periodic driving
+                          field (equally spaced, without the endpoint), and
+                          dt is computed for this period as if the field had
+                          been repeated forever before; weights may then be
+                          longer than t. Only for method 'lewenstein', and
+                          not together with ionization rates
+    accuracy (optional) - tolerated absolute error of the sine and cosine of
+                          the phase (and of the other approximated functions
+                          of method 'yakovlev'); 0 (default) computes them
+                          exactly, 3e-12 or larger selects faster polynomials
+                          with errors below 3e-12, 1e-7 or larger even faster
+                          ones with errors below 1e-7 (see simd_accuracy in
+                          simd.hpp; use accuracy_report of pylewenstein.py to
+                          check the effect on the spectrum)
+    threads (optional) - number of threads of the computation; defaults to
+                         the number of the OpenMP runtime (OMP_NUM_THREADS)
+    cpus (optional) - CPU numbers (starting at 0) the threads are bound to,
+                      thread i to cpus(mod(i, numel(cpus))+1); useful for
+                      running several processes on one node without
+                      oversubscribing it (only supported on Linux)
 
     If 'H' is chosen:
       alpha (optional) - depth of hydrogen-like potential, in units of ip
-    If 'symmetric_interpolate' is chosen:
+    If 'symmetric_interpolate' or 'tabulated' is chosen:
       deltav - spacing of v axis, which is assumed to be equally spaced and to
                start at zero
       dipole_elements - D(v) axis
-
-Return value:
-  dt - time-dependent single-atom dipole response in scaled atomic units
+    If 'tabulated' is chosen, D(v) is interpolated cubically from a table over
+    v^2, which is more accurate and faster than 'symmetric_interpolate':
+      dipole_table_length (optional) - number of samples of the table;
+                                       defaults to 4*numel(dipole_elements)
+
+    Several species: with K ionization potentials, the hydrogen-like dipole
+    elements use alpha*ip of each species, while the other dipole methods
+    share their dipole elements. ground_state_amplitude may then also have
+    shape length(t) x points x K, for one amplitude per species; ionization
+    rates are shared. The return values get a trailing dimension of size K.
+
+    Trajectory decomposition: to compute the dipole responses for several
+    windows of weights (e.g. to separate the short and the long trajectories)
+    from the same evaluations of the integrand, which is much faster than one
+    call per window:
+      trajectory_decomposition (optional) - true (or 1) for the windows of
+                                            the short and the long
+                                            trajectories (returning before
+                                            and after 0.65 periods, with soft
+                                            edges of 0.01 periods, like
+                                            weights_short_trajectory and
+                                            weights_long_trajectory of
+                                            pylewenstein.py), or an array
+                                            with one window per column
+    The dipole responses are computed for weights and for each window
+    (W in total, i.e. 3 for true); weights and windows are padded with zeros
+    to the longest of them. The return values get a trailing dimension of
+    size W (after the one for the species, which is 1 for a single species).
+
+    To get the spectrum instead of the time-dependent dipole response (as
+    computed by hhgmax_dipole_response.m, but without copying d(t) back to
+    Matlab/Octave):
+      spectrum_keep - indices of the frequency bins of fft(d(t)) to return
+                      (like the keep return value of hhgmax_get_omega_axis)
+      spectrum_length (optional) - number of samples at the end of d(t) that
+                                   are transformed; defaults to numel(t)
+      spectrum_window (optional) - soft window multiplied with the last
+                                   samples of d(t) before transforming
+      spectrum_t0 (optional) - start of the original time axis, for the phase
+                               correction; defaults to 0
+
+Return values:
+  dt - time-dependent single-atom dipole response in scaled atomic units, with
+       the same shape as Et (x K for K species) (x W for W windows)
+  or, if config.spectrum_keep is given:
+  d_omega - conj(fft(dt)) for the kept frequency bins, multiplied by
+            exp(-i*omega*spectrum_t0)*deltat; has shape
+            dimensions x numel(spectrum_keep) x points (x K) (x W)
+  stats (optional) - struct with timers and counters of the computation (see
+                     lewenstein_stats in lewenstein.hpp): calls, points,
+                     prepare_seconds, tau_seconds, total_seconds, evaluations,
+                     zero_weight_evaluations, skipped_evaluations, and
+                     thread_seconds, thread_evaluations and thread_tiles with
+                     one element per thread. For method 'yakovlev', only
+                     calls, points and total_seconds are recorded
 
 */
 
 #include "lewenstein.hpp"
+#include "spectrum.hpp"
 
 using namespace std;
 #include <string>
+#include <vector>
 
 // next 3 lines needed for some versions of VC++, otherwise <complex> can't be included
 #ifdef _CHAR16T
@@ -59,19 +180,282 @@ using namespace std;
 
 #include <mex.h>
 
+// evaluates the integrand with type Type and sums up with type Acc
+// on the tau grid given by nodes (all tau_i if empty) and with the phase
+// factor of the given accuracy tier; in periodic mode, Et is
+// one period of the driving field. Without at, the ground state amplitude is
+// computed from the ionization rate (if not 0). For several species (one per
+// element of ip and dp), at and output of species s start s*at_species and
+// s*dim*N*points elements after the ones of species 0. weights has one
+// column of weights_length elements per window, and the output of window w
+// starts w*dim*N*points*species elements after the one of window 0.
+template <int dim, typename Type, typename Acc, class Elements>
+void execute_plan(int points, int N, Acc *t, Acc *Et, int weights_length, Acc *weights, int windows, Acc *at, int at_stride, int at_species, const vector<Acc> &ip, Acc epsilon_t, const vector<const Elements *> &dp, const vector<int> &nodes, bool filon, bool periodic, simd_accuracy accuracy, const ionization_rate_table *ionization, lewenstein_stats *stats, Acc *output) {
+  lewenstein_plan<dim,Type,Elements,Acc> plan(N, t, weights_length, weights, ip[0], epsilon_t, *dp[0], (int)nodes.size(), nodes.empty() ? 0 : &nodes[0], filon, periodic);
+  for (size_t s=1; s<ip.size(); s++) plan.add_species(ip[s], *dp[s], ionization);
+  for (int w=1; w<windows; w++) plan.add_window(weights_length, weights + w*weights_length);
+  plan.set_accuracy(accuracy);
+  plan.set_ionization_rate(ionization);
+  plan.set_stats(stats);
+
+  if (ip.size()==1 && windows==1) {
+    plan.execute(points, Et, at, at_stride, output);
+  }
+  else {
+    const lewenstein_layout layout = lewenstein_layout::contiguous(N, dim);
+    const ptrdiff_t species_size = (ptrdiff_t)dim*N*points;
+    plan.execute_species((int)ip.size(), points, Et, layout, at, lewenstein_layout(at_stride, 1, 0), at_species, output, layout, species_size, windows, species_size*(ptrdiff_t)ip.size());
+  }
+}
+
+// computes in the precision given as string, converting the arguments if
+// needed; dp_float must be the single precision versions of dp_double
+template <int dim, class Elements_double, class Elements_float>
+void execute_precision(const string &precision, int points, int N, double *t, double *Et, int weights_length, double *weights, int windows, double *at, int at_stride, int at_species, const vector<double> &ip, double epsilon_t, const vector<const Elements_double *> &dp_double, const vector<const Elements_float *> &dp_float, const vector<int> &nodes, bool filon, bool periodic, simd_accuracy accuracy, const ionization_rate_table *ionization, lewenstein_stats *stats, double *output) {
+  const int species = (int)ip.size();
+  if (precision=="double") {
+    execute_plan<dim,double,double,Elements_double>(points, N, t, Et, weights_length, weights, windows, at, at_stride, at_species, ip, epsilon_t, dp_double, nodes, filon, periodic, accuracy, ionization, stats, output);
+  }
+  else if (precision=="mixed") {
+    execute_plan<dim,float,double,Elements_float>(points, N, t, Et, weights_length, weights, windows, at, at_stride, at_species, ip, epsilon_t, dp_float, nodes, filon, periodic, accuracy, ionization, stats, output);
+  }
+  else {
+    vector<float> t_float(t, t+N);
+    vector<float> Et_float(Et, Et+dim*N*points);
+    vector<float> weights_float(weights, weights+weights_length*windows);
+    vector<float> at_float(at, at+(at ? (species-1)*at_species + (at_stride ? N*points : N) : 0));
+    vector<float> ip_float(ip.begin(), ip.end());
+    vector<float> output_float(dim*N*points*species*windows);
+
+    execute_plan<dim,float,float,Elements_float>(points, N, &t_float[0], &Et_float[0], weights_length, &weights_float[0], windows, at ? &at_float[0] : 0, at_stride, at_species, ip_float, (float)epsilon_t, dp_float, nodes, filon, periodic, accuracy, ionization, stats, &output_float[0]);
+
+    for (int i=0; i<dim*N*points*species*windows; i++) output[i] = output_float[i];
+  }
+}
+
+// converts the instrumentation of the plan to a struct
+mxArray *stats_struct(const lewenstein_stats &stats) {
+  const char *names[] = {"calls", "points", "prepare_seconds", "tau_seconds", "total_seconds", "evaluations", "zero_weight_evaluations", "skipped_evaluations", "thread_seconds", "thread_evaluations", "thread_tiles"};
+  const double values[] = {stats.calls, stats.points, stats.prepare_seconds, stats.tau_seconds, stats.total_seconds, stats.evaluations, stats.zero_weight_evaluations, stats.skipped_evaluations};
+  const vector<double> *per_thread[] = {&stats.thread_seconds, &stats.thread_evaluations, &stats.thread_tiles};
+
+  mxArray *result = mxCreateStructMatrix(1, 1, 11, names);
+  for (int i=0; i<8; i++) mxSetFieldByNumber(result, 0, i, mxCreateDoubleScalar(values[i]));
+  for (int i=0; i<3; i++) {
+    const vector<double> &v = *per_thread[i];
+    mxArray *array = mxCreateDoubleMatrix(1, v.size(), mxREAL);
+    for (size_t thread=0; thread<v.size(); thread++) mxGetPr(array)[thread] = v[thread];
+    mxSetFieldByNumber(result, 0, 8+i, array);
+  }
+  return result;
+}
+
+// computes the dipole responses in saddle point approximation; the ionization
+// rate is taken from the decrease of the ground state amplitude
 template <int dim>
-mxArray *call_lewenstein(int N, double *t, double *Et, const mxArray *config) {
-  mxArray *d = mxCreateDoubleMatrix(dim,N,mxREAL);
+void execute_yakovlev(int points, int N, double *t, double *Et, int weights_length, double *weights, double *at, int at_stride, double ip, simd_accuracy accuracy, double *output) {
+  vector<double> dtfraction(N);
 
-  int weights_length;
-  double ip, epsilon_t, *weights, *at, *output;
-  string dipole_method;
+  for (int point=0; point<points; point++) {
+    double *point_at = at + point*at_stride;
 
+    dtfraction[0] = 0;
+    for (int t_i=1; t_i<N; t_i++) dtfraction[t_i] = -(SQR(point_at[t_i])-SQR(point_at[t_i-1])) / (t[t_i]-t[t_i-1]);
+
+    yakovlev<dim,double>(N, t, Et + point*dim*N, weights_length, weights, 0, &dtfraction[0], point_at, ip, output + point*dim*N, accuracy);
+  }
+}
+
+// computes the spectra of the dipole responses d_t (dim x N x points) for the
+// frequency bins given by config.spectrum_keep
+template <int dim>
+mxArray *compute_spectrum(int points, int N, double *t, double *d_t, const mxArray *config) {
   mxArray *field;
 
+  field = mxGetField(config, 0, "spectrum_keep");
+  double *keep_data = mxGetPr(field);
+  int keep_length = (int)mxGetNumberOfElements(field);
+
+  int fft_length = N;
+  field = mxGetField(config, 0, "spectrum_length");
+  if (field && mxIsDouble(field)) fft_length = (int)mxGetScalar(field);
+  if (fft_length<1 || fft_length>N) mexErrMsgTxt("config.spectrum_length must be between 1 and numel(t).");
+
+  vector<int> keep(keep_length);
+  for (int i=0; i<keep_length; i++) {
+    keep[i] = (int)keep_data[i] - 1;
+    if (keep[i]<0 || keep[i]>=fft_length) mexErrMsgTxt("config.spectrum_keep contains invalid indices.");
+  }
+
+  double *window = 0;
+  int window_length = 0;
+  field = mxGetField(config, 0, "spectrum_window");
+  if (field && mxIsDouble(field)) {
+    window = mxGetPr(field);
+    window_length = (int)mxGetNumberOfElements(field);
+  }
+  if (window_length>fft_length) mexErrMsgTxt("config.spectrum_window must not be longer than spectrum_length.");
+
+  double t0 = 0;
+  field = mxGetField(config, 0, "spectrum_t0");
+  if (field && mxIsDouble(field)) t0 = mxGetScalar(field);
+
+  if (N<2) mexErrMsgTxt("t must have at least two elements to compute a spectrum.");
+
+  mwSize d_dims[3] = {dim, keep_length, points};
+  mxArray *d = mxCreateNumericArray(3, d_dims, mxDOUBLE_CLASS, mxCOMPLEX);
+  if (!keep_length) return d;
+
+  dipole_spectrum<double> spectrum(fft_length, keep_length, &keep[0], window_length, window, t0, t[1]);
+  double *d_real = mxGetPr(d);
+  double *d_imag = mxGetPi(d);
+
+  int i;
+  #pragma omp parallel for num_threads(lewenstein_get_threads())
+  for (i=0; i<points*dim; i++) {
+    const int point = i / dim;
+    const int component = i % dim;
+    vector<complex<double> > output(keep_length);
+
+    spectrum.transform(&d_t[(point*N + N-fft_length)*dim + component], dim, &output[0]);
+
+    for (int b=0; b<keep_length; b++) {
+      d_real[component + dim*(b + keep_length*point)] = real(output[b]);
+      d_imag[component + dim*(b + keep_length*point)] = imag(output[b]);
+    }
+  }
+
+  return d;
+}
+
+// reads the static ionization rate from config.ionization_rate and
+// config.ionization_rate_field, or from the Tong-Lin parameters config.tong_lin
+// (tabulated up to the largest field strength of Et); returns 0 if there is
+// neither
+template <int dim>
+ionization_rate_table *read_ionization_rate(int points, int N, double *Et, const mxArray *config) {
+  mxArray *field = mxGetField(config, 0, "ionization_rate");
+  if (field && mxIsDouble(field)) {
+    mxArray *E_field = mxGetField(config, 0, "ionization_rate_field");
+    if (!E_field || !mxIsDouble(E_field)) mexErrMsgTxt("config.ionization_rate needs an ionization_rate_field of type double.");
+    int n = (int)mxGetNumberOfElements(field);
+    if (n<2 || n!=(int)mxGetNumberOfElements(E_field)) mexErrMsgTxt("config.ionization_rate and config.ionization_rate_field must have the same length of at least 2.");
+    return new ionization_rate_table(n, mxGetPr(E_field), mxGetPr(field));
+  }
+
+  mxArray *tong_lin = mxGetField(config, 0, "tong_lin");
+  if (!tong_lin || !mxIsStruct(tong_lin)) return 0;
+
+  tong_lin_parameters p;
+  field = mxGetField(tong_lin, 0, "atom");
+  if (field && mxIsChar(field)) {
+    char *atom_str = mxArrayToString(field);
+    string atom(atom_str);
+    mxFree(atom_str);
+    if (!tong_lin_atom(atom, p)) mexErrMsgTxt("config.tong_lin.atom is not implemented.");
+  }
+  else {
+    mxArray *ip_field = mxGetField(tong_lin, 0, "ionization_potential");
+    mxArray *C_field = mxGetField(tong_lin, 0, "C");
+    mxArray *l_field = mxGetField(tong_lin, 0, "l");
+    if (!ip_field || !C_field || !l_field) mexErrMsgTxt("config.tong_lin needs an atom field, or ionization_potential, C and l fields.");
+    p.ip = mxGetScalar(ip_field);
+    p.C = mxGetScalar(C_field);
+    p.l = (int)mxGetScalar(l_field);
+
+    field = mxGetField(tong_lin, 0, "Z");
+    if (field && mxIsDouble(field)) p.Z = mxGetScalar(field);
+  }
+
+  field = mxGetField(tong_lin, 0, "m");
+  if (field && mxIsDouble(field)) p.m = (int)mxGetScalar(field);
+  field = mxGetField(tong_lin, 0, "alpha");
+  if (field && mxIsDouble(field)) p.alpha = mxGetScalar(field);
+
+  field = mxGetField(config, 0, "wavelength");
+  if (!field || !mxIsDouble(field)) mexErrMsgTxt("config.tong_lin needs a wavelength field (in mm).");
+  double E_unit, t_unit;
+  ionization_sau_units(mxGetScalar(field), E_unit, t_unit);
+
+  double E_max = 0;
+  for (int i=0; i<N*points; i++) {
+    double E_squared = 0;
+    for (int k=0; k<dim; k++) E_squared += SQR(Et[i*dim+k]);
+    E_max = max(E_max, E_squared);
+  }
+  E_max = E_max>0 ? sqrt(E_max) : 1;
+
+  return new ionization_rate_table(p, E_max, E_unit, t_unit);
+}
+
+// windows of the short and the long trajectories on the tau axis t (one
+// period is 2*pi in scaled atomic units), which are separated by the return
+// after 0.65 periods, with soft edges of 0.01 periods; like
+// weights_short_trajectory and weights_long_trajectory of pylewenstein.py
+void trajectory_windows(int N, const double *t, vector<double> &short_window, vector<double> &long_window) {
+  const double pi = 4.0*atan(1.0), soft = 0.01;
+  for (int tau_i=0; tau_i<N; tau_i++) {
+    const double periods = (t[tau_i]-t[0]) / (2*pi);
+    if (periods>1) break;
+
+    if (periods<=0.65) short_window.push_back(periods<0.65-soft ? 1 : SQR(cos((periods-(0.65-soft))/soft*pi/2)));
+    if (periods<0.65) long_window.push_back(0);
+    else if (periods<0.65+soft) long_window.push_back(SQR(sin((periods-0.65)/soft*pi/2)));
+    else if (periods<1-soft) long_window.push_back(1);
+    else long_window.push_back(SQR(cos((periods-(1-soft))/soft*pi/2)));
+  }
+}
+
+template <int dim>
+mxArray *call_lewenstein(int points, int N, double *t, double *Et, const mxArray *config, lewenstein_stats *stats) {
+  // with config.spectrum_keep, d(t) is only kept internally
+  mxArray *field = mxGetField(config, 0, "spectrum_keep");
+  bool spectrum = field && mxIsDouble(field);
+
+  // one ionization potential per species
   field = mxGetField(config, 0, "ip");
-  if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs an ip field of type double.");
-  ip = mxGetScalar(field);
+  if (!field || !mxIsDouble(field) || mxGetNumberOfElements(field)<1) mexErrMsgTxt("config needs an ip field of type double.");
+  vector<double> ip(mxGetPr(field), mxGetPr(field)+mxGetNumberOfElements(field));
+  const int species = (int)ip.size();
+
+  // config.weights and the windows of the trajectory decomposition, padded
+  // with zeros to the same length, one per column
+  field = mxGetField(config, 0, "weights");
+  if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs a weights field of type double.");
+  vector<vector<double> > columns(1, vector<double>(mxGetPr(field), mxGetPr(field)+mxGetNumberOfElements(field)));
+
+  field = mxGetField(config, 0, "trajectory_decomposition");
+  if (field && (mxIsDouble(field) || mxIsLogical(field)) && mxGetNumberOfElements(field)==1) {
+    if (mxGetScalar(field)!=0) {
+      columns.resize(3);
+      trajectory_windows(N, t, columns[1], columns[2]);
+    }
+  }
+  else if (field && mxIsDouble(field)) {
+    const int rows = (int)mxGetM(field);
+    for (int column=0; column<(int)mxGetN(field); column++) {
+      columns.push_back(vector<double>(mxGetPr(field) + column*rows, mxGetPr(field) + (column+1)*rows));
+    }
+  }
+  else if (field) {
+    mexErrMsgTxt("config.trajectory_decomposition must be of type double.");
+  }
+
+  const int windows = (int)columns.size();
+  int weights_length = 0;
+  for (int w=0; w<windows; w++) weights_length = max(weights_length, (int)columns[w].size());
+  vector<double> weights_windows(weights_length*windows, 0.0);
+  for (int w=0; w<windows; w++) copy(columns[w].begin(), columns[w].end(), weights_windows.begin() + w*weights_length);
+  double *weights = weights_length ? &weights_windows[0] : 0;
+
+  mwSize d_dims[5] = {dim, N, points, species, windows};
+  mxArray *d = spectrum ? 0 : mxCreateNumericArray(5, d_dims, mxDOUBLE_CLASS, mxREAL);
+  vector<double> d_t(spectrum ? dim*N*points*species*windows : 0);
+
+  int at_stride, at_species = 0;
+  double epsilon_t, *at, *output;
+  string dipole_method, precision, method, tau_quadrature;
+  vector<int> nodes;
 
   field = mxGetField(config, 0, "epsilon_t");
   if (!field || !mxIsDouble(field)) {
@@ -82,14 +466,26 @@ mxArray *call_lewenstein(int N, double *t, double *Et, const mxArray *config) {
   }
 
   field = mxGetField(config, 0, "ground_state_amplitude");
-  if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs a ground_state_amplitude field of type double.");
-  at = mxGetPr(field);
-  if (N!=(int)mxGetNumberOfElements(field)) mexErrMsgTxt("ground_state_amplitude should have same number of elements as t axis");
-
-  field = mxGetField(config, 0, "weights");
-  if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs a weights field of type double.");
-  weights = mxGetPr(field);
-  weights_length = (int)mxGetNumberOfElements(field);
+  if (!field || !mxIsDouble(field)) {
+    at = 0;
+    at_stride = 0;
+  }
+  else {
+    at = mxGetPr(field);
+    if (N==(int)mxGetNumberOfElements(field)) {
+      at_stride = 0;
+    }
+    else if (N*points==(int)mxGetNumberOfElements(field)) {
+      at_stride = N;
+    }
+    else if (N*points*species==(int)mxGetNumberOfElements(field)) {
+      at_stride = N;
+      at_species = N*points;
+    }
+    else {
+      mexErrMsgTxt("ground_state_amplitude should have same number of elements as t axis, or length(t) x points (x species) elements");
+    }
+  }
 
   field = mxGetField(config, 0, "dipole_method");
   if (!field || !mxIsChar(field)) {
@@ -100,47 +496,223 @@ mxArray *call_lewenstein(int N, double *t, double *Et, const mxArray *config) {
     dipole_method = string((char *)mxGetPr(field), (int)mxGetNumberOfElements(field));
   }
 
-  output = mxGetPr(d);
-
-  if (dipole_method=="H") {
-    double alpha;
+  field = mxGetField(config, 0, "precision");
+  if (!field || !mxIsChar(field)) {
+    precision = "double";
+  }
+  else {
+    char *precision_str = mxArrayToString(field);
+    precision = string(precision_str);
+    mxFree(precision_str);
+  }
+  if (precision!="double" && precision!="single" && precision!="mixed") mexErrMsgTxt("config.precision must be one of 'double', 'single' or 'mixed'.");
 
-    field = mxGetField(config, 0, "alpha");
-    if (!field || !mxIsDouble(field)) {
-      alpha = 2 * ip;
-    }
-    else {
-      alpha = mxGetScalar(field) * ip;
-    }
+  field = mxGetField(config, 0, "method");
+  if (!field || !mxIsChar(field)) {
+    method = "lewenstein";
+  }
+  else {
+    char *method_str = mxArrayToString(field);
+    method = string(method_str);
+    mxFree(method_str);
+  }
+  if (method!="lewenstein" && method!="yakovlev") mexErrMsgTxt("config.method must be one of 'lewenstein' or 'yakovlev'.");
+
+  field = mxGetField(config, 0, "tau_grid_stride");
+  int tau_grid_stride = 1;
+  if (field && mxIsDouble(field)) tau_grid_stride = (int)mxGetScalar(field);
+  if (tau_grid_stride>1 && N>1) {
+    double tau_grid_fine = 0.5;
+    field = mxGetField(config, 0, "tau_grid_fine");
+    if (field && mxIsDouble(field)) tau_grid_fine = mxGetScalar(field);
+
+    // one period is 2*pi in scaled atomic units
+    int fine = (int)ceil(tau_grid_fine*8.0*atan(1.0)/t[1]);
+    nodes.resize(lewenstein_graded_nodes(weights_length, fine, tau_grid_stride, 0));
+    lewenstein_graded_nodes(weights_length, fine, tau_grid_stride, &nodes[0]);
+  }
 
-    dipole_elements_H<dim,double> dp(alpha);
-    lewenstein<dim,double>(N, t, Et, weights_length, weights, at, ip, epsilon_t, dp, output);
+  field = mxGetField(config, 0, "tau_quadrature");
+  if (!field || !mxIsChar(field)) {
+    tau_quadrature = "trapezoid";
+  }
+  else {
+    char *tau_quadrature_str = mxArrayToString(field);
+    tau_quadrature = string(tau_quadrature_str);
+    mxFree(tau_quadrature_str);
   }
-  else if (dipole_method=="symmetric_interpolate") {
+  if (tau_quadrature!="trapezoid" && tau_quadrature!="filon") mexErrMsgTxt("config.tau_quadrature must be one of 'trapezoid' or 'filon'.");
+
+  field = mxGetField(config, 0, "periodic");
+  bool periodic = field && mxIsDouble(field) && mxGetScalar(field)!=0;
+  if (periodic && method!="lewenstein") mexErrMsgTxt("config.periodic is only supported by method 'lewenstein'.");
+  if (periodic && N<2) mexErrMsgTxt("t must have at least two elements for config.periodic.");
+
+  field = mxGetField(config, 0, "accuracy");
+  double tolerance = 0;
+  if (field && mxIsDouble(field)) tolerance = mxGetScalar(field);
+  if (!(tolerance>=0)) mexErrMsgTxt("config.accuracy must not be negative.");
+  simd_accuracy accuracy = simd_accuracy_for(tolerance);
+
+  // the fields of the interpolated dipole elements are checked before the
+  // ionization rates are allocated, so that these errors do not leak them
+  double deltap = 0;
+  double *dipole_real = 0, *dipole_imag = 0;
+  int dipole_length = 0, table_length = 0;
+  if (method!="yakovlev" && (dipole_method=="symmetric_interpolate" || dipole_method=="tabulated")) {
     field = mxGetField(config, 0, "deltav");
     if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs a deltav field of type double for this dipole_method.");
-    double deltap = mxGetScalar(field);
+    deltap = mxGetScalar(field);
 
     field = mxGetField(config, 0, "dipole_elements");
     if (!field || !mxIsDouble(field)) mexErrMsgTxt("config needs a dipole_elements field of type double for this dipole_method.");
-    double *dipole_real = mxGetPr(field);
-    int dipole_length = mxGetNumberOfElements(field);
-    double *dipole_imag = mxGetPi(field);
+    dipole_real = mxGetPr(field);
+    dipole_length = mxGetNumberOfElements(field);
+    dipole_imag = mxGetPi(field);
     if (!dipole_imag)  mexErrMsgTxt("config.dipole_elements must be complex.");
 
-    dipole_elements_symmetric_interpolate<dim,double> dp(dipole_length, deltap, dipole_real, dipole_imag);
-    lewenstein<dim,double>(N, t, Et, weights_length, weights, at, ip, epsilon_t, dp, output);
+    if (dipole_method=="tabulated") {
+      if (dipole_length<2) mexErrMsgTxt("config.dipole_elements needs at least two elements.");
+
+      table_length = 4*dipole_length;
+      field = mxGetField(config, 0, "dipole_table_length");
+      if (field && mxIsDouble(field)) table_length = (int)mxGetScalar(field);
+      if (table_length<2) mexErrMsgTxt("config.dipole_table_length must be at least 2.");
+    }
+  }
+
+  // ionization rates for computing the ground state amplitude natively
+  const ionization_rate_table *ionization = 0;
+  if (!at) ionization = read_ionization_rate<dim>(points, N, Et, config);
+  if (ionization && periodic) {
+    delete ionization;
+    mexErrMsgTxt("config.periodic cannot be combined with ionization rates.");
+  }
+
+  output = spectrum ? &d_t[0] : mxGetPr(d);
+
+  if (method=="yakovlev") {
+    if (dipole_method!="H") {
+      delete ionization;
+      mexErrMsgTxt("config.method 'yakovlev' only supports dipole_method 'H'.");
+    }
+
+    // the saddle point model needs the ground state amplitudes themselves
+    vector<double> at_points(at ? 0 : N*points, 1.0);
+    if (!at) {
+      if (ionization) {
+        int point;
+        #pragma omp parallel for num_threads(lewenstein_get_threads())
+        for (point=0; point<points; point++) {
+          ionization->ground_state_amplitude(N, dim, t, Et + point*dim*N, &at_points[point*N]);
+        }
+      }
+      at = &at_points[0];
+      at_stride = N;
+    }
+
+    const double time_start = lewenstein_time();
+    for (int w=0; w<windows; w++) {
+      for (int s=0; s<species; s++) {
+        execute_yakovlev<dim>(points, N, t, Et, weights_length, weights + w*weights_length, at + s*at_species, at_stride, ip[s], accuracy, output + (w*species+s)*dim*N*points);
+      }
+    }
+    if (stats) {
+      stats->calls++;
+      stats->points += points;
+      stats->total_seconds += lewenstein_time() - time_start;
+    }
+  }
+  else if (dipole_method=="H") {
+    double alpha_factor;
+
+    field = mxGetField(config, 0, "alpha");
+    if (!field || !mxIsDouble(field)) {
+      alpha_factor = 2;
+    }
+    else {
+      alpha_factor = mxGetScalar(field);
+    }
+
+    // alpha depends on the ionization potential of each species
+    vector<dipole_elements_H<dim,double> > dp;
+    vector<dipole_elements_H<dim,float> > dp_float;
+    for (int s=0; s<species; s++) {
+      double alpha = alpha_factor * ip[s];
+      dp.push_back(dipole_elements_H<dim,double>(alpha));
+      dp_float.push_back(dipole_elements_H<dim,float>((float)alpha));
+    }
+    vector<const dipole_elements_H<dim,double> *> dp_species;
+    vector<const dipole_elements_H<dim,float> *> dp_float_species;
+    for (int s=0; s<species; s++) {
+      dp_species.push_back(&dp[s]);
+      dp_float_species.push_back(&dp_float[s]);
+    }
+    execute_precision<dim>(precision, points, N, t, Et, weights_length, weights, windows, at, at_stride, at_species, ip, epsilon_t, dp_species, dp_float_species, nodes, tau_quadrature=="filon", periodic, accuracy, ionization, stats, output);
+  }
+  else if (dipole_method=="symmetric_interpolate" || dipole_method=="tabulated") {
+    if (dipole_method=="tabulated") {
+      vector<double> g_real(table_length), g_imag(table_length);
+      double ds = dipole_elements_tabulate_radial(dipole_length, deltap, dipole_real, dipole_imag, table_length, &g_real[0], &g_imag[0]);
+
+      // shared by all species
+      dipole_elements_tabulated<dim,double> dp(table_length, ds, &g_real[0], &g_imag[0]);
+      dipole_elements_tabulated<dim,float> dp_float(table_length, ds, &g_real[0], &g_imag[0]);
+      vector<const dipole_elements_tabulated<dim,double> *> dp_species(species, &dp);
+      vector<const dipole_elements_tabulated<dim,float> *> dp_float_species(species, &dp_float);
+      execute_precision<dim>(precision, points, N, t, Et, weights_length, weights, windows, at, at_stride, at_species, ip, epsilon_t, dp_species, dp_float_species, nodes, tau_quadrature=="filon", periodic, accuracy, ionization, stats, output);
+    }
+    else {
+      vector<float> dipole_real_float(dipole_real, dipole_real+dipole_length);
+      vector<float> dipole_imag_float(dipole_imag, dipole_imag+dipole_length);
+
+      dipole_elements_symmetric_interpolate<dim,double> dp(dipole_length, deltap, dipole_real, dipole_imag);
+      dipole_elements_symmetric_interpolate<dim,float> dp_float(dipole_length, (float)deltap, &dipole_real_float[0], &dipole_imag_float[0]);
+      vector<const dipole_elements_symmetric_interpolate<dim,double> *> dp_species(species, &dp);
+      vector<const dipole_elements_symmetric_interpolate<dim,float> *> dp_float_species(species, &dp_float);
+      execute_precision<dim>(precision, points, N, t, Et, weights_length, weights, windows, at, at_stride, at_species, ip, epsilon_t, dp_species, dp_float_species, nodes, tau_quadrature=="filon", periodic, accuracy, ionization, stats, output);
+    }
   }
   else {
+    delete ionization;
     mexErrMsgTxt("Unknown dipole_method.");
   }
+  delete ionization;
+
+  // the spectra of all species and windows, with trailing dimensions for them
+  if (spectrum) {
+    d = compute_spectrum<dim>(points*species*windows, N, t, &d_t[0], config);
+    mwSize spectrum_dims[5] = {dim, mxGetDimensions(d)[1], points, species, windows};
+    mxSetDimensions(d, spectrum_dims, 5);
+  }
 
   return d;
 }
 
+// applies config.threads and config.cpus to the following computation; the
+// settings of a previous call are reset if they are not given
+void set_threads(const mxArray *config) {
+  mxArray *field = mxGetField(config, 0, "threads");
+  int threads = 0;
+  if (field && mxIsDouble(field)) threads = (int)mxGetScalar(field);
+  if (threads<0) mexErrMsgTxt("config.threads must not be negative.");
+  lewenstein_set_threads(threads);
+
+  vector<int> cpus;
+  field = mxGetField(config, 0, "cpus");
+  if (field && mxIsDouble(field)) {
+    double *cpus_data = mxGetPr(field);
+    for (int i=0; i<(int)mxGetNumberOfElements(field); i++) {
+      if (cpus_data[i]<0) mexErrMsgTxt("config.cpus must not be negative.");
+      cpus.push_back((int)cpus_data[i]);
+    }
+  }
+  if (!lewenstein_set_affinity((int)cpus.size(), cpus.empty() ? 0 : &cpus[0])) mexErrMsgTxt("config.cpus is only supported on Linux.");
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
-  int N, dim;
+  int N, dim, points;
   double *t, *Et;
   mxArray *d;
 
@@ -149,7 +721,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   else if (!mxIsDouble(prhs[0])) mexErrMsgTxt("t must be double.");
   else if (!mxIsDouble(prhs[1])) mexErrMsgTxt("Et must be double.");
   else if (!mxIsStruct(prhs[2])) mexErrMsgTxt("config must be struct.");
-  else if (nlhs > 1) {
+  else if (nlhs > 2) {
     mexErrMsgTxt("Too many output arguments.");
   }
 
@@ -158,18 +730,26 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   t = mxGetPr(prhs[0]);
   Et = mxGetPr(prhs[1]);
 
-  if (mxGetNumberOfDimensions(prhs[1]) != 2) mexErrMsgTxt("Et must be a matrix.");
+  if (mxGetNumberOfDimensions(prhs[1]) > 3) mexErrMsgTxt("Et must be a matrix or a three-dimensional array.");
   const mwSize *EtDim = mxGetDimensions(prhs[1]);
   dim = EtDim[0];
-  if (EtDim[1] != N || dim < 1 || dim > 3) mexErrMsgTxt("Et must have shape dimensions x numel(t), with dimensions = 1/2/3.");
+  if (EtDim[1] != N || dim < 1 || dim > 3) mexErrMsgTxt("Et must have shape dimensions x numel(t) or dimensions x numel(t) x points, with dimensions = 1/2/3.");
+  points = 1;
+  if (mxGetNumberOfDimensions(prhs[1]) == 3) points = EtDim[2];
 
   // make sure t(1) is zero
   if (abs(t[0]) > 1e-20) mexErrMsgTxt("t(1) must be zero.");
 
   // case-by-case for different numbers of dimensions
-  if (dim==1) d = call_lewenstein<1>(N, t, Et, prhs[2]);
-  else if (dim==2) d = call_lewenstein<2>(N, t, Et, prhs[2]);
-  else if (dim==3) d = call_lewenstein<3>(N, t, Et, prhs[2]);
+  // the instrumentation is only switched on if stats are requested
+  lewenstein_stats stats;
+  lewenstein_stats *stats_pointer = nlhs>1 ? &stats : 0;
+  set_threads(prhs[2]);
+
+  if (dim==1) d = call_lewenstein<1>(points, N, t, Et, prhs[2], stats_pointer);
+  else if (dim==2) d = call_lewenstein<2>(points, N, t, Et, prhs[2], stats_pointer);
+  else if (dim==3) d = call_lewenstein<3>(points, N, t, Et, prhs[2], stats_pointer);
 
   plhs[0] = d;
+  if (nlhs>1) plhs[1] = stats_struct(stats);
 }
@@ -0,0 +1,160 @@
+// This file provides the ground state depletion of the Lewenstein model
+// natively: static field ionization rates w(|E|), either from the empirical
+// formula of Tong, Lin (2005) (the ADK formula with a correction for higher
+// field strengths, as in hhgmax_tong_lin_ionization_rate.m) or from a table
+// (as the static_ionization_rate option of hhgmax_dipole_response.m), and the
+// ground state amplitude
+//   a(t) = sqrt(exp(-int_0^t w(|E(t')|) dt'))
+// computed from them, see hhgmax_dipole_response.m. All quantities are in the
+// units of the driving field, usually scaled atomic units.
+
+// include guard
+#ifndef IONIZATION_HPP
+#define IONIZATION_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+// number of samples of the table of the Tong-Lin formula
+#define IONIZATION_TABLE_LENGTH 16384
+
+// parameters of the Tong-Lin formula, with ip in eV
+struct tong_lin_parameters {
+  double ip, C, Z, alpha;
+  int l, m;
+
+  tong_lin_parameters() : ip(0), C(0), Z(1), alpha(0), l(0), m(0) {};
+};
+
+// sets the parameters for one of the atoms known to
+// hhgmax_tong_lin_ionization_rate.m (table II of Tong, Zhao, Lin (2002), alpha
+// as suggested in the penultimate paragraph of p. 2596 of Tong, Lin (2005));
+// the name is case-insensitive. Returns false for unknown atoms.
+inline bool tong_lin_atom(const string &atom, tong_lin_parameters &p) {
+  string name = atom;
+  for (size_t i=0; i<name.size(); i++) name[i] = (char)tolower(name[i]);
+
+  p.Z = 1;
+  p.alpha = 9.0;
+  p.l = 1;
+  if (name=="xe") { p.ip = 12.13; p.C = 2.57; }
+  else if (name=="ar") { p.ip = 15.762; p.C = 2.44; }
+  else if (name=="ne") { p.ip = 21.565; p.C = 2.10; }
+  else if (name=="he") { p.ip = 24.5872; p.C = 3.13; p.l = 0; p.alpha = 6.0; }
+  else if (name=="kr") { p.ip = 14.0; p.C = 2.49; }
+  else return false;
+
+  return true;
+}
+
+inline double ionization_factorial(int n) {
+  double f = 1;
+  for (int i=2; i<=n; i++) f *= i;
+  return f;
+}
+
+// ionization rate for the field strength F, both in atomic units; (2) and (3)
+// of Tong, Lin (2005)
+inline double tong_lin_rate(double F, const tong_lin_parameters &p) {
+  if (F==0) return 0;
+
+  const double Ip = p.ip*1.602176565e-19 / 4.35974417e-18;
+  const double kappa = sqrt(2*Ip);
+  const int m = abs(p.m);
+
+  return SQR(p.C) / pow(2.0, m) / ionization_factorial(m)
+    * (2*p.l+1)*ionization_factorial(p.l+m) / 2 / ionization_factorial(p.l-m)
+    / pow(kappa, 2*p.Z/kappa - 1)
+    * pow(2*kappa*kappa*kappa/F, 2*p.Z/kappa - m - 1)
+    * exp(-2.0/3.0 * kappa*kappa*kappa/F)
+    * exp(-p.alpha * (SQR(p.Z)/Ip) * (F/(kappa*kappa*kappa))); // correction
+}
+
+// sets E_unit and t_unit to the units of the field strength and of time in
+// scaled atomic units (see hhgmax_sau_convert.m), expressed in atomic units,
+// for the wavelength in millimeters
+inline void ionization_sau_units(double wavelength, double &E_unit, double &t_unit) {
+  const double pi = 4.0*atan(1.0);
+  const double c = 299792458;
+  const double hbar = 1.054571726e-34;
+  const double eq = 1.602176565e-19;
+  const double a0 = 5.2917721092e-11;
+  const double Ry = 13.60569253*eq;
+
+  const double t_SI = (wavelength*1e-3) / c / (2*pi);
+  const double U_SI = hbar / t_SI;
+  const double E_SI = U_SI / eq / (a0 * sqrt(2*Ry/U_SI));
+
+  E_unit = E_SI / 5.14220652e11;
+  t_unit = t_SI / 2.418884326505e-17;
+}
+
+// ionization rate w(|E|), interpolated linearly in a table. A table of given
+// values behaves like interp1, i.e. it is NaN outside of the given |E| axis.
+// A table of the Tong-Lin formula is equally spaced, so that it is indexed
+// directly, and falls back to the formula beyond its end.
+class ionization_rate_table {
+  private:
+    vector<double> E, w;
+    bool formula;
+    double inv_dE;
+    tong_lin_parameters parameters;
+    double E_unit, t_unit;
+
+  public:
+    // table of n given rates w_data at the increasing field strengths E_data
+    ionization_rate_table(int n, const double *E_data, const double *w_data) : E(E_data, E_data+n), w(w_data, w_data+n), formula(false), inv_dE(0), E_unit(1), t_unit(1) {
+    };
+
+    // table of the Tong-Lin formula for field strengths up to E_max, where
+    // the units of the field strength and of time are E_unit and t_unit
+    // atomic units, respectively
+    ionization_rate_table(const tong_lin_parameters &p, double E_max, double E_unit_au, double t_unit_au, int n=IONIZATION_TABLE_LENGTH) : E(n), w(n), formula(true), parameters(p), E_unit(E_unit_au), t_unit(t_unit_au) {
+      inv_dE = (n-1)/E_max;
+      for (int i=0; i<n; i++) {
+        E[i] = i*E_max/(n-1);
+        w[i] = tong_lin_rate(E[i]*E_unit, p) * t_unit;
+      }
+    };
+
+    double get(double E_abs) const {
+      const int n = (int)E.size();
+
+      if (formula) {
+        const double x = E_abs*inv_dE;
+        if (x>=n-1) return tong_lin_rate(E_abs*E_unit, parameters) * t_unit;
+        const int i = (int)x;
+        return w[i] + (w[i+1]-w[i]) * (x-i);
+      }
+
+      if (!(E_abs>=E[0] && E_abs<=E[n-1])) return NAN;
+      int i = (int)(upper_bound(E.begin(), E.end(), E_abs) - E.begin()) - 1;
+      if (i>=n-1) i = n-2;
+      return w[i] + (w[i+1]-w[i]) * (E_abs-E[i]) / (E[i+1]-E[i]);
+    };
+
+    // computes the ground state amplitude at(t) for the driving field
+    // Et(dim,t) (component index fastest), integrating the rate with the
+    // trapezoidal rule like cumtrapz
+    template <typename In, typename Type>
+    void ground_state_amplitude(const int N, const int dim, const In *t, const In *Et, Type *at) const {
+      double integral = 0, w_before = 0;
+
+      for (int t_i=0; t_i<N; t_i++) {
+        double Eabs = 0;
+        for (int k=0; k<dim; k++) Eabs += SQR(double(Et[t_i*dim+k]));
+        const double w_now = get(sqrt(Eabs));
+
+        if (t_i>0) integral += double(t[t_i]-t[t_i-1]) * (w_now+w_before)/2;
+        w_before = w_now;
+
+        at[t_i] = Type(sqrt(exp(-integral)));
+      }
+    };
+};
+
+#endif // end of include guard
@@ -8,6 +8,10 @@ Compilation for Linux (compiler is needed; e.g. on Ubuntu: `sudo aptitude instal
 
   Notes:
     * option -ffast-math will improve speed by 10% but might be unsafe
+    * the time-critical loops are compiled for SSE2, AVX2 and AVX-512 and the
+      best variant is chosen at runtime (see simd.hpp), so there is no need
+      for -march=native; set HHGMAX_SIMD=generic or HHGMAX_SIMD=avx2 to
+      restrict the instruction set
 
 Compilation for Windows with MinGW, 64 bit (either on Windows or cross-compile on Linux):
   x86_64-w64-mingw32-c++ -m64 -shared -o dll64/lewenstein.dll lewenstein.cpp -fopenmp -O3 -ansi
@@ -20,91 +24,688 @@ For 32 bit:
 
 #include "lewenstein.hpp"
 
+// Dipole elements are passed to Python as opaque pointer to this struct, which
+// records the class of the dipole elements, so that the specialization of
+// lewenstein() for this class can be called. The dipole elements are created
+// both for double and single precision, the latter using the float copy of
+// their data.
+enum dipole_elements_kind {
+  DIPOLE_ELEMENTS_H,
+  DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE,
+  DIPOLE_ELEMENTS_TABULATED
+};
+
+struct dipole_elements_handle {
+  dipole_elements_kind kind;
+  int dims;
+  void *elements;
+  void *elements_float;
+  float *data_float;
+};
+
+// returns the dipole elements of the handle for the given precision
+template <typename Type>
+void *handle_elements(dipole_elements_handle *dp);
+
+template <>
+void *handle_elements<double>(dipole_elements_handle *dp) {
+  return dp->elements;
+}
+
+template <>
+void *handle_elements<float>(dipole_elements_handle *dp) {
+  return dp->elements_float;
+}
+
+// evaluates the integrand with type Type and sums up with type Acc, using the
+// dipole elements cast to their actual class
+template <int dim, typename Type, typename Acc>
+void dispatch_lewenstein_batch(int points, int N, Acc *t, Acc *Et, int weights_length, Acc *weights, Acc *at, int at_stride, Acc ip, Acc epsilon_t, dipole_elements_handle *dp, Acc *output) {
+  if (dp->kind==DIPOLE_ELEMENTS_H) {
+    lewenstein_plan<dim,Type,dipole_elements_H<dim,Type>,Acc> plan(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_H<dim,Type> *)handle_elements<Type>(dp));
+    plan.execute(points, Et, at, at_stride, output);
+  }
+  else if (dp->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    lewenstein_plan<dim,Type,dipole_elements_symmetric_interpolate<dim,Type>,Acc> plan(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_symmetric_interpolate<dim,Type> *)handle_elements<Type>(dp));
+    plan.execute(points, Et, at, at_stride, output);
+  }
+  else if (dp->kind==DIPOLE_ELEMENTS_TABULATED) {
+    lewenstein_plan<dim,Type,dipole_elements_tabulated<dim,Type>,Acc> plan(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_tabulated<dim,Type> *)handle_elements<Type>(dp));
+    plan.execute(points, Et, at, at_stride, output);
+  }
+}
+
+template <typename Type, typename Acc>
+void dispatch_lewenstein_batch_dims(int dims, int points, int N, Acc *t, Acc *Et, int weights_length, Acc *weights, Acc *at, int at_stride, Acc ip, Acc epsilon_t, void *dp, Acc *output) {
+  if (dims==1) {
+    dispatch_lewenstein_batch<1,Type,Acc>(points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, (dipole_elements_handle *)dp, output);
+  }
+  else if (dims==2) {
+    dispatch_lewenstein_batch<2,Type,Acc>(points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, (dipole_elements_handle *)dp, output);
+  }
+  else if (dims==3) {
+    dispatch_lewenstein_batch<3,Type,Acc>(points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, (dipole_elements_handle *)dp, output);
+  }
+}
+
+// Plans are passed to Python as opaque pointer to this struct, which records
+// the class of the plan's dipole elements
+struct lewenstein_plan_handle {
+  dipole_elements_kind kind;
+  int dims;
+  void *plan;
+};
+
+template <int dim>
+void *dispatch_lewenstein_plan_create(int N, double *t, int weights_length, double *weights, double ip, double epsilon_t, dipole_elements_handle *dp, int nodes_length, int *nodes, bool filon, bool periodic) {
+  if (dp->kind==DIPOLE_ELEMENTS_H) {
+    return new lewenstein_plan<dim,double,dipole_elements_H<dim,double> >(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_H<dim,double> *)handle_elements<double>(dp), nodes_length, nodes, filon, periodic);
+  }
+  else if (dp->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    return new lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> >(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_symmetric_interpolate<dim,double> *)handle_elements<double>(dp), nodes_length, nodes, filon, periodic);
+  }
+  else if (dp->kind==DIPOLE_ELEMENTS_TABULATED) {
+    return new lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> >(N, t, weights_length, weights, ip, epsilon_t, *(dipole_elements_tabulated<dim,double> *)handle_elements<double>(dp), nodes_length, nodes, filon, periodic);
+  }
+  return 0;
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_execute(lewenstein_plan_handle *plan, int points, double *Et, double *at, int at_stride, double *output) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->execute(points, Et, at, at_stride, output);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->execute(points, Et, at, at_stride, output);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->execute(points, Et, at, at_stride, output);
+  }
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_execute_strided(lewenstein_plan_handle *plan, int points, const double *Et, const lewenstein_layout &Et_layout, const double *at, const lewenstein_layout &at_layout, double *output, const lewenstein_layout &output_layout) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->execute_strided(points, Et, Et_layout, at, at_layout, output, output_layout);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->execute_strided(points, Et, Et_layout, at, at_layout, output, output_layout);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->execute_strided(points, Et, Et_layout, at, at_layout, output, output_layout);
+  }
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_execute_species(lewenstein_plan_handle *plan, int species_count, int window_count, int points, const double *Et, const lewenstein_layout &Et_layout, const double *at, const lewenstein_layout &at_layout, ptrdiff_t at_species, double *output, const lewenstein_layout &output_layout, ptrdiff_t output_species, ptrdiff_t output_window) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->execute_species(species_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_species, window_count, output_window);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->execute_species(species_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_species, window_count, output_window);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->execute_species(species_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_species, window_count, output_window);
+  }
+}
+
+template <int dim>
+int dispatch_lewenstein_plan_add_species(lewenstein_plan_handle *plan, double ip, dipole_elements_handle *dp, const ionization_rate_table *rate) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    return ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->add_species(ip, *(dipole_elements_H<dim,double> *)dp->elements, rate);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    return ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->add_species(ip, *(dipole_elements_symmetric_interpolate<dim,double> *)dp->elements, rate);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    return ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->add_species(ip, *(dipole_elements_tabulated<dim,double> *)dp->elements, rate);
+  }
+  return -1;
+}
+
+template <int dim>
+int dispatch_lewenstein_plan_add_window(lewenstein_plan_handle *plan, int weights_length, const double *weights) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    return ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->add_window(weights_length, weights);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    return ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->add_window(weights_length, weights);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    return ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->add_window(weights_length, weights);
+  }
+  return -1;
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_set_ionization_rate(lewenstein_plan_handle *plan, const ionization_rate_table *rate) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->set_ionization_rate(rate);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->set_ionization_rate(rate);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->set_ionization_rate(rate);
+  }
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_set_stats(lewenstein_plan_handle *plan, lewenstein_stats *stats) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->set_stats(stats);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->set_stats(stats);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->set_stats(stats);
+  }
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_set_accuracy(lewenstein_plan_handle *plan, simd_accuracy accuracy) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    ((lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan)->set_accuracy(accuracy);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    ((lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan)->set_accuracy(accuracy);
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    ((lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan)->set_accuracy(accuracy);
+  }
+}
+
+template <int dim>
+void dispatch_lewenstein_plan_destroy(lewenstein_plan_handle *plan) {
+  if (plan->kind==DIPOLE_ELEMENTS_H) {
+    delete (lewenstein_plan<dim,double,dipole_elements_H<dim,double> > *)plan->plan;
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+    delete (lewenstein_plan<dim,double,dipole_elements_symmetric_interpolate<dim,double> > *)plan->plan;
+  }
+  else if (plan->kind==DIPOLE_ELEMENTS_TABULATED) {
+    delete (lewenstein_plan<dim,double,dipole_elements_tabulated<dim,double> > *)plan->plan;
+  }
+}
+
 extern "C" {
   // expose H dipole elements (constructor and destructor)
   void *dipole_elements_H_double(int dims, double alpha) {
+    dipole_elements_handle *handle = new dipole_elements_handle;
+    handle->kind = DIPOLE_ELEMENTS_H;
+    handle->dims = dims;
+    handle->data_float = 0;
+
     if (dims==1) {
-      dipole_elements_H<1,double> *elements = new dipole_elements_H<1,double>(alpha);
-      return elements;
+      handle->elements = new dipole_elements_H<1,double>(alpha);
+      handle->elements_float = new dipole_elements_H<1,float>(alpha);
     }
     else if (dims==2) {
-      dipole_elements_H<2,double> *elements = new dipole_elements_H<2,double>(alpha);
-      return elements;
+      handle->elements = new dipole_elements_H<2,double>(alpha);
+      handle->elements_float = new dipole_elements_H<2,float>(alpha);
     }
     else if (dims==3) {
-      dipole_elements_H<3,double> *elements = new dipole_elements_H<3,double>(alpha);
-      return elements;
+      handle->elements = new dipole_elements_H<3,double>(alpha);
+      handle->elements_float = new dipole_elements_H<3,float>(alpha);
     }
     else {
-       return 0;
+      delete handle;
+      return 0;
     }
+
+    return handle;
   }
 
-  void dipole_elements_H_double_destroy(int dims, void *ptr) {
+  // expose symmetric interpolated dipole elements (constructor); dr and di
+  // are referenced by the double precision dipole elements and must stay
+  // alive, while the single precision dipole elements use a copy
+  void *dipole_elements_symmetric_interpolate_double(int dims, int N, double dp, double *dr, double *di) {
+    if (dims<1 || dims>3) return 0;
+
+    dipole_elements_handle *handle = new dipole_elements_handle;
+    handle->kind = DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE;
+    handle->dims = dims;
+
+    handle->data_float = new float[2*N];
+    float *dr_float = handle->data_float;
+    float *di_float = handle->data_float + N;
+    for (int i=0; i<N; i++) {
+      dr_float[i] = (float)dr[i];
+      di_float[i] = (float)di[i];
+    }
+
     if (dims==1) {
-      dipole_elements_H<1,double> *elements = (dipole_elements_H<1,double> *)ptr;
-      delete elements;
+      handle->elements = new dipole_elements_symmetric_interpolate<1,double>(N,dp,dr,di);
+      handle->elements_float = new dipole_elements_symmetric_interpolate<1,float>(N,(float)dp,dr_float,di_float);
     }
     else if (dims==2) {
-      dipole_elements_H<2,double> *elements = (dipole_elements_H<2,double> *)ptr;
-      delete elements;
+      handle->elements = new dipole_elements_symmetric_interpolate<2,double>(N,dp,dr,di);
+      handle->elements_float = new dipole_elements_symmetric_interpolate<2,float>(N,(float)dp,dr_float,di_float);
     }
     else if (dims==3) {
-      dipole_elements_H<3,double> *elements = (dipole_elements_H<3,double> *)ptr;
-      delete elements;
+      handle->elements = new dipole_elements_symmetric_interpolate<3,double>(N,dp,dr,di);
+      handle->elements_float = new dipole_elements_symmetric_interpolate<3,float>(N,(float)dp,dr_float,di_float);
     }
+
+    return handle;
   }
 
-  // expose symmetric interpolated dipole elements (constructor and destructor)
-  void *dipole_elements_symmetric_interpolate_double(int dims, int N, double dp, double *dr, double *di) {
+  // expose dipole elements tabulated over |p|^2 (constructor), from the same
+  // radial data as for the symmetric interpolated dipole elements; the table
+  // has table_length samples, and dr and di are not referenced afterwards
+  void *dipole_elements_tabulated_double(int dims, int N, double dp, double *dr, double *di, int table_length) {
+    if (dims<1 || dims>3 || N<2 || table_length<2) return 0;
+
+    dipole_elements_handle *handle = new dipole_elements_handle;
+    handle->kind = DIPOLE_ELEMENTS_TABULATED;
+    handle->dims = dims;
+    handle->data_float = 0;
+
+    vector<double> g_real(table_length), g_imag(table_length);
+    double ds = dipole_elements_tabulate_radial(N, dp, dr, di, table_length, &g_real[0], &g_imag[0]);
+
     if (dims==1) {
-      dipole_elements_symmetric_interpolate<1,double> *elements = new dipole_elements_symmetric_interpolate<1,double>(N,dp,dr,di);
-      return elements;
+      handle->elements = new dipole_elements_tabulated<1,double>(table_length, ds, &g_real[0], &g_imag[0]);
+      handle->elements_float = new dipole_elements_tabulated<1,float>(table_length, ds, &g_real[0], &g_imag[0]);
     }
     else if (dims==2) {
-      dipole_elements_symmetric_interpolate<2,double> *elements = new dipole_elements_symmetric_interpolate<2,double>(N,dp,dr,di);
-      return elements;
+      handle->elements = new dipole_elements_tabulated<2,double>(table_length, ds, &g_real[0], &g_imag[0]);
+      handle->elements_float = new dipole_elements_tabulated<2,float>(table_length, ds, &g_real[0], &g_imag[0]);
     }
     else if (dims==3) {
-      dipole_elements_symmetric_interpolate<3,double> *elements = new dipole_elements_symmetric_interpolate<3,double>(N,dp,dr,di);
-      return elements;
-    }
-    else {
-       return 0;
+      handle->elements = new dipole_elements_tabulated<3,double>(table_length, ds, &g_real[0], &g_imag[0]);
+      handle->elements_float = new dipole_elements_tabulated<3,float>(table_length, ds, &g_real[0], &g_imag[0]);
     }
+
+    return handle;
   }
-  void dipole_elements_symmetric_interpolate_double_destroy(int dims, void *ptr) {
-    if (dims==1) {
-      dipole_elements_symmetric_interpolate<1,double> *elements = (dipole_elements_symmetric_interpolate<1,double> *)ptr;
-      delete elements;
+
+  // destructor for all kinds of dipole elements
+  void dipole_elements_double_destroy(void *ptr) {
+    dipole_elements_handle *handle = (dipole_elements_handle *)ptr;
+    if (!handle) return;
+
+    // cast back to actual class before deleting, as dipole_elements has no
+    // virtual destructor
+    if (handle->kind==DIPOLE_ELEMENTS_H) {
+      if (handle->dims==1) {
+        delete (dipole_elements_H<1,double> *)handle->elements;
+        delete (dipole_elements_H<1,float> *)handle->elements_float;
+      }
+      else if (handle->dims==2) {
+        delete (dipole_elements_H<2,double> *)handle->elements;
+        delete (dipole_elements_H<2,float> *)handle->elements_float;
+      }
+      else if (handle->dims==3) {
+        delete (dipole_elements_H<3,double> *)handle->elements;
+        delete (dipole_elements_H<3,float> *)handle->elements_float;
+      }
     }
-    else if (dims==2) {
-      dipole_elements_symmetric_interpolate<2,double> *elements = (dipole_elements_symmetric_interpolate<2,double> *)ptr;
-      delete elements;
+    else if (handle->kind==DIPOLE_ELEMENTS_SYMMETRIC_INTERPOLATE) {
+      if (handle->dims==1) {
+        delete (dipole_elements_symmetric_interpolate<1,double> *)handle->elements;
+        delete (dipole_elements_symmetric_interpolate<1,float> *)handle->elements_float;
+      }
+      else if (handle->dims==2) {
+        delete (dipole_elements_symmetric_interpolate<2,double> *)handle->elements;
+        delete (dipole_elements_symmetric_interpolate<2,float> *)handle->elements_float;
+      }
+      else if (handle->dims==3) {
+        delete (dipole_elements_symmetric_interpolate<3,double> *)handle->elements;
+        delete (dipole_elements_symmetric_interpolate<3,float> *)handle->elements_float;
+      }
     }
-    else if (dims==3) {
-      dipole_elements_symmetric_interpolate<3,double> *elements = (dipole_elements_symmetric_interpolate<3,double> *)ptr;
-      delete elements;
+    else if (handle->kind==DIPOLE_ELEMENTS_TABULATED) {
+      if (handle->dims==1) {
+        delete (dipole_elements_tabulated<1,double> *)handle->elements;
+        delete (dipole_elements_tabulated<1,float> *)handle->elements_float;
+      }
+      else if (handle->dims==2) {
+        delete (dipole_elements_tabulated<2,double> *)handle->elements;
+        delete (dipole_elements_tabulated<2,float> *)handle->elements_float;
+      }
+      else if (handle->dims==3) {
+        delete (dipole_elements_tabulated<3,double> *)handle->elements;
+        delete (dipole_elements_tabulated<3,float> *)handle->elements_float;
+      }
     }
+
+    delete[] handle->data_float;
+    delete handle;
+  }
+
+  // kept for compatibility; dims argument is not needed anymore
+  void dipole_elements_H_double_destroy(int /*dims*/, void *ptr) {
+    dipole_elements_double_destroy(ptr);
+  }
+
+  void dipole_elements_symmetric_interpolate_double_destroy(int /*dims*/, void *ptr) {
+    dipole_elements_double_destroy(ptr);
   }
 
   // expose implementation of Lewenstein model
   void lewenstein_double(int dims, int N, double *t, double *Et, int weights_length, double *weights, double *at, double ip, double epsilon_t, void *dp, double *output) {
+    dispatch_lewenstein_batch_dims<double,double>(dims, 1, N, t, Et, weights_length, weights, at, N, ip, epsilon_t, dp, output);
+  }
+
+  // same in single precision
+  void lewenstein_float(int dims, int N, float *t, float *Et, int weights_length, float *weights, float *at, float ip, float epsilon_t, void *dp, float *output) {
+    dispatch_lewenstein_batch_dims<float,float>(dims, 1, N, t, Et, weights_length, weights, at, N, ip, epsilon_t, dp, output);
+  }
+
+  // same with double precision arguments, but single precision integrand;
+  // A(t), B(t), C(t) and the tau integral are computed in double precision
+  void lewenstein_mixed(int dims, int N, double *t, double *Et, int weights_length, double *weights, double *at, double ip, double epsilon_t, void *dp, double *output) {
+    dispatch_lewenstein_batch_dims<float,double>(dims, 1, N, t, Et, weights_length, weights, at, N, ip, epsilon_t, dp, output);
+  }
+
+  // expose batched implementation of Lewenstein model; at may be 0 (no ground
+  // state depletion) and at_stride may be 0 (same amplitude for all points)
+  void lewenstein_batch_double(int dims, int points, int N, double *t, double *Et, int weights_length, double *weights, double *at, int at_stride, double ip, double epsilon_t, void *dp, double *output) {
+    dispatch_lewenstein_batch_dims<double,double>(dims, points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, dp, output);
+  }
+
+  void lewenstein_batch_float(int dims, int points, int N, float *t, float *Et, int weights_length, float *weights, float *at, int at_stride, float ip, float epsilon_t, void *dp, float *output) {
+    dispatch_lewenstein_batch_dims<float,float>(dims, points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, dp, output);
+  }
+
+  void lewenstein_batch_mixed(int dims, int points, int N, double *t, double *Et, int weights_length, double *weights, double *at, int at_stride, double ip, double epsilon_t, void *dp, double *output) {
+    dispatch_lewenstein_batch_dims<float,double>(dims, points, N, t, Et, weights_length, weights, at, at_stride, ip, epsilon_t, dp, output);
+  }
+
+  // expose plans for repeated calculations with the same time axis, weights
+  // and dipole elements; dp must not be destroyed before the plan. The tau
+  // integral uses the given nodes_length tau indices only (all if
+  // nodes_length is 0; see lewenstein_graded_nodes), and Filon quadrature
+  // if filon is nonzero. If periodic is nonzero, Et passed to execute is one
+  // period of a periodic field on the equally spaced axis t, and weights may
+  // be longer than t (see lewenstein_plan).
+  void *lewenstein_plan_double_create_grid(int dims, int N, double *t, int weights_length, double *weights, double ip, double epsilon_t, void *dp, int nodes_length, int *nodes, int filon, int periodic) {
+    dipole_elements_handle *elements = (dipole_elements_handle *)dp;
+    if (elements->dims!=dims) return 0;
+
+    lewenstein_plan_handle *handle = new lewenstein_plan_handle;
+    handle->kind = elements->kind;
+    handle->dims = dims;
+
     if (dims==1) {
-      lewenstein<1,double>(N, t, Et, weights_length, weights, at, ip, epsilon_t, *(dipole_elements_H<1,double> *)dp, output);
+      handle->plan = dispatch_lewenstein_plan_create<1>(N, t, weights_length, weights, ip, epsilon_t, elements, nodes_length, nodes, filon!=0, periodic!=0);
     }
     else if (dims==2) {
-      lewenstein<2,double>(N, t, Et, weights_length, weights, at, ip, epsilon_t, *(dipole_elements_H<2,double> *)dp, output);
+      handle->plan = dispatch_lewenstein_plan_create<2>(N, t, weights_length, weights, ip, epsilon_t, elements, nodes_length, nodes, filon!=0, periodic!=0);
     }
     else if (dims==3) {
-      lewenstein<3,double>(N, t, Et, weights_length, weights, at, ip, epsilon_t, *(dipole_elements_H<3,double> *)dp, output);
+      handle->plan = dispatch_lewenstein_plan_create<3>(N, t, weights_length, weights, ip, epsilon_t, elements, nodes_length, nodes, filon!=0, periodic!=0);
     }
+    else {
+      handle->plan = 0;
+    }
+
+    if (!handle->plan) {
+      delete handle;
+      return 0;
+    }
+
+    return handle;
   }
 
-  // expose implementation of Lewenstein in saddle-point approximation
-  void yakovlev_double(int dims, int N, double *t, double *Et, int weight_length, double *weights, int min_tau_i, double *dtfraction, double *at, double ip, double *output) {
-    if (dims==1) {
-      yakovlev<1,double>(N, t, Et, weight_length, weights, min_tau_i, dtfraction, at, ip, output);
+  void *lewenstein_plan_double_create(int dims, int N, double *t, int weights_length, double *weights, double ip, double epsilon_t, void *dp) {
+    return lewenstein_plan_double_create_grid(dims, N, t, weights_length, weights, ip, epsilon_t, dp, 0, 0, 0, 0);
+  }
+
+  void lewenstein_plan_double_execute(void *plan, int points, double *Et, double *at, int at_stride, double *output) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+
+    if (handle->dims==1) dispatch_lewenstein_plan_execute<1>(handle, points, Et, at, at_stride, output);
+    else if (handle->dims==2) dispatch_lewenstein_plan_execute<2>(handle, points, Et, at, at_stride, output);
+    else if (handle->dims==3) dispatch_lewenstein_plan_execute<3>(handle, points, Et, at, at_stride, output);
+  }
+
+  // like lewenstein_plan_double_execute, but reads and writes the arrays in
+  // place with the given strides (in elements, for points, time steps and
+  // components; at_strides has no component stride), scaling the driving
+  // fields and the dipole responses by Et_scale and output_scale
+  void lewenstein_plan_double_execute_strided(void *plan, int points, double *Et, ptrdiff_t *Et_strides, double Et_scale, double *at, ptrdiff_t *at_strides, double *output, ptrdiff_t *output_strides, double output_scale) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    const lewenstein_layout Et_layout(Et_strides[0], Et_strides[1], Et_strides[2], Et_scale);
+    const lewenstein_layout at_layout = at ? lewenstein_layout(at_strides[0], at_strides[1], 0) : lewenstein_layout();
+    const lewenstein_layout output_layout(output_strides[0], output_strides[1], output_strides[2], output_scale);
+
+    if (handle->dims==1) dispatch_lewenstein_plan_execute_strided<1>(handle, points, Et, Et_layout, at, at_layout, output, output_layout);
+    else if (handle->dims==2) dispatch_lewenstein_plan_execute_strided<2>(handle, points, Et, Et_layout, at, at_layout, output, output_layout);
+    else if (handle->dims==3) dispatch_lewenstein_plan_execute_strided<3>(handle, points, Et, Et_layout, at, at_layout, output, output_layout);
+  }
+
+  // adds a species with the ionization potential ip, the dipole elements dp
+  // and the ionization rate rate (or 0), which must not be destroyed before
+  // the plan (see lewenstein_plan::add_species); dp must be of the same class
+  // and dimensions as the dipole elements of the plan. Returns the index of
+  // the species, or -1 if dp does not fit.
+  int lewenstein_plan_double_add_species(void *plan, double ip, void *dp, void *rate) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    dipole_elements_handle *elements = (dipole_elements_handle *)dp;
+    const ionization_rate_table *table = (const ionization_rate_table *)rate;
+    if (elements->kind!=handle->kind || elements->dims!=handle->dims) return -1;
+
+    if (handle->dims==1) return dispatch_lewenstein_plan_add_species<1>(handle, ip, elements, table);
+    else if (handle->dims==2) return dispatch_lewenstein_plan_add_species<2>(handle, ip, elements, table);
+    else if (handle->dims==3) return dispatch_lewenstein_plan_add_species<3>(handle, ip, elements, table);
+    return -1;
+  }
+
+  // like lewenstein_plan_double_execute_strided, but computes the first
+  // species_count species of the plan in one pass; at_strides and
+  // output_strides start with the stride between the species
+  void lewenstein_plan_double_execute_species(void *plan, int species_count, int points, double *Et, ptrdiff_t *Et_strides, double Et_scale, double *at, ptrdiff_t *at_strides, double *output, ptrdiff_t *output_strides, double output_scale) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    const lewenstein_layout Et_layout(Et_strides[0], Et_strides[1], Et_strides[2], Et_scale);
+    const lewenstein_layout at_layout = at ? lewenstein_layout(at_strides[1], at_strides[2], 0) : lewenstein_layout();
+    const ptrdiff_t at_species = at ? at_strides[0] : 0;
+    const lewenstein_layout output_layout(output_strides[1], output_strides[2], output_strides[3], output_scale);
+
+    if (handle->dims==1) dispatch_lewenstein_plan_execute_species<1>(handle, species_count, 1, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[0], 0);
+    else if (handle->dims==2) dispatch_lewenstein_plan_execute_species<2>(handle, species_count, 1, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[0], 0);
+    else if (handle->dims==3) dispatch_lewenstein_plan_execute_species<3>(handle, species_count, 1, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[0], 0);
+  }
+
+  // adds a window of weights_length weights on the tau axis of the plan (see
+  // lewenstein_plan::add_window), which must not be longer than the weights
+  // of the plan. Returns the index of the window, or -1 if it is too long.
+  int lewenstein_plan_double_add_window(void *plan, int weights_length, double *weights) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    if (handle->dims==1) return dispatch_lewenstein_plan_add_window<1>(handle, weights_length, weights);
+    else if (handle->dims==2) return dispatch_lewenstein_plan_add_window<2>(handle, weights_length, weights);
+    else if (handle->dims==3) return dispatch_lewenstein_plan_add_window<3>(handle, weights_length, weights);
+    return -1;
+  }
+
+  // like lewenstein_plan_double_execute_species, but computes the dipole
+  // responses of each species for the first window_count windows of the
+  // plan; output_strides start with the stride between the windows, followed
+  // by the ones of lewenstein_plan_double_execute_species
+  void lewenstein_plan_double_execute_windows(void *plan, int species_count, int window_count, int points, double *Et, ptrdiff_t *Et_strides, double Et_scale, double *at, ptrdiff_t *at_strides, double *output, ptrdiff_t *output_strides, double output_scale) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    const lewenstein_layout Et_layout(Et_strides[0], Et_strides[1], Et_strides[2], Et_scale);
+    const lewenstein_layout at_layout = at ? lewenstein_layout(at_strides[1], at_strides[2], 0) : lewenstein_layout();
+    const ptrdiff_t at_species = at ? at_strides[0] : 0;
+    const lewenstein_layout output_layout(output_strides[2], output_strides[3], output_strides[4], output_scale);
+
+    if (handle->dims==1) dispatch_lewenstein_plan_execute_species<1>(handle, species_count, window_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[1], output_strides[0]);
+    else if (handle->dims==2) dispatch_lewenstein_plan_execute_species<2>(handle, species_count, window_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[1], output_strides[0]);
+    else if (handle->dims==3) dispatch_lewenstein_plan_execute_species<3>(handle, species_count, window_count, points, Et, Et_layout, at, at_layout, at_species, output, output_layout, output_strides[1], output_strides[0]);
+  }
+
+  // lets the plan compute the ground state amplitude from the ionization rate
+  // (see below) if execute is called without at; rate must not be destroyed
+  // before the plan, and may be 0
+  void lewenstein_plan_double_set_ionization_rate(void *plan, void *rate) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    const ionization_rate_table *table = (const ionization_rate_table *)rate;
+
+    if (handle->dims==1) dispatch_lewenstein_plan_set_ionization_rate<1>(handle, table);
+    else if (handle->dims==2) dispatch_lewenstein_plan_set_ionization_rate<2>(handle, table);
+    else if (handle->dims==3) dispatch_lewenstein_plan_set_ionization_rate<3>(handle, table);
+  }
+
+  // lets the plan record timers and counters in stats (see below), which must
+  // not be destroyed before the plan; 0 switches the instrumentation off
+  void lewenstein_plan_double_set_stats(void *plan, void *stats) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    lewenstein_stats *s = (lewenstein_stats *)stats;
+
+    if (handle->dims==1) dispatch_lewenstein_plan_set_stats<1>(handle, s);
+    else if (handle->dims==2) dispatch_lewenstein_plan_set_stats<2>(handle, s);
+    else if (handle->dims==3) dispatch_lewenstein_plan_set_stats<3>(handle, s);
+  }
+
+  // selects the accuracy tier of the phase factor, see simd_accuracy: 0
+  // (exact), 1 (errors below 3e-12) or 2 (errors below 1e-7)
+  void lewenstein_plan_double_set_accuracy(void *plan, int accuracy) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    if (accuracy<SIMD_ACCURACY_EXACT || accuracy>SIMD_ACCURACY_FAST) return;
+
+    if (handle->dims==1) dispatch_lewenstein_plan_set_accuracy<1>(handle, (simd_accuracy)accuracy);
+    else if (handle->dims==2) dispatch_lewenstein_plan_set_accuracy<2>(handle, (simd_accuracy)accuracy);
+    else if (handle->dims==3) dispatch_lewenstein_plan_set_accuracy<3>(handle, (simd_accuracy)accuracy);
+  }
+
+  // returns the fastest accuracy tier whose errors are at most tolerance
+  int lewenstein_accuracy_for(double tolerance) {
+    return simd_accuracy_for(tolerance);
+  }
+
+  void lewenstein_plan_double_destroy(void *plan) {
+    lewenstein_plan_handle *handle = (lewenstein_plan_handle *)plan;
+    if (!handle) return;
+
+    if (handle->dims==1) dispatch_lewenstein_plan_destroy<1>(handle);
+    else if (handle->dims==2) dispatch_lewenstein_plan_destroy<2>(handle);
+    else if (handle->dims==3) dispatch_lewenstein_plan_destroy<3>(handle);
+
+    delete handle;
+  }
+
+  // expose instrumentation of plans, see lewenstein_stats
+  void *lewenstein_stats_create() {
+    return new lewenstein_stats();
+  }
+
+  void lewenstein_stats_reset(void *stats) {
+    ((lewenstein_stats *)stats)->reset();
+  }
+
+  void lewenstein_stats_set_progress(void *stats, lewenstein_progress_callback progress, void *user, double interval) {
+    lewenstein_stats *s = (lewenstein_stats *)stats;
+    s->progress = progress;
+    s->progress_user = user;
+    s->progress_interval = interval;
+  }
+
+  // writes calls, points, prepare_seconds, tau_seconds, total_seconds,
+  // evaluations, zero_weight_evaluations and skipped_evaluations to values
+  // and returns the number of threads
+  int lewenstein_stats_get(void *stats, double *values) {
+    lewenstein_stats *s = (lewenstein_stats *)stats;
+    values[0] = s->calls;
+    values[1] = s->points;
+    values[2] = s->prepare_seconds;
+    values[3] = s->tau_seconds;
+    values[4] = s->total_seconds;
+    values[5] = s->evaluations;
+    values[6] = s->zero_weight_evaluations;
+    values[7] = s->skipped_evaluations;
+    return (int)s->thread_seconds.size();
+  }
+
+  // writes the counters of each thread to the arrays
+  void lewenstein_stats_get_threads(void *stats, double *seconds, double *evaluations, double *tiles) {
+    lewenstein_stats *s = (lewenstein_stats *)stats;
+    for (size_t thread=0; thread<s->thread_seconds.size(); thread++) {
+      seconds[thread] = s->thread_seconds[thread];
+      evaluations[thread] = s->thread_evaluations[thread];
+      tiles[thread] = s->thread_tiles[thread];
     }
   }
+
+  void lewenstein_stats_destroy(void *stats) {
+    delete (lewenstein_stats *)stats;
+  }
+
+  // expose ionization rates: a table of n rates w at the field strengths E, or
+  // the Tong-Lin formula (ip in eV) tabulated up to E_max, where the units of
+  // the field strength and time are E_unit and t_unit atomic units
+  void *ionization_rate_table_double(int n, double *E, double *w) {
+    return new ionization_rate_table(n, E, w);
+  }
+
+  void *ionization_rate_tong_lin_double(double ip, double C, int l, int m, double Z, double alpha, double E_max, double E_unit, double t_unit) {
+    tong_lin_parameters p;
+    p.ip = ip;
+    p.C = C;
+    p.l = l;
+    p.m = m;
+    p.Z = Z;
+    p.alpha = alpha;
+    return new ionization_rate_table(p, E_max, E_unit, t_unit);
+  }
+
+  // returns 0 for unknown atoms
+  int tong_lin_atom_parameters(const char *atom, double *ip, double *C, int *l, double *Z, double *alpha) {
+    tong_lin_parameters p;
+    if (!tong_lin_atom(atom, p)) return 0;
+    *ip = p.ip;
+    *C = p.C;
+    *l = p.l;
+    *Z = p.Z;
+    *alpha = p.alpha;
+    return 1;
+  }
+
+  void ionization_rate_double_get(void *rate, int n, double *E, double *w) {
+    for (int i=0; i<n; i++) w[i] = ((ionization_rate_table *)rate)->get(E[i]);
+  }
+
+  // ground state amplitudes at (points x N) of the driving fields Et
+  // (points x N x dims)
+  void ionization_ground_state_amplitude_double(void *rate, int dims, int points, int N, double *t, double *Et, double *at) {
+    for (int point=0; point<points; point++) {
+      ((ionization_rate_table *)rate)->ground_state_amplitude(N, dims, t, Et + point*N*dims, at + point*N);
+    }
+  }
+
+  void ionization_rate_double_destroy(void *rate) {
+    delete (ionization_rate_table *)rate;
+  }
+
+  // expose implementation of Lewenstein in saddle-point approximation, with
+  // the accuracy tier of the propagation factor (as for
+  // lewenstein_plan_double_set_accuracy)
+  void yakovlev_double_accuracy(int dims, int N, double *t, double *Et, int weight_length, double *weights, int min_tau_i, double *dtfraction, double *at, double ip, double *output, int accuracy) {
+    simd_accuracy tier = accuracy==SIMD_ACCURACY_HIGH || accuracy==SIMD_ACCURACY_FAST ? (simd_accuracy)accuracy : SIMD_ACCURACY_EXACT;
+
+    if (dims==1) yakovlev<1,double>(N, t, Et, weight_length, weights, min_tau_i, dtfraction, at, ip, output, tier);
+    else if (dims==2) yakovlev<2,double>(N, t, Et, weight_length, weights, min_tau_i, dtfraction, at, ip, output, tier);
+    else if (dims==3) yakovlev<3,double>(N, t, Et, weight_length, weights, min_tau_i, dtfraction, at, ip, output, tier);
+  }
+
+  void yakovlev_double(int dims, int N, double *t, double *Et, int weight_length, double *weights, int min_tau_i, double *dtfraction, double *at, double ip, double *output) {
+    yakovlev_double_accuracy(dims, N, t, Et, weight_length, weights, min_tau_i, dtfraction, at, ip, output, SIMD_ACCURACY_EXACT);
+  }
+
+  // thread settings of all following calls (see threads.hpp): number of
+  // threads (0 for the OpenMP default) and the CPUs the threads are bound to
+  // (n=0 for none); lewenstein_threads_set_affinity returns 0 if binding is not
+  // supported on this platform
+  void lewenstein_threads_set(int threads) {
+    lewenstein_set_threads(threads);
+  }
+
+  int lewenstein_threads_get() {
+    return lewenstein_get_threads();
+  }
+
+  int lewenstein_threads_set_affinity(int n, int *cpus) {
+    return lewenstein_set_affinity(n, cpus) ? 1 : 0;
+  }
 }
@@ -1,6 +1,18 @@
 using namespace std;
 
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
 #include "vec.hpp"
+#include "simd.hpp"
+#include "ionization.hpp"
+#include "threads.hpp"
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+#include <time.h>
 
 // lewenstein() needs dipole elements. One solution would be to pass a function
 // pointer, but as the calculation needs additional data, this would require
@@ -28,12 +40,17 @@ class dipole_elements_H : public dipole_elements<dim,Type> {
       const complex<Type> i(Type(0), Type(1));
 
       alpha = alph;
-      prefactor = pow(2,3.5) * pow(alph,1.25) / pi * i;
+      prefactor = Type(pow(2,3.5) * pow(alph,1.25) / pi) * i;
     };
 
     vec<dim,complex<Type> > get(const vec<dim,Type> &p) const {
-      vec<dim,complex<Type> > r(p);
-      r *= prefactor / pow(SQR(p) + alpha, 3);
+      // prefactor is multiplied by hand instead of using complex
+      // multiplication, which allows the compiler to vectorize calls to get()
+      vec<dim,complex<Type> > r;
+      Type factor = Type(1) / pow(SQR(p) + alpha, 3);
+      for (int k=0; k<dim; k++) {
+        r.x[k] = complex<Type>(real(prefactor)*p.x[k]*factor, imag(prefactor)*p.x[k]*factor);
+      }
       return r;
     };
 };
@@ -83,24 +100,226 @@ class dipole_elements_symmetric_interpolate : public dipole_elements<dim,Type> {
     };
 };
 
-// calculates dipole response
+// number of momenta that dipole_elements_tabulated::get_many() evaluates at
+// once
+#define DIPOLE_ELEMENTS_CHUNK 64
+
+// dipole elements d(p) = p * g(|p|^2) that are tabulated over |p|^2, for
+// arbitrary antisymmetric dipole elements (symmetric ground state), e.g. from
+// ab-initio calculations. Indexing by |p|^2 avoids the square root, and g is
+// smooth in |p|^2 also at p=0. g and its derivative are stored interleaved,
+// so that the cubic Hermite interpolation needs one contiguous load per
+// neighbouring sample; beyond the table, d is 0.
 template <int dim, typename Type>
-int lewenstein(const int N, Type *t, Type *Et_data, int weight_length, Type *weights, Type *at, Type Ip, Type epsilon_t, const dipole_elements<dim,Type> &dp, Type *output_data) {
-  typedef complex<Type> cType;
+class dipole_elements_tabulated : public dipole_elements<dim,Type> {
+  private:
+    int length;
+    Type inv_ds;
+    Type *table; // g_re, g_im, ds*g_re', ds*g_im' for each sample
+
+    // not copyable
+    dipole_elements_tabulated(const dipole_elements_tabulated &);
+    dipole_elements_tabulated &operator=(const dipole_elements_tabulated &);
+
+  public:
+    // g_real and g_imag are the N samples of g at |p|^2 = 0, ds, 2*ds, ...;
+    // the derivatives are estimated by finite differences
+    dipole_elements_tabulated(int N, double ds, const double *g_real, const double *g_imag) {
+      length = N;
+      inv_ds = Type(1/ds);
+      table = (Type *)simd_malloc(4*(length+1)*sizeof(Type));
+      memset(table, 0, 4*(length+1)*sizeof(Type));
+
+      for (int i=0; i<length; i++) {
+        int before = i>0 ? i-1 : i, after = i+1<length ? i+1 : i;
+        double width = after>before ? after-before : 1;
+        table[4*i] = Type(g_real[i]);
+        table[4*i+1] = Type(g_imag[i]);
+        table[4*i+2] = Type((g_real[after]-g_real[before]) / width);
+        table[4*i+3] = Type((g_imag[after]-g_imag[before]) / width);
+      }
+    };
+
+    ~dipole_elements_tabulated() {
+      simd_free(table);
+    };
+
+    // evaluates d(p) for the n momenta p[k][j] (k: component, j: index) and
+    // writes it to d_real[k][j] and d_imag[k][j]; the momenta are processed
+    // in chunks by loops that are free of branches and only access arrays
+    // with index j, so that the compiler can vectorize them
+    SIMD_INLINE void get_many(int n, const Type *const *p, Type *const *d_real, Type *const *d_imag) const {
+      for (int start=0; start<n; start+=DIPOLE_ELEMENTS_CHUNK) {
+        const int m = min(DIPOLE_ELEMENTS_CHUNK, n-start);
+        Type p2[DIPOLE_ELEMENTS_CHUNK], g_re[DIPOLE_ELEMENTS_CHUNK], g_im[DIPOLE_ELEMENTS_CHUNK];
+
+        for (int j=0; j<m; j++) p2[j] = 0;
+        for (int k=0; k<dim; k++) {
+          const Type *p_k = p[k] + start;
+          for (int j=0; j<m; j++) p2[j] += p_k[j]*p_k[j];
+        }
+
+        for (int j=0; j<m; j++) {
+          Type x = p2[j]*inv_ds;
+          int i = (int)x;
+          int inside = (i>=0) & (i<length-1); // conversion overflow gives i<0 on x86
+          i *= inside;
+          x *= Type(inside);
+          Type u = x - Type(i);
+
+          // cubic Hermite basis functions
+          Type v = Type(1) - u;
+          Type h00 = (Type(1)+Type(2)*u)*v*v, h10 = u*v*v;
+          Type h01 = u*u*(Type(3)-Type(2)*u), h11 = -u*u*v;
+
+          g_re[j] = (h00*table[4*i] + h10*table[4*i+2] + h01*table[4*i+4] + h11*table[4*i+6]) * Type(inside);
+          g_im[j] = (h00*table[4*i+1] + h10*table[4*i+3] + h01*table[4*i+5] + h11*table[4*i+7]) * Type(inside);
+        }
+
+        for (int k=0; k<dim; k++) {
+          const Type *p_k = p[k] + start;
+          Type *d_re = d_real[k] + start, *d_im = d_imag[k] + start;
+          for (int j=0; j<m; j++) {
+            d_re[j] = p_k[j]*g_re[j];
+            d_im[j] = p_k[j]*g_im[j];
+          }
+        }
+      }
+    };
+
+    vec<dim,complex<Type> > get(const vec<dim,Type> &p) const {
+      Type p_k[dim], d_re[dim], d_im[dim];
+      const Type *p_ptr[dim];
+      Type *d_re_ptr[dim], *d_im_ptr[dim];
+      for (int k=0; k<dim; k++) {
+        p_k[k] = p.x[k];
+        p_ptr[k] = &p_k[k];
+        d_re_ptr[k] = &d_re[k];
+        d_im_ptr[k] = &d_im[k];
+      }
+      get_many(1, p_ptr, d_re_ptr, d_im_ptr);
+
+      vec<dim,complex<Type> > r;
+      for (int k=0; k<dim; k++) r.x[k] = complex<Type>(d_re[k], d_im[k]);
+      return r;
+    };
+};
+
+// samples g(|p|^2) = D(|p|)/|p| for dipole_elements_tabulated from the radial
+// dipole element D(|p|) given at |p| = 0, dp, 2*dp, ... (as for
+// dipole_elements_symmetric_interpolate), with N_table samples up to the end
+// of the data. D is interpolated cubically (Catmull-Rom), using D(-p)=-D(p).
+// Returns the spacing ds of the samples of |p|^2.
+inline double dipole_elements_tabulate_radial(int N, double dp, const double *D_real, const double *D_imag, int N_table, double *g_real, double *g_imag) {
+  const double p_max = (N-1)*dp;
+  const double ds = p_max*p_max / (N_table-1);
+
+  for (int i=0; i<N_table; i++) {
+    double p = sqrt(i*ds), x = p/dp;
+    int j = (int)x;
+    if (j>N-2) j = N-2;
+    double u = x-j;
+
+    // samples j-1, j, j+1 and j+2, extended antisymmetrically below 0 and
+    // linearly beyond the end
+    double D[4][2];
+    for (int m=0; m<4; m++) {
+      int index = j-1+m;
+      const double *part[2] = {D_real, D_imag};
+      for (int c=0; c<2; c++) {
+        if (index<0) D[m][c] = -part[c][-index];
+        else if (index>N-1) D[m][c] = 2*part[c][N-1] - part[c][N-2];
+        else D[m][c] = part[c][index];
+      }
+    }
+
+    double value[2];
+    for (int c=0; c<2; c++) {
+      if (i==0) {
+        // limit of D(p)/p, i.e. the slope D'(0) of the interpolation
+        value[c] = (D[2][c]-D[0][c]) / (2*dp);
+      }
+      else {
+        value[c] = ((((-D[0][c] + 3*D[1][c] - 3*D[2][c] + D[3][c])*u + (2*D[0][c] - 5*D[1][c] + 4*D[2][c] - D[3][c]))*u + (D[2][c]-D[0][c]))*u + 2*D[1][c]) / 2 / p;
+      }
+    }
+    g_real[i] = value[0];
+    g_imag[i] = value[1];
+  }
+
+  return ds;
+}
+
+// lewenstein() is templated on the class of the dipole elements, so that its
+// get() method can be inlined into the time-critical loop. Your own dipole
+// elements can use the same mechanism: derive from dipole_elements (or just
+// provide a get() method with the same signature) and pass an instance of your
+// class. Only if lewenstein() is called with a reference to the interface
+// dipole_elements itself, get() is called virtually.
+// The time-critical loop evaluates the dipole elements of a whole block of
+// momenta with get_many(), which calls get() for each of them unless the
+// class provides its own get_many() (see dipole_elements_tabulated).
+template <int dim, typename Type, class Elements>
+struct dipole_elements_call {
+  static inline vec<dim,complex<Type> > get(const Elements &dp, const vec<dim,Type> &p) {
+    return dp.Elements::get(p);
+  }
+
+  static SIMD_INLINE void get_many(const Elements &dp, int n, const Type *const *p, Type *const *d_real, Type *const *d_imag) {
+    for (int j=0; j<n; j++) {
+      vec<dim,Type> p_j;
+      for (int k=0; k<dim; k++) p_j.x[k] = p[k][j];
+
+      vec<dim,complex<Type> > d = get(dp, p_j);
+      for (int k=0; k<dim; k++) {
+        d_real[k][j] = real(d.x[k]);
+        d_imag[k][j] = imag(d.x[k]);
+      }
+    }
+  }
+};
+
+template <int dim, typename Type>
+struct dipole_elements_call<dim,Type,dipole_elements<dim,Type> > {
+  static inline vec<dim,complex<Type> > get(const dipole_elements<dim,Type> &dp, const vec<dim,Type> &p) {
+    return dp.get(p);
+  }
+
+  static inline void get_many(const dipole_elements<dim,Type> &dp, int n, const Type *const *p, Type *const *d_real, Type *const *d_imag) {
+    for (int j=0; j<n; j++) {
+      vec<dim,Type> p_j;
+      for (int k=0; k<dim; k++) p_j.x[k] = p[k][j];
+
+      vec<dim,complex<Type> > d = dp.get(p_j);
+      for (int k=0; k<dim; k++) {
+        d_real[k][j] = real(d.x[k]);
+        d_imag[k][j] = imag(d.x[k]);
+      }
+    }
+  }
+};
+
+template <int dim, typename Type>
+struct dipole_elements_call<dim,Type,dipole_elements_tabulated<dim,Type> > {
+  static inline vec<dim,complex<Type> > get(const dipole_elements_tabulated<dim,Type> &dp, const vec<dim,Type> &p) {
+    return dp.get(p);
+  }
+
+  static SIMD_INLINE void get_many(const dipole_elements_tabulated<dim,Type> &dp, int n, const Type *const *p, Type *const *d_real, Type *const *d_imag) {
+    dp.get_many(n, p, d_real, d_imag);
+  }
+};
+
+// computes A(t), B(t) = \int A dt and C(t) = \int A^2 dt from the driving
+// field, which is all that is needed to evaluate the action
+template <int dim, typename Type>
+void lewenstein_prepare(const int N, Type *t, Type *Et_data, Type *At_data, Type *Bt_data, Type *Ct) {
   typedef vec<dim,Type> rvec;
-  typedef vec<dim,cType> cvec;
   typedef vec_array<dim,Type> rvec_array;
 
-  int t_i, tau_i;
-  Type pi = 4.0*atan(1.0);
-  cType i = cType(Type(0), Type(1));
-
-  // initialize Et, At, Bt, Ct, output
   rvec_array Et(Et_data);
-  Type *At_data = new Type[dim*N]; rvec_array At(At_data);
-  Type *Bt_data = new Type[dim*N]; rvec_array Bt(Bt_data);
-  Type *Ct = new Type[N];
-  rvec_array output(output_data);
+  rvec_array At(At_data);
+  rvec_array Bt(Bt_data);
 
   rvec IAt(0);
   rvec IBt(0);
@@ -110,7 +329,7 @@ int lewenstein(const int N, Type *t, Type *Et_data, int weight_length, Type *wei
   Bt[0] = IBt;
   Ct[0] = ICt;
 
-  for (t_i=1; t_i<N; t_i++) {
+  for (int t_i=1; t_i<N; t_i++) {
     Type dt = t[t_i]-t[t_i-1];
 
     IAt -= (Et[t_i-1]+Et[t_i]) * (dt/2);
@@ -122,73 +341,1568 @@ int lewenstein(const int N, Type *t, Type *Et_data, int weight_length, Type *wei
     ICt += (SQR(At[t_i-1]) + SQR(At[t_i])) * dt/2;
     Ct[t_i] = ICt;
   }
+}
 
-  cvec integral, last_integrand, dstar, dnorm, integrand13;
-  cType c;
-  rvec pst, argdstar, argdnorm;
-  Type Sst, dt;
-  int inde;
+// same as lewenstein_prepare, but also copies Et and stores all quantities in
+// structure of arrays layout, i.e. component k of At is At_soa[k*stride+t_i];
+// the integrals are computed in the precision of the input (In) even if the
+// results are stored with lower precision (Type).
+// If period>0, Et_data holds one period of period samples, which is continued
+// periodically, and t_i=0 corresponds to sample first of it (which may be
+// negative). The integrals are not periodic: they start at zero at t_i=0, so
+// that B and C drift from period to period exactly as in the repeated field.
+template <int dim, typename In, typename Type>
+void lewenstein_prepare_soa(const int N, const int stride, In *t, In *Et_data, Type *Et_soa, Type *At_soa, Type *Bt_soa, Type *Ct, const int first=0, const int period=0) {
+  In IAt[dim], IBt[dim];
+  In ICt = In(0);
 
-  #pragma omp parallel for private(inde, integral, last_integrand, pst, tau_i, argdstar, argdnorm, dstar, dnorm, Sst, c, integrand13, dt) shared(t, Et, At, Bt, Ct, i, pi, weights, weight_length, at, Ip, dp)
-  for (t_i=1; t_i<N; t_i++) {
-    inde = weight_length;
-    if (t_i<inde) inde = t_i+1;
+  int sample = period ? (first%period + period) % period : 0;
+
+  for (int k=0; k<dim; k++) {
+    Et_soa[k*stride] = Type(Et_data[dim*sample+k]);
+    IAt[k] = 0; At_soa[k*stride] = 0;
+    IBt[k] = 0; Bt_soa[k*stride] = 0;
+  }
+  Ct[0] = Type(ICt);
+
+  for (int t_i=1; t_i<N; t_i++) {
+    In dt = t[t_i]-t[t_i-1];
+    In A_before = 0, A_now = 0;
+
+    const int previous = sample;
+    sample = period ? (sample+1==period ? 0 : sample+1) : t_i;
+
+    for (int k=0; k<dim; k++) {
+      Et_soa[k*stride+t_i] = Type(Et_data[dim*sample+k]);
+
+      In A_previous = IAt[k];
+      IAt[k] -= (Et_data[dim*previous+k]+Et_data[dim*sample+k]) * (dt/2);
+      At_soa[k*stride+t_i] = Type(IAt[k]);
+
+      IBt[k] += (A_previous+IAt[k]) * (dt/2);
+      Bt_soa[k*stride+t_i] = Type(IBt[k]);
+
+      A_before += SQR(A_previous);
+      A_now += SQR(IAt[k]);
+    }
+
+    ICt += (A_before + A_now) * dt/2;
+    Ct[t_i] = Type(ICt);
+  }
+}
+
+// number of tau values processed at once by the vectorized part of
+// lewenstein_batch; must be a multiple of LEWENSTEIN_ACCUMULATORS
+#define LEWENSTEIN_LANES 64
+
+// number of independent partial sums of the tau integral, so that the sum can
+// be vectorized without reordering floating point operations
+#define LEWENSTEIN_ACCUMULATORS 8
+
+// the number of lanes is padded to a multiple of LEWENSTEIN_ACCUMULATORS;
+// padding lanes are masked out, but to keep the memory accesses of the
+// vectorized loops simple they still read from the arrays, which therefore
+// are padded: tau tables with zeros at the end, time-dependent arrays with
+// zeros at the start (as they are accessed at t_i-tau_i)
+#define LEWENSTEIN_PADDING LEWENSTEIN_ACCUMULATORS
+
+// size of the tiles of the (t_i, tau_i) plane processed at once by
+// lewenstein_plan::execute; LEWENSTEIN_TILE_TAU must be a multiple of
+// LEWENSTEIN_LANES
+#define LEWENSTEIN_TILE_T 32
+#define LEWENSTEIN_TILE_TAU 256
+
+// quantities of one point, in structure of arrays layout; all arrays are
+// preceded by LEWENSTEIN_PADDING zeros. For tau grids with coarse runs (see
+// lewenstein_tau_table), coarse points to copies of the arrays in which every
+// coarse_step-th sample follows the previous one, or is 0.
+template <int dim, typename Type>
+struct lewenstein_point {
+  Type *E[dim];
+  Type *A[dim];
+  Type *B[dim];
+  Type *C;
+  Type *at;
+  const lewenstein_point *coarse;
+};
+
+// quantities depending only on tau, shared by all points and t_i; the arrays
+// are indexed by the nodes of the tau grid (see lewenstein_plan) and followed
+// by LEWENSTEIN_PADDING zeros
+template <typename Type>
+struct lewenstein_tau_table {
+  int *tau;      // tau_i of the node
+  Type *inv_t;   // 1/tau
+  Type *Ip_t;    // Ip*tau
+  Type *pref_re; // weight * (pi/(epsilon+i*tau/2))^1.5 * trapezoidal rule dt
+  Type *pref_im; // (without dt for Filon quadrature)
+  Type *h;       // distance to the next node
+  Type *shifted_re; // pref * exp(-i*Ip*tau), for lewenstein_tau_sum_species
+  Type *shifted_im;
+  Type *unweighted_re; // shifted without the weight, for several windows
+  Type *unweighted_im; // (see lewenstein_plan::add_window)
+  bool filon;    // Filon quadrature instead of the trapezoidal rule
+  simd_accuracy accuracy; // tier of the sine and cosine of the action
+  // the nodes are divided into runs of equally spaced tau_i, so that the
+  // lanes of a block read t_i-tau_i with a constant stride: with stride -1
+  // from the arrays of the point for runs of consecutive tau_i, and from its
+  // coarse copies (see lewenstein_point) for runs with spacing coarse_step,
+  // in which row r holds the samples r, r+coarse_step, ... (counted from the
+  // start of the array, coarse_origin samples before t_0) after
+  // LEWENSTEIN_PADDING zeros; the lanes of other runs gather their values
+  int *run_last; // last node of the run of the node (shared with the next run)
+  int *run_step; // spacing of the tau_i of that run
+  int coarse_step;
+  int coarse_row;
+  int coarse_origin;
+};
+
+// scratch space for one block of tau values, in structure of arrays layout
+template <int dim, typename Type>
+struct lewenstein_lanes {
+  Type ps[dim][LEWENSTEIN_LANES];    // p_st - A(t), argument of d*
+  Type pn[dim][LEWENSTEIN_LANES];    // p_st - A(t-tau), argument of d
+  Type S[LEWENSTEIN_LANES];          // quasi-classical action
+  Type sin_S[LEWENSTEIN_LANES];      // sine and cosine of S without Ip*tau,
+  Type cos_S[LEWENSTEIN_LANES];      // shared by the species of a plan
+  Type Y_re[LEWENSTEIN_LANES];       // d(...).E(t-tau) * exp(-iS) without
+  Type Y_im[LEWENSTEIN_LANES];       // Ip*tau, for species with the same d
+  Type E[dim][LEWENSTEIN_LANES];     // E(t-tau)
+  Type at[LEWENSTEIN_LANES];         // a(t-tau), 0 for padding lanes
+  Type ds_re[dim][LEWENSTEIN_LANES]; // d(p_st - A(t)), conjugated in the sum
+  Type ds_im[dim][LEWENSTEIN_LANES];
+  Type dn_re[dim][LEWENSTEIN_LANES]; // d(p_st - A(t-tau))
+  Type dn_im[dim][LEWENSTEIN_LANES];
+  Type X_re[LEWENSTEIN_LANES];       // d(...).E(t-tau) * exp(-iS) * prefactor
+  Type X_im[LEWENSTEIN_LANES];
+  Type Z[dim][LEWENSTEIN_LANES];     // imag(d*(p_st - A(t)) * X)
+  int offset[LEWENSTEIN_LANES];      // -tau_i of the lanes, if gathered
+  Type phase[LEWENSTEIN_LANES+2];    // S of the lanes and their neighbours
+  Type phi_re[LEWENSTEIN_LANES+1];   // Filon weights of the intervals
+  Type phi_im[LEWENSTEIN_LANES+1];
+};
+
+// a species of lewenstein_plan (see add_species): its ionization potential,
+// dipole elements, ionization rates (or 0) and the tau table with its Ip*tau
+// and prefactors; the other arrays of the table are shared by all species
+template <typename Type, class Elements>
+struct lewenstein_species {
+  Type Ip;
+  const Elements *dp;
+  const ionization_rate_table *ionization;
+  lewenstein_tau_table<Type> table;
+  Type *table_data; // Ip_t, pref_re, pref_im, shifted_re, shifted_im,
+                    // unweighted_re, unweighted_im
+};
+
+// quasi-classical action S for the tau_i of a node of the tau grid
+template <int dim, typename Type>
+inline Type lewenstein_action(const int t_i, const int node, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table) {
+  const int ts_i = t_i - table.tau[node];
+  Type S = table.Ip_t[node] + Type(0.5)*(pt.C[t_i]-pt.C[ts_i]);
+  for (int k=0; k<dim; k++) {
+    Type dB = pt.B[k][t_i] - pt.B[k][ts_i];
+    S -= Type(0.5)*table.inv_t[node]*dB*dB;
+  }
+  return S;
+}
+
+// Filon quadrature: between neighbouring nodes, S is interpolated linearly and
+// the remaining integrand f linearly, so that the integral over an interval of
+// length h from S_a to S_b = S_a+theta is
+//   h*(f_a*exp(-iS_a)*phi(theta) + f_b*exp(-iS_b)*conj(phi(theta)))
+// with phi(theta) = ((1-cos(theta)) - i*(theta-sin(theta))) / theta^2, which
+// is 1/2 (the trapezoidal rule) for theta=0. For small theta, the series is
+// used to avoid cancellation.
+template <int accuracy, typename Type>
+SIMD_INLINE void lewenstein_filon_phi(Type theta, Type &re, Type &im) {
+  Type s, c;
+  simd_sincos_accuracy<accuracy>(Type(0.5)*theta, s, c);
+
+  // select without branches, like simd_sincos
+  Type t2 = theta*theta;
+  Type small = Type(t2<Type(0.01));
+  Type inv_t2 = Type(1)/(t2+small);
+
+  Type re_series = Type(0.5) - t2*(Type(1.0/24) - t2*(Type(1.0/720) - t2*(Type(1.0/40320) - t2*Type(1.0/3628800))));
+  Type im_series = theta*(Type(1.0/6) - t2*(Type(1.0/120) - t2*(Type(1.0/5040) - t2*Type(1.0/362880))));
+  Type re_exact = Type(2)*s*s*inv_t2;
+  Type im_exact = (theta - Type(2)*s*c)*inv_t2;
+
+  re = re_exact + small*(re_series-re_exact);
+  im = -(im_exact + small*(im_series-im_exact));
+}
+
+// integrand of the tau integral for one (t_i, tau_i) pair, without the
+// trapezoidal rule dt; used for the first and last tau_i only
+template <int dim, typename Type, class Elements>
+vec<dim,complex<Type> > lewenstein_integrand(const int t_i, const int tau_i, Type *t, const lewenstein_point<dim,Type> &pt, Type *weights, Type Ip, Type epsilon_t, const Elements &dp) {
+  typedef complex<Type> cType;
+  typedef vec<dim,Type> rvec;
+  typedef vec<dim,cType> cvec;
+
+  Type pi = 4.0*atan(1.0);
+  cType i = cType(Type(0), Type(1));
+
+  rvec At, Ats, dB, Ets;
+  for (int k=0; k<dim; k++) {
+    At.x[k] = pt.A[k][t_i];
+    Ats.x[k] = pt.A[k][t_i-tau_i];
+    dB.x[k] = pt.B[k][t_i] - pt.B[k][t_i-tau_i];
+    Ets.x[k] = pt.E[k][t_i-tau_i];
+  }
 
-    integral = 0.;
-    last_integrand = 0;
+  rvec pst = dB / t[tau_i];
+  if (tau_i==0) pst = At;
 
-    for (tau_i=0; tau_i<inde; tau_i++) {
-      pst = (Bt[t_i]-Bt[t_i-tau_i]) / t[tau_i];
-      if (tau_i==0) pst = At[t_i];
+  cvec dnorm = dipole_elements_call<dim,Type,Elements>::get(dp, pst - Ats);
+  cvec dstar = conj( dipole_elements_call<dim,Type,Elements>::get(dp, pst - At) );
 
-      argdstar = pst - At[t_i];
-      argdnorm = pst - At[t_i-tau_i];
+  Type Sst = Ip * t[tau_i] - .5/t[tau_i]*SQR(dB) + .5*(pt.C[t_i]-pt.C[t_i-tau_i]);
+  if (tau_i==0) Sst = 0;
 
-      // calculate dipole elements with passed function
-      dnorm = dp.get(argdnorm);
-      dstar = conj( dp.get(argdstar) );
+  cType c = pi/(epsilon_t+(Type)0.5*i*t[tau_i]);
 
-      Sst = Ip * t[tau_i] - .5/t[tau_i]*SQR(Bt[t_i]-Bt[t_i-tau_i]) + .5*(Ct[t_i]-Ct[t_i-tau_i]);
-      if (tau_i==0) Sst = 0;
+  cvec integrand13 = dstar;
+  integrand13 *= (dnorm * Ets) * c*sqrt(c) * cType( cos(Sst), -sin(Sst) ) * weights[tau_i] * pt.at[t_i] * pt.at[t_i-tau_i];
+    // for the a(t) & a(t-tau) terms, compare Cao et al. (2006) in Phys. Rev. A
 
-      c = pi/(epsilon_t+(Type)0.5*i*t[tau_i]);
+  return integrand13;
+}
 
-      // note: c*sqrt(c) is a lot faster than pow(c, 1.5) - yields 50% speed improvement
-      integrand13 = dstar;
-      integrand13 *= (dnorm * Et[t_i-tau_i]) * c*sqrt(c) * cType( cos(Sst), -sin(Sst) ) * weights[tau_i] * at[t_i] * at[t_i-tau_i]; // takes most of the time!
-        // for the a(t) & a(t-tau) terms, compare Cao et al. (2006) in Phys. Rev. A
+// X = d(p_st - A(t-tau)).E(t-tau) * exp(-iS) * prefactor * a(t-tau) for the
+// lanes of a block, with the sine and cosine of the given accuracy tier
+template <int dim, typename Type, int accuracy>
+SIMD_INLINE void lewenstein_phase_lanes(const int n_padded, const Type *pref_re, const Type *pref_im, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<n_padded; j++) {
+    Type sin_S, cos_S;
+    simd_sincos_accuracy<accuracy>(l.S[j], sin_S, cos_S);
 
-      dt=0; if (tau_i>0) dt = t[tau_i]-t[tau_i-1];
-      integral += (last_integrand + integrand13) * cType(dt/2.);
+    Type dE_re = 0, dE_im = 0;
+    for (int k=0; k<dim; k++) {
+      dE_re += l.dn_re[k][j] * l.E[k][j];
+      dE_im += l.dn_im[k][j] * l.E[k][j];
+    }
+
+    Type h_re = (pref_re[j]*cos_S + pref_im[j]*sin_S) * l.at[j];
+    Type h_im = (pref_im[j]*cos_S - pref_re[j]*sin_S) * l.at[j];
+
+    l.X_re[j] = dE_re*h_re - dE_im*h_im;
+    l.X_im[j] = dE_re*h_im + dE_im*h_re;
+  }
+}
+
+// Filon weights of the intervals between l.phase, see lewenstein_filon_phi
+template <int dim, typename Type, int accuracy>
+SIMD_INLINE void lewenstein_filon_lanes(const int n_padded, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<=n_padded; j++) {
+    lewenstein_filon_phi<accuracy,Type>(l.phase[j+1]-l.phase[j], l.phi_re[j], l.phi_im[j]);
+  }
+}
+
+// Filon quadrature weights: node j gets h_{j-1}*conj(phi) of the interval
+// before and h_j*phi of the interval after it (see lewenstein_filon_phi);
+// multiplies X of the lanes by them. S of the node block-1, of the lanes and
+// of the node block+n must be in l.phase[0..n+1].
+template <int dim, typename Type>
+SIMD_INLINE void lewenstein_filon_weights(const int block, const int n, const int n_padded, const lewenstein_tau_table<Type> &table, lewenstein_lanes<dim,Type> &l) {
+  for (int j=n+1; j<=n_padded; j++) l.phase[j+1] = l.phase[n+1];
+
+  if (table.accuracy==SIMD_ACCURACY_FAST) lewenstein_filon_lanes<dim,Type,SIMD_ACCURACY_FAST>(n_padded, l);
+  else if (table.accuracy==SIMD_ACCURACY_HIGH) lewenstein_filon_lanes<dim,Type,SIMD_ACCURACY_HIGH>(n_padded, l);
+  else lewenstein_filon_lanes<dim,Type,SIMD_ACCURACY_EXACT>(n_padded, l);
+
+  const Type *h = table.h + block;
+  for (int j=0; j<n_padded; j++) {
+    Type w_re = h[j-1]*l.phi_re[j] + h[j]*l.phi_re[j+1];
+    Type w_im = h[j]*l.phi_im[j+1] - h[j-1]*l.phi_im[j];
+    Type X_re = l.X_re[j]*w_re - l.X_im[j]*w_im;
+    l.X_im[j] = l.X_re[j]*w_im + l.X_im[j]*w_re;
+    l.X_re[j] = X_re;
+  }
+}
+
+// sine and cosine of S of the lanes, for lewenstein_tau_sum_species
+template <int dim, typename Type, int accuracy>
+SIMD_INLINE void lewenstein_sincos_lanes(const int n_padded, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<n_padded; j++) {
+    simd_sincos_accuracy<accuracy>(l.S[j], l.sin_S[j], l.cos_S[j]);
+  }
+}
 
-      last_integrand = integrand13;
+// Y = d(p_st - A(t-tau)).E(t-tau) * exp(-iS) with the sine and cosine of
+// the lanes, for lewenstein_tau_sum_species
+template <int dim, typename Type>
+SIMD_INLINE void lewenstein_unshifted_lanes(const int n_padded, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<n_padded; j++) {
+    Type dE_re = 0, dE_im = 0;
+    for (int k=0; k<dim; k++) {
+      dE_re += l.dn_re[k][j] * l.E[k][j];
+      dE_im += l.dn_im[k][j] * l.E[k][j];
     }
 
-    output[t_i] = (Type)2.0 * imag(integral);
+    l.Y_re[j] = dE_re*l.cos_S[j] + dE_im*l.sin_S[j];
+    l.Y_im[j] = dE_im*l.cos_S[j] - dE_re*l.sin_S[j];
   }
+}
 
-  output[0] = 0;
+// X = Y * prefactor * a(t-tau), where the prefactor contains the rest of the
+// phase
+template <int dim, typename Type>
+SIMD_INLINE void lewenstein_shifted_lanes(const int n_padded, const Type *pref_re, const Type *pref_im, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<n_padded; j++) {
+    Type h_re = pref_re[j] * l.at[j];
+    Type h_im = pref_im[j] * l.at[j];
 
-  delete[] At_data;
-  delete[] Bt_data;
-  delete[] Ct;
+    l.X_re[j] = l.Y_re[j]*h_re - l.Y_im[j]*h_im;
+    l.X_im[j] = l.Y_re[j]*h_im + l.Y_im[j]*h_re;
+  }
+}
 
-  return 0; // might be replaced by error code later, e.g. for failed interpolation
+// number of nodes of the block starting at the given node, and the number of
+// lanes loaded for it: with Filon quadrature, the lane after the nodes is the
+// node after the block, whose action is needed for the last interval
+template <typename Type>
+SIMD_INLINE int lewenstein_block_nodes(const int block, const int node_end, const lewenstein_tau_table<Type> &table, int &loaded) {
+  const int n = min(min(table.filon ? LEWENSTEIN_LANES-1 : LEWENSTEIN_LANES, node_end-block), table.run_last[block]-block);
+  loaded = table.filon ? n+1 : n;
+  return n;
+}
+
+// points view to t_i-tau_i of the first node of a block in the arrays from
+// which its lanes read (see lewenstein_tau_table), such that lane j reads
+// index -j, or index offset[j] if they are gathered; returns whether they are
+template <int dim, typename Type>
+SIMD_INLINE bool lewenstein_block_view(const int t_i, const int block, const int loaded, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, lewenstein_point<dim,Type> &view, lewenstein_lanes<dim,Type> &l) {
+  const int step = table.run_step[block];
+  const bool gathered = step!=1 && step!=table.coarse_step;
+  const lewenstein_point<dim,Type> &arrays = step==1 || gathered ? pt : *pt.coarse;
+
+  int offset = gathered ? t_i : t_i-table.tau[block];
+  if (!gathered && step!=1) {
+    const int sample = offset + table.coarse_origin;
+    offset = sample%step * table.coarse_row + sample/step;
+  }
+  for (int k=0; k<dim; k++) {
+    view.E[k] = arrays.E[k] + offset;
+    view.A[k] = arrays.A[k] + offset;
+    view.B[k] = arrays.B[k] + offset;
+  }
+  view.C = arrays.C + offset;
+  view.at = arrays.at + offset;
+  view.coarse = 0;
+
+  // padding lanes repeat the last loaded node
+  if (gathered) {
+    for (int j=0; j<LEWENSTEIN_LANES; j++) l.offset[j] = -table.tau[block + min(j, loaded-1)];
+  }
+  return gathered;
+}
+
+// momenta and action (with Ip*tau if Ip_t is given) of the lanes of a block,
+// which read t_i-tau_i from view (see lewenstein_block_view)
+template <int dim, typename Type, bool gathered>
+SIMD_INLINE void lewenstein_action_lanes(const int t_i, const int n_padded, const lewenstein_point<dim,Type> &pt, const lewenstein_point<dim,Type> &view, const Type *inv_t, const Type *Ip_t, lewenstein_lanes<dim,Type> &l) {
+  const Type *C = view.C;
+  if (Ip_t) {
+    for (int j=0; j<n_padded; j++) l.S[j] = Ip_t[j] + Type(0.5)*(pt.C[t_i]-C[gathered ? l.offset[j] : -j]);
+  }
+  else {
+    for (int j=0; j<n_padded; j++) l.S[j] = Type(0.5)*(pt.C[t_i]-C[gathered ? l.offset[j] : -j]);
+  }
+
+  for (int k=0; k<dim; k++) {
+    const Type *A = view.A[k], *B = view.B[k], *E = view.E[k];
+    const Type A_t = pt.A[k][t_i], B_t = pt.B[k][t_i];
+    for (int j=0; j<n_padded; j++) {
+      const int ts = gathered ? l.offset[j] : -j;
+      Type dB = B_t - B[ts];
+      Type pst = dB * inv_t[j];
+      l.ps[k][j] = pst - A_t;
+      l.pn[k][j] = pst - A[ts];
+      l.S[j] -= Type(0.5)*inv_t[j]*dB*dB;
+      l.E[k][j] = E[ts];
+    }
+  }
+}
+
+// a(t-tau) of the first n lanes, 0 for the others
+template <int dim, typename Type, bool gathered>
+SIMD_INLINE void lewenstein_at_lanes(const int n, const int n_padded, const Type *at, lewenstein_lanes<dim,Type> &l) {
+  for (int j=0; j<n; j++) l.at[j] = at[gathered ? l.offset[j] : -j];
+  for (int j=n; j<n_padded; j++) l.at[j] = 0;
+}
+
+// adds imag(integrand13)*dt for the nodes [node_begin, node_end) of the tau
+// grid to sum, except for the a(t) factor - this takes most of the time! The
+// integrand is evaluated with type Type, but summed up with type Acc.
+// All loops over lanes are free of branches and library calls so that the
+// compiler can vectorize them; the loop over the dipole elements is
+// vectorized if their get() method allows it (as for dipole_elements_H).
+// Blocks do not extend beyond a run of equally spaced nodes, so that the
+// lanes usually load t_i-tau_i with stride -1 instead of gathering them.
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_INLINE void lewenstein_tau_sum_nodes(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+  Acc acc[dim][LEWENSTEIN_ACCUMULATORS];
+  for (int k=0; k<dim; k++) for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) acc[k][a] = 0;
+  Type S_before = 0;
+
+  for (int block=node_begin, n=0; block<node_end; block+=n) {
+    // pad number of lanes to a multiple of LEWENSTEIN_ACCUMULATORS
+    int loaded;
+    n = lewenstein_block_nodes<Type>(block, node_end, table, loaded);
+    const int n_padded = (loaded+LEWENSTEIN_ACCUMULATORS-1) / LEWENSTEIN_ACCUMULATORS * LEWENSTEIN_ACCUMULATORS;
+
+    // pointers such that index j corresponds to the node block+j
+    const Type *inv_t = table.inv_t + block;
+    const Type *Ip_t = table.Ip_t + block;
+
+    // momenta and action
+    lewenstein_point<dim,Type> view;
+    if (lewenstein_block_view<dim,Type>(t_i, block, loaded, pt, table, view, l)) {
+      lewenstein_action_lanes<dim,Type,true>(t_i, n_padded, pt, view, inv_t, Ip_t, l);
+      lewenstein_at_lanes<dim,Type,true>(n, n_padded, view.at, l);
+    }
+    else {
+      lewenstein_action_lanes<dim,Type,false>(t_i, n_padded, pt, view, inv_t, Ip_t, l);
+      lewenstein_at_lanes<dim,Type,false>(n, n_padded, view.at, l);
+    }
+
+    // dipole elements
+    const Type *ps[dim], *pn[dim];
+    Type *ds_re[dim], *ds_im[dim], *dn_re[dim], *dn_im[dim];
+    for (int k=0; k<dim; k++) {
+      ps[k] = l.ps[k];
+      pn[k] = l.pn[k];
+      ds_re[k] = l.ds_re[k];
+      ds_im[k] = l.ds_im[k];
+      dn_re[k] = l.dn_re[k];
+      dn_im[k] = l.dn_im[k];
+    }
+    dipole_elements_call<dim,Type,Elements>::get_many(dp, n_padded, ps, ds_re, ds_im);
+    dipole_elements_call<dim,Type,Elements>::get_many(dp, n_padded, pn, dn_re, dn_im);
+
+    // X = d(p_st - A(t-tau)).E(t-tau) * exp(-iS) * prefactor * a(t-tau)
+    const Type *pref_re = table.pref_re + block;
+    const Type *pref_im = table.pref_im + block;
+
+    if (table.accuracy==SIMD_ACCURACY_FAST) lewenstein_phase_lanes<dim,Type,SIMD_ACCURACY_FAST>(n_padded, pref_re, pref_im, l);
+    else if (table.accuracy==SIMD_ACCURACY_HIGH) lewenstein_phase_lanes<dim,Type,SIMD_ACCURACY_HIGH>(n_padded, pref_re, pref_im, l);
+    else lewenstein_phase_lanes<dim,Type,SIMD_ACCURACY_EXACT>(n_padded, pref_re, pref_im, l);
+
+    // the action of the node before the block is the one of the last lane of
+    // the previous block
+    if (table.filon) {
+      l.phase[0] = block==node_begin ? lewenstein_action<dim,Type>(t_i, block-1, pt, table) : S_before;
+      for (int j=0; j<=n; j++) l.phase[j+1] = l.S[j];
+      S_before = l.S[n-1];
+      lewenstein_filon_weights<dim,Type>(block, n, n_padded, table, l);
+    }
+
+    // imag(d*(p_st - A(t)) * X)
+    for (int j=0; j<n_padded; j+=LEWENSTEIN_ACCUMULATORS) {
+      for (int k=0; k<dim; k++) {
+        for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) {
+          acc[k][a] += l.ds_re[k][j+a]*l.X_im[j+a] - l.ds_im[k][j+a]*l.X_re[j+a];
+        }
+      }
+    }
+  }
+
+  for (int k=0; k<dim; k++) {
+    for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) sum[k] += acc[k][a];
+  }
+}
+
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_INLINE void lewenstein_tau_sum_impl(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+  lewenstein_tau_sum_nodes<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+}
+
+#ifdef SIMD_DISPATCH
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_TARGET_AVX2 void lewenstein_tau_sum_avx2(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+  lewenstein_tau_sum_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+}
+
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_TARGET_AVX512 void lewenstein_tau_sum_avx512(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+  lewenstein_tau_sum_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+}
+#endif
+
+template <int dim, typename Type, class Elements, typename Acc>
+void lewenstein_tau_sum_generic(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+  lewenstein_tau_sum_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+}
+
+// calls the variant of lewenstein_tau_sum_impl compiled for the given
+// instruction set
+template <int dim, typename Type, class Elements, typename Acc>
+inline void lewenstein_tau_sum(simd_isa isa, const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const lewenstein_tau_table<Type> &table, const Elements &dp, lewenstein_lanes<dim,Type> &l, Acc *sum) {
+#ifdef SIMD_DISPATCH
+  if (isa==SIMD_AVX512) {
+    lewenstein_tau_sum_avx512<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+    return;
+  }
+  if (isa==SIMD_AVX2) {
+    lewenstein_tau_sum_avx2<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+    return;
+  }
+#endif
+  lewenstein_tau_sum_generic<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, table, dp, l, sum);
+}
+
+// like lewenstein_tau_sum_nodes, but for several species in one pass over the
+// nodes: the momenta, the action without Ip*tau and its sine and cosine are
+// computed once for all species, which only differ by a(t-tau), the dipole
+// elements (evaluated again, together with their product with E(t-tau) and
+// the shared phase factor, only if they are not the ones of the previous
+// species) and their prefactors, which contain exp(-i*Ip*tau). With several
+// windows (see lewenstein_plan::add_window), the prefactors are the ones
+// without the weight, and the integrand of each species is summed up once for
+// each window, with the weights windows[w] of its nodes. The ground state
+// amplitude of species s is pt.at + s*at_stride, and its sum for window w is
+// added to sum + (s*window_count+w)*sum_stride; acc is scratch space for
+// species_count*window_count*dim*LEWENSTEIN_ACCUMULATORS partial sums.
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_INLINE void lewenstein_tau_sum_species_nodes(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+  const lewenstein_tau_table<Type> &table = species[0].table;
+  for (int i=0; i<species_count*window_count*dim*LEWENSTEIN_ACCUMULATORS; i++) acc[i] = 0;
+  Type S_before = 0;
+
+  for (int block=node_begin, n=0; block<node_end; block+=n) {
+    int loaded;
+    n = lewenstein_block_nodes<Type>(block, node_end, table, loaded);
+    const int n_padded = (loaded+LEWENSTEIN_ACCUMULATORS-1) / LEWENSTEIN_ACCUMULATORS * LEWENSTEIN_ACCUMULATORS;
+
+    // momenta and action without Ip*tau
+    const Type *inv_t = table.inv_t + block;
+    lewenstein_point<dim,Type> view;
+    const bool gathered = lewenstein_block_view<dim,Type>(t_i, block, loaded, pt, table, view, l);
+    if (gathered) lewenstein_action_lanes<dim,Type,true>(t_i, n_padded, pt, view, inv_t, 0, l);
+    else lewenstein_action_lanes<dim,Type,false>(t_i, n_padded, pt, view, inv_t, 0, l);
+
+    if (table.accuracy==SIMD_ACCURACY_FAST) lewenstein_sincos_lanes<dim,Type,SIMD_ACCURACY_FAST>(n_padded, l);
+    else if (table.accuracy==SIMD_ACCURACY_HIGH) lewenstein_sincos_lanes<dim,Type,SIMD_ACCURACY_HIGH>(n_padded, l);
+    else lewenstein_sincos_lanes<dim,Type,SIMD_ACCURACY_EXACT>(n_padded, l);
+
+    const Type *ps[dim], *pn[dim];
+    Type *ds_re[dim], *ds_im[dim], *dn_re[dim], *dn_im[dim];
+    for (int k=0; k<dim; k++) {
+      ps[k] = l.ps[k];
+      pn[k] = l.pn[k];
+      ds_re[k] = l.ds_re[k];
+      ds_im[k] = l.ds_im[k];
+      dn_re[k] = l.dn_re[k];
+      dn_im[k] = l.dn_im[k];
+    }
+
+    for (int s=0; s<species_count; s++) {
+      const lewenstein_tau_table<Type> &species_table = species[s].table;
+      if (gathered) lewenstein_at_lanes<dim,Type,true>(n, n_padded, view.at + s*at_stride, l);
+      else lewenstein_at_lanes<dim,Type,false>(n, n_padded, view.at + s*at_stride, l);
+
+      if (s==0 || species[s].dp!=species[s-1].dp) {
+        dipole_elements_call<dim,Type,Elements>::get_many(*species[s].dp, n_padded, ps, ds_re, ds_im);
+        dipole_elements_call<dim,Type,Elements>::get_many(*species[s].dp, n_padded, pn, dn_re, dn_im);
+        lewenstein_unshifted_lanes<dim,Type>(n_padded, l);
+      }
+
+      if (window_count>1) lewenstein_shifted_lanes<dim,Type>(n_padded, species_table.unweighted_re + block, species_table.unweighted_im + block, l);
+      else lewenstein_shifted_lanes<dim,Type>(n_padded, species_table.shifted_re + block, species_table.shifted_im + block, l);
+
+      if (species_table.filon) {
+        const Type *Ip_t = species_table.Ip_t + block;
+        l.phase[0] = block==node_begin ? lewenstein_action<dim,Type>(t_i, block-1, pt, species_table) : S_before + Ip_t[-1];
+        for (int j=0; j<=n; j++) l.phase[j+1] = l.S[j] + Ip_t[j];
+        lewenstein_filon_weights<dim,Type>(block, n, n_padded, species_table, l);
+      }
+
+      // imag(d*(p_st - A(t)) * X), summed up with the weights of each window
+      for (int k=0; k<dim; k++) {
+        for (int j=0; j<n_padded; j++) l.Z[k][j] = l.ds_re[k][j]*l.X_im[j] - l.ds_im[k][j]*l.X_re[j];
+      }
+
+      for (int w=0; w<window_count; w++) {
+        Acc block_acc[dim][LEWENSTEIN_ACCUMULATORS];
+        for (int k=0; k<dim; k++) for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) block_acc[k][a] = 0;
+        if (window_count==1) {
+          for (int j=0; j<n_padded; j+=LEWENSTEIN_ACCUMULATORS) {
+            for (int k=0; k<dim; k++) {
+              for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) block_acc[k][a] += l.Z[k][j+a];
+            }
+          }
+        }
+        else {
+          const Type *weight = windows[w] + block;
+          for (int j=0; j<n_padded; j+=LEWENSTEIN_ACCUMULATORS) {
+            for (int k=0; k<dim; k++) {
+              for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) block_acc[k][a] += l.Z[k][j+a]*weight[j+a];
+            }
+          }
+        }
+
+        Acc *window_acc = acc + (s*window_count+w)*dim*LEWENSTEIN_ACCUMULATORS;
+        for (int k=0; k<dim; k++) {
+          for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) window_acc[k*LEWENSTEIN_ACCUMULATORS+a] += block_acc[k][a];
+        }
+      }
+    }
+
+    // the action without Ip*tau of the node before the next block
+    S_before = l.S[n-1];
+  }
+
+  for (int i=0; i<species_count*window_count; i++) {
+    for (int k=0; k<dim; k++) {
+      for (int a=0; a<LEWENSTEIN_ACCUMULATORS; a++) sum[i*sum_stride+k] += acc[(i*dim+k)*LEWENSTEIN_ACCUMULATORS+a];
+    }
+  }
+}
+
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_INLINE void lewenstein_tau_sum_species_impl(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+  lewenstein_tau_sum_species_nodes<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+}
+
+#ifdef SIMD_DISPATCH
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_TARGET_AVX2 void lewenstein_tau_sum_species_avx2(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+  lewenstein_tau_sum_species_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+}
+
+template <int dim, typename Type, class Elements, typename Acc>
+SIMD_TARGET_AVX512 void lewenstein_tau_sum_species_avx512(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+  lewenstein_tau_sum_species_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+}
+#endif
+
+template <int dim, typename Type, class Elements, typename Acc>
+void lewenstein_tau_sum_species_generic(const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+  lewenstein_tau_sum_species_impl<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+}
+
+// calls the variant of lewenstein_tau_sum_species_impl compiled for the given
+// instruction set
+template <int dim, typename Type, class Elements, typename Acc>
+inline void lewenstein_tau_sum_species(simd_isa isa, const int t_i, const int node_begin, const int node_end, const lewenstein_point<dim,Type> &pt, const int at_stride, const int species_count, const lewenstein_species<Type,Elements> *species, const int window_count, const Type *const *windows, lewenstein_lanes<dim,Type> &l, Acc *acc, Acc *sum, const int sum_stride) {
+#ifdef SIMD_DISPATCH
+  if (isa==SIMD_AVX512) {
+    lewenstein_tau_sum_species_avx512<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+    return;
+  }
+  if (isa==SIMD_AVX2) {
+    lewenstein_tau_sum_species_avx2<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+    return;
+  }
+#endif
+  lewenstein_tau_sum_species_generic<dim,Type,Elements,Acc>(t_i, node_begin, node_end, pt, at_stride, species_count, species, window_count, windows, l, acc, sum, sum_stride);
+}
+
+// nodes of a two-level tau grid for lewenstein_plan: all tau_i below fine,
+// then every stride-th tau_i up to weight_length-1 (which is always a node);
+// the integrand oscillates fastest at small tau, where the excursion ends
+// close to the ion. Writes the nodes to nodes (unless it is 0) and returns
+// their number.
+inline int lewenstein_graded_nodes(int weight_length, int fine, int stride, int *nodes) {
+  if (stride<1) stride = 1;
+  int count = 0;
+  for (int tau_i=0; tau_i<weight_length; tau_i++) {
+    if (tau_i<fine || (tau_i-fine)%stride==0 || tau_i==weight_length-1) {
+      if (nodes) nodes[count] = tau_i;
+      count++;
+    }
+  }
+  return count;
+}
+
+// Instrumentation of lewenstein_plan::execute, switched on at run time by
+// passing a lewenstein_stats to lewenstein_plan::set_stats. Compiling with
+// -DLEWENSTEIN_STATS=0 removes it completely.
+#ifndef LEWENSTEIN_STATS
+  #define LEWENSTEIN_STATS 1
+#endif
+
+inline double lewenstein_time() {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+// called with the fraction of the work of the current execute() call that is
+// done, and the user pointer
+typedef void (*lewenstein_progress_callback)(double fraction, void *user);
+
+// The counters accumulate over all execute() calls until reset() is called.
+// The progress callback (if not 0) is called at most every progress_interval
+// seconds, always by the thread that called execute(), and once at the end of
+// each call.
+struct lewenstein_stats {
+  double calls, points;
+
+  // wall time of preparing A(t), B(t), C(t) and a(t) of all points, of the
+  // tau integrals, and of the whole calls, in seconds
+  double prepare_seconds, tau_seconds, total_seconds;
+
+  // integrand evaluations, the ones among them with zero weight, and the
+  // pairs (t_i, tau_i) skipped by a non-uniform tau grid
+  double evaluations, zero_weight_evaluations, skipped_evaluations;
+
+  // per thread: time spent on tiles (the difference to tau_seconds is the
+  // time spent waiting for other threads), evaluations and tiles
+  vector<double> thread_seconds, thread_evaluations, thread_tiles;
+
+  lewenstein_progress_callback progress;
+  void *progress_user;
+  double progress_interval;
+
+  lewenstein_stats() : progress(0), progress_user(0), progress_interval(1) {
+    reset();
+  };
+
+  void reset() {
+    calls = points = 0;
+    prepare_seconds = tau_seconds = total_seconds = 0;
+    evaluations = zero_weight_evaluations = skipped_evaluations = 0;
+    thread_seconds.clear();
+    thread_evaluations.clear();
+    thread_tiles.clear();
+  };
+};
+
+// Layout of the arrays passed to lewenstein_plan::execute_strided: the
+// distances (in elements, possibly negative or 0) between consecutive points,
+// time steps and field components, e.g. of a strided NumPy view, and a factor
+// applied to all values while they are read or written, e.g. for the unit
+// conversion.
+struct lewenstein_layout {
+  ptrdiff_t point, time, component;
+  double scale;
+
+  lewenstein_layout(ptrdiff_t point_stride=0, ptrdiff_t time_stride=1, ptrdiff_t component_stride=1, double factor=1) :
+    point(point_stride), time(time_stride), component(component_stride), scale(factor) {};
+
+  // layout of the arrays passed to lewenstein_plan::execute (points x N x dim)
+  static lewenstein_layout contiguous(int N, int dim) {
+    return lewenstein_layout((ptrdiff_t)N*dim, dim, 1);
+  };
+
+  bool is_contiguous(int N, int dim) const {
+    return point==(ptrdiff_t)N*dim && time==dim && (component==1 || dim==1) && scale==1;
+  };
+};
+
+// Precomputed data for repeated calculations with the same time axis, weights,
+// Ip, epsilon_t and dipole elements, similar to plans in FFTW: the plan holds
+// the tables of quantities depending only on tau and aligned scratch space for
+// each thread, so that execute() can be called for many driving fields without
+// allocating memory (unless it is called with more points than before).
+// The dipole elements are referenced, not copied, so they must stay alive
+// until the plan is destroyed. execute() must not be called concurrently on
+// the same plan.
+// The integrand is evaluated with type Type (and Elements must be dipole
+// elements for this type), while the arrays passed to the plan, the
+// preparation of A(t), B(t), C(t) and the sum over tau use type Acc. E.g.,
+// lewenstein_plan<dim,float,dipole_elements_H<dim,float>,double> computes with
+// single precision SIMD lanes, but accumulates the result in double precision.
+// By default, the tau integral uses the trapezoidal rule on all tau_i below
+// weight_length. Optionally, it only uses the given nodes of a coarser tau
+// grid (e.g. from lewenstein_graded_nodes), with the trapezoidal rule or with
+// Filon quadrature, which integrates the oscillation of exp(-iS) between the
+// nodes exactly.
+// In periodic mode, the driving field passed to execute() is one period of a
+// periodic field on an equally spaced time axis t_0, ..., t_{N-1} (with
+// period N*(t_1-t_0)), and d(t) is computed for this period only, as if the
+// field had been repeated long enough before. t_i-tau_i wraps around into
+// earlier periods, so weight_length may exceed N: the quantities of each
+// point are prepared for weight_length-1 additional samples before t_0 (the
+// halo), so that the kernel reads them without any index arithmetic.
+// A plan can compute the dipole responses of several species (e.g. of a gas
+// mixture, or for a scan of Ip) in the same pass over (t_i, tau_i), see
+// add_species and execute_species, and for several windows of weights (e.g.
+// of the short and the long trajectories), see add_window.
+template <int dim, typename Type, class Elements, typename Acc=Type>
+class lewenstein_plan {
+  private:
+    int N;
+    int weight_length;
+    bool periodic;
+    int halo;         // samples before t_0, for periodic mode
+    lewenstein_stats *stats;
+    int node_count;
+    int *node_tau;    // tau_i of the nodes
+    int *nodes_below; // number of nodes below each tau_i
+    int *zero_nodes;  // number of nodes with zero weight below each node
+    bool filon;
+    Acc *t_acc;
+    Type *t;
+    Type *weights;
+    int weights_passed; // length of the weights passed to the constructor
+    Type epsilon_t;
+    simd_isa isa;
+
+    // tau table shared by all species (without Ip_t and prefactors), and the
+    // prefactor of each node without the phase
+    lewenstein_tau_table<Type> table;
+    Type *table_data;
+    int *run_data;
+    vector<complex<Acc> > prefactor, unweighted;
+
+    // weights of each window (see add_window), indexed by tau_i and by node
+    // (followed by LEWENSTEIN_PADDING zeros); window 0 are the weights passed
+    // to the constructor
+    vector<Type *> window_weights, window_nodes;
+
+    // species 0 is the one passed to the constructor
+    vector<lewenstein_species<Type,Elements> > species;
+
+    int threads;      // number of allocated lanes
+    lewenstein_lanes<dim,Type> **lanes;
+
+    // points of each block (block_first[b] to block_first[b+1]-1) and the
+    // next of its work items, see execute
+    vector<int> block_first, block_next;
+
+    int stride;
+    int point_size;
+    size_t soa_size;
+    Type *soa_data;
+
+    // not copyable
+    lewenstein_plan(const lewenstein_plan &);
+    lewenstein_plan &operator=(const lewenstein_plan &);
+
+    // last tau_i of the integral for t_i
+    int tau_end(const int t_i) const {
+      return periodic ? weight_length-1 : min(weight_length, t_i+1)-1;
+    }
+
+    // end of the nodes handled by lewenstein_tau_sum if the integral ends at
+    // tau_end: these need the following node, so if tau_end is not a node,
+    // the last node before tau_end is left to add_node
+    int interior_end(const int tau_end) const {
+      const int below = nodes_below[tau_end];
+      return below<node_count && node_tau[below]==tau_end ? below : below-1;
+    }
+
+    // quasi-classical action, like in lewenstein_integrand
+    Acc action(const int t_i, const int tau_i, const lewenstein_point<dim,Type> &pt, const Type Ip) const {
+      if (tau_i==0) return 0;
+      Acc S = Acc(Ip) * t_acc[tau_i] + Acc(0.5)*(Acc(pt.C[t_i])-Acc(pt.C[t_i-tau_i]));
+      for (int k=0; k<dim; k++) {
+        Acc dB = Acc(pt.B[k][t_i]) - Acc(pt.B[k][t_i-tau_i]);
+        S -= Acc(0.5)/t_acc[tau_i]*dB*dB;
+      }
+      return S;
+    }
+
+    // adds the contribution of a tau_i that is not handled by
+    // lewenstein_tau_sum to integral of the given species, whose ground state
+    // amplitude is pt.at, with the weights of the given window; tau_before
+    // and tau_after are the neighbouring nodes, or -1 at the ends of the
+    // integral
+    void add_node(const int t_i, const int tau_i, const int tau_before, const int tau_after, const lewenstein_point<dim,Type> &pt, const lewenstein_species<Type,Elements> &sp, const int window, Acc *integral) const {
+      const Type Ip = sp.Ip;
+      vec<dim,complex<Type> > value = lewenstein_integrand<dim,Type,Elements>(t_i, tau_i, t, pt, window_weights[window], Ip, epsilon_t, *sp.dp);
+
+      Acc w_re = 0, w_im = 0;
+      if (!filon) {
+        if (tau_before>=0) w_re += (t_acc[tau_i]-t_acc[tau_before])/2;
+        if (tau_after>=0) w_re += (t_acc[tau_after]-t_acc[tau_i])/2;
+      }
+      else {
+        Acc S = action(t_i, tau_i, pt, Ip), phi_re, phi_im;
+        if (tau_before>=0) {
+          lewenstein_filon_phi<SIMD_ACCURACY_EXACT,Acc>(S - action(t_i, tau_before, pt, Ip), phi_re, phi_im);
+          w_re += (t_acc[tau_i]-t_acc[tau_before])*phi_re;
+          w_im -= (t_acc[tau_i]-t_acc[tau_before])*phi_im;
+        }
+        if (tau_after>=0) {
+          lewenstein_filon_phi<SIMD_ACCURACY_EXACT,Acc>(action(t_i, tau_after, pt, Ip) - S, phi_re, phi_im);
+          w_re += (t_acc[tau_after]-t_acc[tau_i])*phi_re;
+          w_im += (t_acc[tau_after]-t_acc[tau_i])*phi_im;
+        }
+      }
+
+      for (int k=0; k<dim; k++) {
+        integral[k] += Acc(imag(value.x[k]))*w_re;
+        if (filon) integral[k] += Acc(real(value.x[k]))*w_im;
+      }
+    }
+
+    // counts the integrand evaluations for t_begin<=t_i<t_end: all nodes up
+    // to tau_end and tau_end itself, for each of the species
+    void count_evaluations(const int t_begin, const int t_end, const int species_count, double &evaluations, double &zero_weight, double &skipped) const {
+      for (int t_i=t_begin; t_i<t_end; t_i++) {
+        const int tau_last = tau_end(t_i);
+        if (tau_last<1) continue;
+
+        const int below = nodes_below[tau_last];
+        evaluations += species_count*(below+1);
+        zero_weight += species_count*(zero_nodes[below] + (weights[tau_last]==0 ? 1 : 0));
+        skipped += species_count*(tau_last-below);
+      }
+    }
+
+    // tabulates Ip*tau and the prefactors of a species
+    void tabulate_species(lewenstein_species<Type,Elements> &sp, const Acc ip) {
+      const int table_length = node_count+LEWENSTEIN_PADDING;
+      sp.Ip = Type(ip);
+      sp.table = table;
+      sp.table_data = (Type *)simd_malloc(7*table_length*sizeof(Type));
+      memset(sp.table_data, 0, 7*table_length*sizeof(Type));
+      sp.table.Ip_t = sp.table_data;
+      sp.table.pref_re = sp.table_data + table_length;
+      sp.table.pref_im = sp.table_data + 2*table_length;
+      sp.table.shifted_re = sp.table_data + 3*table_length;
+      sp.table.shifted_im = sp.table_data + 4*table_length;
+      sp.table.unweighted_re = sp.table_data + 5*table_length;
+      sp.table.unweighted_im = sp.table_data + 6*table_length;
+
+      for (int node=0; node<node_count; node++) {
+        const Acc Ip_t = ip * t_acc[node_tau[node]];
+        const complex<Acc> phase(cos(Ip_t), -sin(Ip_t));
+        const complex<Acc> shifted = prefactor[node] * phase, shifted_unweighted = unweighted[node] * phase;
+        sp.table.Ip_t[node] = Type(Ip_t);
+        sp.table.pref_re[node] = Type(real(prefactor[node]));
+        sp.table.pref_im[node] = Type(imag(prefactor[node]));
+        sp.table.shifted_re[node] = Type(real(shifted));
+        sp.table.shifted_im[node] = Type(imag(shifted));
+        sp.table.unweighted_re[node] = Type(real(shifted_unweighted));
+        sp.table.unweighted_im[node] = Type(imag(shifted_unweighted));
+      }
+    }
+
+    // tabulates the weights of a window by tau_i and by node; weights beyond
+    // length are 0
+    void tabulate_window(const int length, const Acc *data) {
+      Type *by_tau = window_weights.empty() ? weights : new Type[weight_length];
+      for (int tau_i=0; tau_i<weight_length; tau_i++) by_tau[tau_i] = tau_i<length ? Type(data[tau_i]) : 0;
+
+      Type *by_node = (Type *)simd_malloc((node_count+LEWENSTEIN_PADDING)*sizeof(Type));
+      memset(by_node, 0, (node_count+LEWENSTEIN_PADDING)*sizeof(Type));
+      for (int node=0; node<node_count; node++) by_node[node] = by_tau[node_tau[node]];
+
+      window_weights.push_back(by_tau);
+      window_nodes.push_back(by_node);
+    }
+
+  public:
+    lewenstein_plan(const int n, Acc *t_data, int wl, Acc *weights_data, Acc ip, Acc eps, const Elements &elements, int nodes_length=0, const int *nodes=0, bool filon_quadrature=false, bool periodic_field=false) {
+      typedef complex<Acc> cType;
+
+      Acc pi = 4.0*atan(1.0);
+      cType i = cType(Acc(0), Acc(1));
+
+      N = n;
+      periodic = periodic_field && N>1;
+      weight_length = wl>N && !periodic ? N : wl;
+      halo = periodic ? max(weight_length-1, 0) : 0;
+      stats = 0;
+      epsilon_t = Type(eps);
+      isa = simd_detect();
+      filon = filon_quadrature;
+
+      // nodes of the tau grid: all tau_i, or the given ones below
+      // weight_length together with both ends of the interval
+      vector<int> grid;
+      for (int tau_i=0; tau_i<weight_length; tau_i++) {
+        if (!nodes_length || tau_i==0 || tau_i==weight_length-1) grid.push_back(tau_i);
+      }
+      for (int node=0; node<nodes_length; node++) {
+        if (nodes[node]>0 && nodes[node]<weight_length-1) grid.push_back(nodes[node]);
+      }
+      sort(grid.begin(), grid.end());
+      grid.erase(unique(grid.begin(), grid.end()), grid.end());
+
+      node_count = (int)grid.size();
+      node_tau = new int[node_count+LEWENSTEIN_PADDING];
+      for (int node=0; node<node_count+LEWENSTEIN_PADDING; node++) node_tau[node] = node<node_count ? grid[node] : 0;
+      nodes_below = new int[weight_length];
+      for (int tau_i=0, node=0; tau_i<weight_length; tau_i++) {
+        while (node<node_count && node_tau[node]<tau_i) node++;
+        nodes_below[tau_i] = node;
+      }
+      zero_nodes = new int[node_count+1];
+      zero_nodes[0] = 0;
+      for (int node=0; node<node_count; node++) zero_nodes[node+1] = zero_nodes[node] + (weights_data[node_tau[node]]==0 ? 1 : 0);
+
+      // in periodic mode, the time axis is continued beyond t_{N-1} for the
+      // tau axis and the preparation of the halo
+      const int samples = halo+N;
+      t_acc = new Acc[samples];
+      memcpy(t_acc, t_data, N*sizeof(Acc));
+      for (int t_i=N; t_i<samples; t_i++) t_acc[t_i] = t_data[0] + t_i*(t_data[1]-t_data[0]);
+      t_data = t_acc;
+      t = new Type[samples];
+      for (int t_i=0; t_i<samples; t_i++) t[t_i] = Type(t_data[t_i]);
+      weights = new Type[weight_length]; // filled as window 0, see below
+      weights_passed = wl;
+
+      // tabulate quantities that depend on tau only; the prefactor includes
+      // the weight of the trapezoidal rule for nodes in the interior of the
+      // interval. Ip*tau and the prefactor are tabulated for each species.
+      const int table_length = node_count+LEWENSTEIN_PADDING;
+      table_data = (Type *)simd_malloc(2*table_length*sizeof(Type));
+      memset(table_data, 0, 2*table_length*sizeof(Type));
+      table.tau = node_tau;
+      table.inv_t = table_data;
+      table.h = table_data + table_length;
+      table.Ip_t = table.pref_re = table.pref_im = table.shifted_re = table.shifted_im = 0;
+      table.unweighted_re = table.unweighted_im = 0;
+      table.filon = filon;
+      table.accuracy = SIMD_ACCURACY_EXACT;
+
+      // runs of equally spaced nodes; the spacing of the coarse copies is the
+      // one apart from 1 with the most nodes, if they fill a block
+      run_data = new int[2*table_length];
+      table.run_last = run_data;
+      table.run_step = run_data + table_length;
+      for (int node=0; node<table_length; node++) {
+        table.run_last[node] = node;
+        table.run_step[node] = 1;
+      }
+      vector<int> run_nodes(max(weight_length, 2), 0);
+      for (int first=0, last=1; first+1<node_count; first=last) {
+        const int step = node_tau[first+1]-node_tau[first];
+        for (last=first+1; last+1<node_count && node_tau[last+1]-node_tau[last]==step; last++);
+        for (int node=first; node<last; node++) {
+          table.run_last[node] = last;
+          table.run_step[node] = step;
+        }
+        run_nodes[step] += last-first;
+      }
+      table.coarse_step = 1;
+      run_nodes[1] = LEWENSTEIN_LANES-1;
+      for (int step=2; step<weight_length; step++) {
+        if (run_nodes[step]>run_nodes[table.coarse_step]) table.coarse_step = step;
+      }
+      table.coarse_origin = LEWENSTEIN_PADDING+halo;
+      table.coarse_row = LEWENSTEIN_PADDING + (samples+LEWENSTEIN_PADDING+table.coarse_step-1)/table.coarse_step;
+
+      prefactor.resize(node_count);
+      unweighted.resize(node_count);
+      for (int node=0; node<node_count; node++) {
+        const int tau_i = node_tau[node];
+        cType c = pi/(eps+(Acc)0.5*i*t_data[tau_i]);
+        Acc dt = 0;
+        if (node>0) dt += (t_data[tau_i]-t_data[node_tau[node-1]])/2;
+        if (node+1<node_count) dt += (t_data[node_tau[node+1]]-t_data[tau_i])/2;
+        prefactor[node] = c*sqrt(c) * weights_data[tau_i] * (filon ? Acc(1) : dt); // c*sqrt(c) is a lot faster than pow(c, 1.5)
+        unweighted[node] = c*sqrt(c) * (filon ? Acc(1) : dt);
+
+        table.inv_t[node] = tau_i>0 ? Type(1/t_data[tau_i]) : 0;
+        table.h[node] = node+1<node_count ? Type(t_data[node_tau[node+1]]-t_data[tau_i]) : 0;
+      }
+
+      // the weights are window 0
+      tabulate_window(weight_length, weights_data);
+
+      species.resize(1);
+      species[0].dp = &elements;
+      species[0].ionization = 0;
+      tabulate_species(species[0], ip);
+
+      // scratch space for each thread, allocated by execute()
+      threads = 0;
+      lanes = 0;
+
+      // Et, At, Bt, Ct and at of each species for each point, including the
+      // halo; every array is preceded by LEWENSTEIN_PADDING zeros, and the
+      // arrays are followed by their coarse copies, if any, each of which
+      // has coarse_step rows (see lewenstein_tau_table). Allocated by
+      // execute() on first use.
+      stride = table.coarse_step>1 ? table.coarse_step*table.coarse_row : samples+LEWENSTEIN_PADDING;
+      point_size = (3*dim+2)*stride;
+      soa_size = 0;
+      soa_data = 0;
+    };
+
+    ~lewenstein_plan() {
+      for (int thread=0; thread<threads; thread++) simd_free(lanes[thread]);
+      delete[] lanes;
+      simd_free(table_data);
+      delete[] run_data;
+      for (size_t s=0; s<species.size(); s++) simd_free(species[s].table_data);
+      for (size_t w=0; w<window_nodes.size(); w++) {
+        if (w>0) delete[] window_weights[w];
+        simd_free(window_nodes[w]);
+      }
+      simd_free(soa_data);
+      delete[] node_tau;
+      delete[] nodes_below;
+      delete[] zero_nodes;
+      delete[] t_acc;
+      delete[] t;
+      delete[] weights;
+    };
+
+    // lets execute() compute the ground state amplitude from the driving
+    // field with the given ionization rates if no at_data is passed (not in
+    // periodic mode); the table is referenced, not copied, and 0 disables it
+    void set_ionization_rate(const ionization_rate_table *rate) {
+      species[0].ionization = rate;
+    };
+
+    // adds a species with another ionization potential, dipole elements and
+    // ionization rates (or 0, see set_ionization_rate), whose dipole
+    // responses execute_species computes together with the ones of the
+    // species passed to the constructor. All other parameters are shared.
+    // The dipole elements and ionization rates are referenced, not copied.
+    // Species with the same dipole elements should be added one after
+    // another, which saves their evaluation. Returns the index of the
+    // species (1, 2, ...).
+    int add_species(Acc ip, const Elements &elements, const ionization_rate_table *rate=0) {
+      lewenstein_species<Type,Elements> sp;
+      sp.dp = &elements;
+      sp.ionization = rate;
+      tabulate_species(sp, ip);
+      species.push_back(sp);
+      return (int)species.size()-1;
+    };
+
+    int species_count() const {
+      return (int)species.size();
+    };
+
+    // adds a window: other weights on the same tau axis, e.g. the ones of the
+    // short or the long trajectories, for which execute_species computes the
+    // dipole responses of each species from the same evaluations of the
+    // integrand (trajectory decomposition). The window is padded with zeros;
+    // it must not be longer than the weights passed to the constructor (and,
+    // like them, only its first weight_length values are used). Returns the
+    // index of the window (1, 2, ...), or -1 if it is too long.
+    int add_window(const int length, const Acc *data) {
+      if (length>weights_passed) return -1;
+      tabulate_window(length, data);
+      return (int)window_nodes.size()-1;
+    };
+
+    int window_count() const {
+      return (int)window_nodes.size();
+    };
+
+    // allocates the scratch space of each thread of a team of the given size
+    // (see lewenstein_set_threads) if it does not exist yet; each thread
+    // initializes its own, so that it is local to the thread on NUMA machines
+    void allocate_lanes(int team) {
+      if (team<=threads) return;
+
+      lewenstein_lanes<dim,Type> **grown = new lewenstein_lanes<dim,Type>*[team];
+      for (int thread=0; thread<team; thread++) grown[thread] = thread<threads ? lanes[thread] : 0;
+      delete[] lanes;
+      lanes = grown;
+
+      #pragma omp parallel num_threads(team)
+      {
+        lewenstein_bind_thread();
+        lewenstein_lanes<dim,Type> *&own = lanes[lewenstein_thread_num()];
+        if (!own) {
+          own = (lewenstein_lanes<dim,Type> *)simd_malloc(sizeof(lewenstein_lanes<dim,Type>));
+          memset(own, 0, sizeof(lewenstein_lanes<dim,Type>));
+        }
+      }
+
+      // threads that were not started by the runtime
+      for (int thread=0; thread<team; thread++) {
+        if (!lanes[thread]) lanes[thread] = (lewenstein_lanes<dim,Type> *)simd_malloc(sizeof(lewenstein_lanes<dim,Type>));
+      }
+      threads = team;
+    };
+
+    // returns the next work item of a block, or -1 if there is none left
+    int next_work(int block, const int tiles) {
+      const int count = tiles * (block_first[block+1]-block_first[block]);
+      int work_i = -1;
+      #pragma omp critical(lewenstein_schedule)
+      {
+        if (block_next[block]<count) work_i = block_next[block]++;
+      }
+      return work_i;
+    };
+
+    // selects the accuracy tier of the sine and cosine of the action in the
+    // tau integral (see simd_accuracy); the end points of the integral are
+    // always computed exactly
+    void set_accuracy(simd_accuracy accuracy) {
+      table.accuracy = accuracy;
+      for (size_t s=0; s<species.size(); s++) species[s].table.accuracy = accuracy;
+    };
+
+    // lets execute() record timers and counters in stats (see
+    // lewenstein_stats); 0 switches the instrumentation off
+    void set_stats(lewenstein_stats *s) {
+      stats = s;
+    };
+
+    // calculates dipole responses for a batch of driving fields
+    //   Et_data - driving fields of all points, one after another (points x N x dim);
+    //             in periodic mode, one period of each
+    //   at_data - ground state amplitudes (points x N); use at_stride=0 to
+    //             share one amplitude of length N between all points, or pass
+    //             0 to neglect ground state depletion (or to compute it, see
+    //             set_ionization_rate)
+    //   output_data - dipole responses, same layout as Et_data
+    int execute(const int points, Acc *Et_data, Acc *at_data, int at_stride, Acc *output_data) {
+      const lewenstein_layout layout = lewenstein_layout::contiguous(N, dim);
+      return execute_strided(points, Et_data, layout, at_data, lewenstein_layout(at_stride, 1, 0), output_data, layout);
+    };
+
+    // like execute, but for arrays of any layout (see lewenstein_layout),
+    // which are read and written in place; only the driving fields of points
+    // that are not contiguous or need to be scaled are copied, point by point
+    // by the threads that prepare them. The component stride of at_layout is
+    // not used.
+    int execute_strided(const int points, const Acc *Et_data, const lewenstein_layout &Et_layout, const Acc *at_data, const lewenstein_layout &at_layout, Acc *output_data, const lewenstein_layout &output_layout) {
+      return execute_species(1, points, Et_data, Et_layout, at_data, at_layout, 0, output_data, output_layout, 0);
+    };
+
+    // like execute_strided, but computes the dipole responses of the first
+    // species_count species (see add_species) in one pass over (t_i, tau_i).
+    // The ground state amplitudes and dipole responses of species s start
+    // s*at_species and s*output_species elements after the ones of species 0;
+    // at_species=0 shares the ground state amplitudes between the species.
+    // With window_count>1, the dipole responses of each species are computed
+    // for the first window_count windows (see add_window), and the ones of
+    // window w start w*output_window elements after the ones of window 0.
+    int execute_species(int species_count, const int points, const Acc *Et_data, const lewenstein_layout &Et_layout, const Acc *at_data, const lewenstein_layout &at_layout, const ptrdiff_t at_species, Acc *output_data, const lewenstein_layout &output_layout, const ptrdiff_t output_species, int window_count=1, const ptrdiff_t output_window=0) {
+      int point_i;
+      species_count = max(1, min(species_count, (int)species.size()));
+      window_count = max(1, min(window_count, (int)window_nodes.size()));
+      const int outputs = species_count*window_count;
+      lewenstein_stats *const s = LEWENSTEIN_STATS ? stats : 0;
+      const double time_start = s ? lewenstein_time() : 0;
+
+      // the points are divided into one block per thread, which the thread
+      // prepares (so that their memory is local to it on NUMA machines) and
+      // computes first, before it helps with the other blocks
+      const int team = lewenstein_get_threads();
+      allocate_lanes(team);
+      block_first.resize(team+1);
+      block_next.assign(team, 0);
+      for (int block=0; block<=team; block++) block_first[block] = int((long long)points*block/team);
+
+      // the ground state amplitudes of the species follow the other arrays,
+      // and the coarse copies follow all of them
+      const int arrays = 3*dim+1+species_count;
+      const bool coarse = table.coarse_step>1;
+      point_size = (coarse ? 2 : 1)*arrays*stride;
+      if ((size_t)points*point_size>soa_size) {
+        simd_free(soa_data);
+        soa_size = (size_t)points*point_size;
+        soa_data = (Type *)simd_malloc(soa_size*sizeof(Type));
+      }
+
+      // initialize Et, At, Bt, Ct and copy at for all points at once; in
+      // periodic mode, the halo is filled with the preceding periods
+      const int samples = halo+N;
+      const bool gather = !Et_layout.is_contiguous(N, dim);
+      #pragma omp parallel num_threads(team) shared(Et_data, at_data)
+      {
+        lewenstein_bind_thread();
+        const int thread = lewenstein_thread_num(), team_size = lewenstein_team_size();
+        vector<Acc> gathered(gather ? N*dim : 0);
+
+        for (int block=thread; block<team; block+=team_size) {
+          for (int point=block_first[block]; point<block_first[block+1]; point++) {
+            Acc *Et_point = const_cast<Acc *>(Et_data) + point*Et_layout.point;
+            if (gather) {
+              for (int t_i=0; t_i<N; t_i++) {
+                for (int k=0; k<dim; k++) gathered[t_i*dim+k] = Acc(Et_layout.scale) * Et_point[t_i*Et_layout.time + k*Et_layout.component];
+              }
+              Et_point = &gathered[0];
+            }
+
+            Type *E = soa_data + point*point_size + LEWENSTEIN_PADDING;
+            Type *A = E + dim*stride;
+            Type *B = E + 2*dim*stride;
+            Type *C = E + 3*dim*stride;
+            Type *at = E + (3*dim+1)*stride;
+
+            for (int array_i=0; array_i<3*dim+1+species_count; array_i++) {
+              memset(E + array_i*stride - LEWENSTEIN_PADDING, 0, LEWENSTEIN_PADDING*sizeof(Type));
+            }
+
+            lewenstein_prepare_soa<dim,Acc,Type>(samples, stride, t_acc, Et_point, E, A, B, C, -halo, periodic ? N : 0);
+
+            // without at_data, there is no ground state depletion, unless it is
+            // computed from the ionization rate (once for consecutive species
+            // with the same rates)
+            for (int species_i=0; species_i<species_count; species_i++, at+=stride) {
+              const ionization_rate_table *ionization = species[species_i].ionization;
+              if (!at_data && ionization && !periodic) {
+                if (species_i>0 && ionization==species[species_i-1].ionization) memcpy(at, at-stride, N*sizeof(Type));
+                else ionization->ground_state_amplitude(N, dim, t_acc, Et_point, at);
+              }
+              else {
+                const Acc *species_at = at_data ? at_data + species_i*at_species : 0;
+                for (int t_i=0; t_i<samples; t_i++) {
+                  const int sample = (t_i-halo%N+N) % N;
+                  at[t_i] = at_data ? Type(Acc(at_layout.scale) * species_at[point*at_layout.point + sample*at_layout.time]) : 1;
+                }
+              }
+            }
+
+            // sample m of an array goes to row m%coarse_step of its copy
+            if (coarse) {
+              const int step = table.coarse_step, row = table.coarse_row;
+              for (int array_i=0; array_i<arrays; array_i++) {
+                const Type *from = E + array_i*stride - LEWENSTEIN_PADDING;
+                Type *to = E + (arrays+array_i)*stride - LEWENSTEIN_PADDING;
+                memset(to, 0, stride*sizeof(Type));
+                for (int m=0; m<samples+LEWENSTEIN_PADDING; m++) to[m%step*row + LEWENSTEIN_PADDING + m/step] = from[m];
+              }
+            }
+          }
+        }
+      }
+
+      // The (t_i, tau_i) triangle of each point is cut into tiles of
+      // LEWENSTEIN_TILE_T values of t_i, which are processed in steps of
+      // LEWENSTEIN_TILE_TAU values of tau_i, so that the part of the arrays
+      // accessed at t_i-tau_i stays in the L1 cache while it is reused for
+      // all t_i of the tile. The cost of a tile grows with t_i until t_i
+      // reaches weight_length, so tiles are handed out dynamically starting
+      // with the most expensive ones (the ones at the end of the time axis,
+      // for all points of a block), which balances the load even for a single
+      // point. Each thread takes the tiles of its own block first, and then
+      // the remaining ones of the other blocks.
+      // t_0 has no history, except in periodic mode.
+      const int t_first = periodic ? 0 : 1;
+      const int tiles = (N-t_first + LEWENSTEIN_TILE_T-1) / LEWENSTEIN_TILE_T;
+      const int work = points*tiles;
+
+      const double time_prepared = s ? lewenstein_time() : 0;
+      int work_done = 0;
+      if (s && (int)s->thread_seconds.size()<threads) {
+        s->thread_seconds.resize(threads, 0.0);
+        s->thread_evaluations.resize(threads, 0.0);
+        s->thread_tiles.resize(threads, 0.0);
+      }
+
+      #pragma omp parallel num_threads(team) shared(output_data, work_done)
+      {
+        lewenstein_bind_thread();
+        const int thread = lewenstein_thread_num();
+        lewenstein_lanes<dim,Type> &l = *lanes[thread];
+        double busy = 0, evaluations = 0, zero_weight = 0, skipped = 0, tiles_done = 0;
+        double progress_last = time_prepared;
+        int block = thread, block_i = 0, work_i;
+
+        // sums of the tau integrals of each species and window for the t_i
+        // of a tile, and the partial sums of lewenstein_tau_sum_species
+        const int sum_stride = LEWENSTEIN_TILE_T*dim;
+        vector<Acc> sums(outputs*sum_stride);
+        vector<Acc> partial(outputs>1 ? outputs*dim*LEWENSTEIN_ACCUMULATORS : 0);
+
+        while (block_i<team) {
+          work_i = next_work(block, tiles);
+          if (work_i<0) {
+            block = (thread + ++block_i) % team;
+            continue;
+          }
+
+          const double tile_start = s ? lewenstein_time() : 0;
+          const int block_points = block_first[block+1]-block_first[block];
+          const int tile = tiles-1 - work_i/block_points;
+          const int point = block_first[block] + work_i%block_points;
+          const int t_begin = t_first + tile*LEWENSTEIN_TILE_T;
+          const int t_end = min(N, t_begin+LEWENSTEIN_TILE_T);
+
+          lewenstein_point<dim,Type> pt;
+          Type *E = soa_data + point*point_size + LEWENSTEIN_PADDING + halo;
+          for (int k=0; k<dim; k++) {
+            pt.E[k] = E + k*stride;
+            pt.A[k] = E + (dim+k)*stride;
+            pt.B[k] = E + (2*dim+k)*stride;
+          }
+          pt.C = E + 3*dim*stride;
+          pt.at = E + (3*dim+1)*stride;
+          pt.coarse = 0;
+
+          // the coarse copies start with row 0, after its padding
+          lewenstein_point<dim,Type> coarse_pt;
+          if (coarse) {
+            Type *copy = E - halo + arrays*stride;
+            for (int k=0; k<dim; k++) {
+              coarse_pt.E[k] = copy + k*stride;
+              coarse_pt.A[k] = copy + (dim+k)*stride;
+              coarse_pt.B[k] = copy + (2*dim+k)*stride;
+            }
+            coarse_pt.C = copy + 3*dim*stride;
+            coarse_pt.at = copy + (3*dim+1)*stride;
+            coarse_pt.coarse = 0;
+            pt.coarse = &coarse_pt;
+          }
+
+          // trapezoidal rule: interior points are vectorized, first and last
+          // point have only half the weight and are computed separately
+          for (int i=0; i<outputs*sum_stride; i++) sums[i] = 0;
+
+          const int node_end = interior_end(tau_end(t_end-1));
+          for (int node_begin=1; node_begin<node_end; node_begin+=LEWENSTEIN_TILE_TAU) {
+            for (int t_i=t_begin; t_i<t_end; t_i++) {
+              const int node_stop = min(interior_end(tau_end(t_i)), node_begin+LEWENSTEIN_TILE_TAU);
+              if (node_stop>node_begin && outputs==1) {
+                lewenstein_tau_sum<dim,Type,Elements,Acc>(isa, t_i, node_begin, node_stop, pt, species[0].table, *species[0].dp, l, &sums[(t_i-t_begin)*dim]);
+              }
+              else if (node_stop>node_begin) {
+                lewenstein_tau_sum_species<dim,Type,Elements,Acc>(isa, t_i, node_begin, node_stop, pt, stride, species_count, &species[0], window_count, &window_nodes[0], l, &partial[0], &sums[(t_i-t_begin)*dim], sum_stride);
+              }
+            }
+          }
+
+          for (int output_i=0; output_i<outputs; output_i++) {
+            const int species_i = output_i/window_count, window_i = output_i%window_count;
+            const lewenstein_species<Type,Elements> &sp = species[species_i];
+            lewenstein_point<dim,Type> species_pt = pt;
+            species_pt.at = pt.at + species_i*stride;
+
+            for (int t_i=t_begin; t_i<t_end; t_i++) {
+              Acc *output = output_data + species_i*output_species + window_i*output_window + point*output_layout.point + t_i*output_layout.time;
+              if (tau_end(t_i)<1) {
+                for (int k=0; k<dim; k++) output[k*output_layout.component] = 0;
+                continue;
+              }
+
+              // the first node, the node before tau_last if tau_last is not a
+              // node itself, and tau_last
+              const int tau_last = tau_end(t_i);
+              const int below = nodes_below[tau_last];
+              const Acc *sum = &sums[output_i*sum_stride + (t_i-t_begin)*dim];
+              Acc integral[dim];
+              for (int k=0; k<dim; k++) integral[k] = sum[k]*species_pt.at[t_i];
+
+              add_node(t_i, 0, -1, below>1 ? node_tau[1] : tau_last, species_pt, sp, window_i, integral);
+              if (interior_end(tau_last)<below && below>1) add_node(t_i, node_tau[below-1], node_tau[below-2], tau_last, species_pt, sp, window_i, integral);
+              add_node(t_i, tau_last, node_tau[below-1], -1, species_pt, sp, window_i, integral);
+
+              for (int k=0; k<dim; k++) output[k*output_layout.component] = (Acc)2.0 * Acc(output_layout.scale) * integral[k];
+            }
+          }
+
+          if (s) {
+            const double tile_stop = lewenstein_time();
+            busy += tile_stop - tile_start;
+            tiles_done++;
+            count_evaluations(t_begin, t_end, species_count, evaluations, zero_weight, skipped);
+
+            // throttled; only the calling thread runs the callback
+            if (s->progress) {
+              int done;
+              #pragma omp critical(lewenstein_progress)
+              done = ++work_done;
+              if (thread==0 && tile_stop-progress_last>=s->progress_interval) {
+                progress_last = tile_stop;
+                s->progress(double(done)/work, s->progress_user);
+              }
+            }
+          }
+        }
+
+        if (s) {
+          s->thread_seconds[thread] += busy;
+          s->thread_evaluations[thread] += evaluations;
+          s->thread_tiles[thread] += tiles_done;
+          #pragma omp critical(lewenstein_stats)
+          {
+            s->evaluations += evaluations;
+            s->zero_weight_evaluations += zero_weight;
+            s->skipped_evaluations += skipped;
+          }
+        }
+      }
+
+      if (!periodic) {
+        for (int output_i=0; output_i<outputs; output_i++) {
+          Acc *output = output_data + (output_i/window_count)*output_species + (output_i%window_count)*output_window;
+          for (point_i=0; point_i<points; point_i++) {
+            for (int k=0; k<dim; k++) output[point_i*output_layout.point + k*output_layout.component] = 0;
+          }
+        }
+      }
+
+      if (s) {
+        const double time_stop = lewenstein_time();
+        s->calls++;
+        s->points += points;
+        s->prepare_seconds += time_prepared - time_start;
+        s->tau_seconds += time_stop - time_prepared;
+        s->total_seconds += time_stop - time_start;
+        if (s->progress) s->progress(1.0, s->progress_user);
+      }
+
+      return 0; // might be replaced by error code later, e.g. for failed interpolation
+    };
+};
+
+// calculates dipole responses for a batch of driving fields sharing the same
+// time axis, weights and dipole elements; see lewenstein_plan::execute for the
+// layout of the arrays
+template <int dim, typename Type, class Elements>
+int lewenstein_batch(const int points, const int N, Type *t, Type *Et_data, int weight_length, Type *weights, Type *at_data, int at_stride, Type Ip, Type epsilon_t, const Elements &dp, Type *output_data) {
+  lewenstein_plan<dim,Type,Elements> plan(N, t, weight_length, weights, Ip, epsilon_t, dp);
+  return plan.execute(points, Et_data, at_data, at_stride, output_data);
+};
+
+// calculates dipole response
+template <int dim, typename Type, class Elements>
+int lewenstein(const int N, Type *t, Type *Et_data, int weight_length, Type *weights, Type *at, Type Ip, Type epsilon_t, const Elements &dp, Type *output_data) {
+  return lewenstein_batch<dim,Type,Elements>(1, N, t, Et_data, weight_length, weights, at, N, Ip, epsilon_t, dp, output_data);
+};
+
+// number of regula falsi steps refining the ionization time in yakovlev()
+#ifndef YAKOVLEV_REFINE_STEPS
+  #define YAKOVLEV_REFINE_STEPS 3
+#endif
+
+// stationarity condition of yakovlev() at the excursion time interpolated
+// linearly between two grid points (frac=0 and frac=1): returns g.E(t-tau) and
+// sets tau, g and E to the interpolated values
+template <int dim, typename Type>
+inline Type yakovlev_condition(Type frac, const Type *tau_grid, const vec<dim,Type> *A_grid, const vec<dim,Type> *B_grid, const vec<dim,Type> *E_grid, const vec<dim,Type> &B_return, Type &tau, vec<dim,Type> &g, vec<dim,Type> &E) {
+  tau = tau_grid[0] + (tau_grid[1]-tau_grid[0])*frac;
+  E = E_grid[0] + (E_grid[1]-E_grid[0])*frac;
+  g = (A_grid[0] + (A_grid[1]-A_grid[0])*frac)*tau + B_grid[0] + (B_grid[1]-B_grid[0])*frac - B_return;
+  return g*E;
+};
+
+// (2*pi)^1.5 * sqrt(sqrt(2*Ip))/|E| / tau^1.5 * exp(-iS) of yakovlev(), with
+// the factor before tau passed as factor
+template <int accuracy, typename Type>
+inline complex<Type> yakovlev_propagator(Type tau, Type Sst, Type factor) {
+  Type s, c, r = simd_rsqrt<accuracy>(tau);
+  simd_sincos_accuracy<accuracy>(Sst, s, c);
+  return factor*r*r*r * complex<Type>(c, -s);
 };
 
 // calculates dipole response in saddle point approximation applied to tau:
 //   Yakovlev, Ivanov, and Krausz, "Enhanced Phase-Matching for Generation of Soft X-Ray Harmonics and Attosecond Pulses in Atomic Gases."
+// For each recombination time t, the excursion times tau are the roots of the
+// vector stationarity condition g(tau).E(t-tau) = 0, where
+//   g(tau) = A(t-tau)*tau + B(t-tau) - B(t)
+// is the position at time t of an electron born at rest at time t-tau, at
+// which |g| is minimal (d|g|^2/dtau = 2*tau*g.E(t-tau)). For linear
+// polarization, these are the returns g=0. For elliptical or two-color fields,
+// the electron must be born with the lateral velocity v=g/tau to return, which
+// suppresses the ionization amplitude by exp(-sqrt(2*Ip)*v^2/(2*|E|)). The
+// roots are refined between the grid points by regula falsi on the linearly
+// interpolated fields. The propagation factor is computed with the given
+// accuracy tier (see simd_accuracy).
 template <int dim, typename Type>
-int yakovlev(const int N, Type *t, Type *Et_data, int weight_length, Type *weights, int min_tau_i, Type *dtfraction, Type *at, Type Ip, Type *output_data) {
+int yakovlev(const int N, Type *t, Type *Et_data, int weight_length, Type *weights, int min_tau_i, Type *dtfraction, Type *at, Type Ip, Type *output_data, simd_accuracy accuracy=SIMD_ACCURACY_EXACT) {
   typedef complex<Type> cType;
   typedef vec<dim,Type> rvec;
   typedef vec<dim,cType> cvec;
   typedef vec_array<dim,Type> rvec_array;
 
-  int t_i, tau_i;
+  int t_i;
   Type pi = 4.0*atan(1.0);
-  cType i = cType(Type(0), Type(1));
   cType isqrtneg = cType(Type(1/sqrt(2)), -Type(1/sqrt(2)));
+  const Type propagation = pow(2*pi,1.5) * sqrt(sqrt(2*Ip));
 
   // initialize Et, At, Bt, Ct, output
   rvec_array Et(Et_data);
@@ -197,67 +1911,85 @@ int yakovlev(const int N, Type *t, Type *Et_data, int weight_length, Type *weigh
   Type *Ct = new Type[N];
   rvec_array output(output_data);
 
-  rvec IAt(0);
-  rvec IBt(0);
-  Type ICt = Type(0);
-
-  At[0] = IAt;
-  Bt[0] = IBt;
-  Ct[0] = ICt;
+  lewenstein_prepare<dim,Type>(N, t, Et_data, At_data, Bt_data, Ct);
 
+  // the work per t_i grows until t_i reaches weight_length, so iterations are
+  // distributed dynamically
+  #pragma omp parallel for schedule(dynamic,16) num_threads(lewenstein_get_threads()) shared(t, Et, At, Bt, Ct, pi, isqrtneg, propagation, accuracy, dtfraction, at, Ip, weights, weight_length, min_tau_i, output)
   for (t_i=1; t_i<N; t_i++) {
-    Type dt = t[t_i]-t[t_i-1];
-
-    IAt -= (Et[t_i-1]+Et[t_i]) * (dt/2);
-    At[t_i] = IAt;
+    lewenstein_bind_thread();
+    rvec d(0);
 
-    IBt += (At[t_i-1]+At[t_i]) * (dt/2);
-    Bt[t_i] = IBt;
+    int inde = weight_length+min_tau_i;
+    if (t_i<inde) inde = t_i+1;
 
-    ICt += (SQR(At[t_i-1]) + SQR(At[t_i])) * dt/2;
-    Ct[t_i] = ICt;
-  }
+    // the trivial root g(0)=0 is skipped by accepting minima only after |g|
+    // has increased
+    const int first = max(min_tau_i,1);
+    bool left_origin = first>1;
+    Type h_before = 0;
+    for (int tau_i=first; tau_i<inde; tau_i++) {
+      // look for a sign change of g.E from negative to positive, i.e. for a
+      // minimum of the distance |g| between t[tau_i-1] and t[tau_i]
+      const int ion_i = t_i-tau_i;
+      Type h = (At[ion_i]*t[tau_i] + Bt[ion_i] - Bt[t_i])*Et[ion_i];
+      Type h_low = h_before;
+      h_before = h;
+      bool minimum = left_origin && h_low<0 && h>=0;
+      if (h>0) left_origin = true;
+      if (!minimum) continue;
 
-  Type Sst, dt, a_ion;
-  cType a_pr;
-  int inde;
-  rvec reference_B;
-  rvec reference_sign;
-  rvec line_at_t, delta_At;
-  cvec a_rec;
+      // refine the root, frac=0 and frac=1 corresponding to tau_i-1 and tau_i
+      Type tau_grid[2] = {t[tau_i-1], t[tau_i]};
+      rvec A_grid[2] = {At[ion_i+1], At[ion_i]};
+      rvec B_grid[2] = {Bt[ion_i+1], Bt[ion_i]};
+      rvec E_grid[2] = {Et[ion_i+1], Et[ion_i]};
 
-  #pragma omp parallel for private(tau_i, inde, Sst, dt, reference_B, reference_sign, line_at_t, a_rec,a_ion,a_pr,delta_At) shared(t, Et, At, Bt, Ct, i, pi, isqrtneg, dtfraction, at, Ip, weights, weight_length, min_tau_i, output)
-  for (t_i=1; t_i<N; t_i++) {
-    output[t_i] = 0;
+      Type tau, frac = 0, frac_low = 0, frac_high = 1, h_high = h;
+      rvec g, E;
+      for (int step=0; step<YAKOVLEV_REFINE_STEPS; step++) {
+        frac = (frac_low*h_high - frac_high*h_low) / (h_high-h_low);
+        Type h_frac = yakovlev_condition<dim,Type>(frac, tau_grid, A_grid, B_grid, E_grid, Bt[t_i], tau, g, E);
+        if (h_frac<0) {
+          frac_low = frac;
+          h_low = h_frac;
+        }
+        else {
+          frac_high = frac;
+          h_high = h_frac;
+        }
+      }
+      frac = (frac_low*h_high - frac_high*h_low) / (h_high-h_low);
+      yakovlev_condition<dim,Type>(frac, tau_grid, A_grid, B_grid, E_grid, Bt[t_i], tau, g, E);
 
-    reference_B = Bt[t_i];
-    reference_sign = Et[t_i];
+      Type Eabs = abs(E);
+      if (!(Eabs>0)) continue;
 
-    inde = weight_length+min_tau_i;
-    if (t_i<inde) inde = t_i+1;
-    for (tau_i=max(min_tau_i,1); tau_i<inde; tau_i++) {
-      // check if we found an intersection of the line A(t-tau)*(t-tau)+B(t-tau) with B(t); if not keep searching
-      line_at_t = At[t_i-tau_i]*t[tau_i] + Bt[t_i-tau_i];
-      if ((line_at_t-reference_B)*reference_sign>0) {
-        continue;
-      }
+      // compute auxiliary terms at the interpolated ionization time
+      rvec A_ion = A_grid[0] + (A_grid[1]-A_grid[0])*frac;
+      rvec B_ion = B_grid[0] + (B_grid[1]-B_grid[0])*frac;
+      Type C_ion = Ct[ion_i+1] + (Ct[ion_i]-Ct[ion_i+1])*frac;
+      Type weight = weights[tau_i-1-min_tau_i] + (weights[tau_i-min_tau_i]-weights[tau_i-1-min_tau_i])*frac;
+      Type rate = dtfraction[ion_i+1] + (dtfraction[ion_i]-dtfraction[ion_i+1])*frac;
 
-      // compute auxiliary terms
-      dt = t[t_i-tau_i+1] - t[t_i-tau_i];
-      Sst = Ip * t[tau_i] - .5/t[tau_i]*SQR(Bt[t_i]-Bt[t_i-tau_i]) + .5*(Ct[t_i]-Ct[t_i-tau_i]);
-      delta_At = At[t_i-tau_i] - At[t_i];
+      Type Sst = Ip * tau - .5/tau*SQR(Bt[t_i]-B_ion) + .5*(Ct[t_i]-C_ion);
+      rvec delta_At = A_ion - At[t_i];
+      rvec v = g/tau;
 
       // compute probability amplitudes
-      a_ion = sqrt( dtfraction[t_i-tau_i] );
-      a_pr = pow(2*pi,1.5) / t[tau_i] / sqrt(t[tau_i]) * sqrt(sqrt(2*Ip))/abs(Et[t_i-tau_i]) * cType( cos(Sst), -sin(Sst) );
+      Type a_ion = sqrt(rate) * exp(-sqrt(2*Ip)*SQR(v)/(2*Eabs));
+      cType a_pr;
+      if (accuracy==SIMD_ACCURACY_EXACT) a_pr = pow(2*pi,1.5) / tau / sqrt(tau) * sqrt(sqrt(2*Ip))/Eabs * cType( cos(Sst), -sin(Sst) );
+      else if (accuracy==SIMD_ACCURACY_HIGH) a_pr = yakovlev_propagator<SIMD_ACCURACY_HIGH,Type>(tau, Sst, propagation/Eabs);
+      else a_pr = yakovlev_propagator<SIMD_ACCURACY_FAST,Type>(tau, Sst, propagation/Eabs);
 //      a_rec = sqrt(1-SQR(at[t_i])) / pow(2*Ip + SQR(delta_At), 3) * delta_At; // as in reference, but probably wrong
-      a_rec = at[t_i] / pow(2*Ip + SQR(delta_At), 3) * delta_At;
+      cvec a_rec = at[t_i] / pow(2*Ip + SQR(delta_At), 3) * delta_At;
 
       // add to dipole response
-      output[t_i] += real(isqrtneg * weights[tau_i-min_tau_i] * a_ion * a_pr * a_rec);
-
-      reference_sign = line_at_t-reference_B;
+      d += real(isqrtneg * weight * a_ion * a_pr * a_rec);
     }
+
+    output[t_i] = d;
   }
 
   output[0] = 0;
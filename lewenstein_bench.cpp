@@ -0,0 +1,388 @@
+/*
+
+Benchmark of the native kernels of lewenstein.hpp, to compare machines and
+compilers and to catch performance regressions. For each combination of the
+length N of the time axis, the length of the weights, the number of field
+components, the dipole elements ('H', 'symmetric_interpolate', 'tabulated'),
+the method ('lewenstein' or 'yakovlev') and the number of threads, the dipole
+responses of a batch of points are computed. The batch is the same for all
+thread counts, so that the efficiency measures strong scaling.
+
+Usage:
+  ./lewenstein_bench [--quick] [--threads 1,2,4] [--min-time seconds]
+                     [--revision name] [--output file]
+
+  --quick - only N=1000 with short weights, for a fast check
+  --threads - thread counts to sweep; defaults to 1, 2, 4, ... up to the
+              number of processors
+  --min-time - each combination is repeated for at least this many seconds
+               (default 0.5), and the best repetition is reported
+  --revision - name of the measured version, e.g. the git commit
+  --output - file to append the results to (with a header line if the file is
+             new), so that the results of several versions can be collected;
+             by default they are written to stdout
+
+Output: one tab-separated line per combination with the columns
+  revision, compiler, isa - --revision, compiler version and vector
+                            instruction set used by the kernel
+  method, dipole, dim, N, weights, threads, points - the combination
+  seconds - wall time for all points
+  points_per_s - points per second
+  ns_per_eval - core time (wall time x threads) per evaluation of the
+                integrand, i.e. per pair (t_i, tau_i), in nanoseconds; for
+                'yakovlev', per sample of the time axis
+  efficiency - strong scaling efficiency relative to the smallest thread count
+  io_GBps - bandwidth of reading the driving fields and writing the dipole
+            responses
+  triad_GBps - memory bandwidth of the machine with the same number of threads
+               (STREAM triad), for comparison
+A readable summary is printed to stderr.
+
+Compilation for Linux:
+  # g++ -o lewenstein_bench lewenstein_bench.cpp -fopenmp -O3 -ansi
+or `make bench`, which also runs it and appends the results to bench.tsv.
+
+*/
+
+#include "lewenstein.hpp"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __VERSION__
+  #define BENCH_COMPILER __VERSION__
+#else
+  #define BENCH_COMPILER "unknown"
+#endif
+
+// samples per period of the driving field (2*pi in scaled atomic units)
+#define BENCH_SAMPLES_PER_PERIOD 100
+
+// length of the arrays of the triad measurement
+#define BENCH_TRIAD_LENGTH (1<<23)
+
+struct bench_settings {
+  vector<int> threads;
+  double min_time;
+  string revision, output;
+  bool quick;
+};
+
+// one combination to be measured
+struct bench_case {
+  string method, dipole;
+  int dim, N, weights;
+};
+
+inline double bench_time() {
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+inline void bench_set_threads(int threads) {
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+inline int bench_max_threads() {
+#ifdef _OPENMP
+  return omp_get_num_procs();
+#else
+  return 1;
+#endif
+}
+
+// repeats run() for at least min_time seconds (and at least twice, after one
+// warm-up call); returns the time of the fastest call
+template <class Runner>
+double bench_measure(Runner &run, double min_time) {
+  run();
+
+  double best = 0, total = 0;
+  for (int repetition=0; repetition<2 || total<min_time; repetition++) {
+    double start = bench_time();
+    run();
+    double seconds = bench_time() - start;
+
+    total += seconds;
+    if (repetition==0 || seconds<best) best = seconds;
+  }
+  return best;
+}
+
+// STREAM triad a = b + s*c
+struct bench_triad {
+  vector<double> a, b, c;
+
+  bench_triad() : a(BENCH_TRIAD_LENGTH, 0.0), b(BENCH_TRIAD_LENGTH, 1.0), c(BENCH_TRIAD_LENGTH, 2.0) {};
+
+  void operator()() {
+    double *pa = &a[0], *pb = &b[0], *pc = &c[0];
+    int i;
+    #pragma omp parallel for
+    for (i=0; i<BENCH_TRIAD_LENGTH; i++) pa[i] = pb[i] + 3.0*pc[i];
+  };
+};
+
+// driving fields (points x N x dim) of pulses with elliptical components and
+// slightly different amplitudes, weights with a soft end, and dipole elements
+// of the hydrogen-like potential sampled on a p axis
+struct bench_data {
+  int N, dim, points;
+  double ip;
+  vector<double> t, Et, weights, output, dtfraction, at;
+  vector<double> p_real, p_imag;
+  double deltap;
+
+  bench_data(int N_, int dim_, int points_, int weights_length) : N(N_), dim(dim_), points(points_), ip(0.9), t(N), Et(points*N*dim), weights(weights_length), output(points*N*dim), dtfraction(N, 0.0), at(N, 1.0) {
+    const double pi = 4.0*atan(1.0);
+    const double dt = 2*pi / BENCH_SAMPLES_PER_PERIOD;
+
+    for (int t_i=0; t_i<N; t_i++) t[t_i] = t_i*dt;
+    for (int point=0; point<points; point++) {
+      const double amplitude = 0.6 * (1 - 0.1*point/points);
+      for (int t_i=0; t_i<N; t_i++) {
+        const double envelope = amplitude * SQR(sin(pi*t_i/(N-1)));
+        for (int k=0; k<dim; k++) {
+          Et[(point*N + t_i)*dim + k] = envelope * (k==0 ? cos(t[t_i]) : 0.3/k * sin(t[t_i] + k));
+        }
+      }
+    }
+
+    const int soft = weights_length/2;
+    for (int tau_i=0; tau_i<weights_length; tau_i++) {
+      weights[tau_i] = tau_i<soft ? 1 : SQR(cos(pi/2 * (tau_i-soft) / (weights_length-soft)));
+    }
+
+    // |p| up to 10 scaled atomic units
+    const double alpha = 2*ip;
+    const int p_length = 10000;
+    deltap = 1.0e-3;
+    p_real.resize(p_length);
+    p_imag.resize(p_length);
+    for (int i=0; i<p_length; i++) {
+      const double p = i*deltap;
+      p_real[i] = 0;
+      p_imag[i] = pow(2, 3.5) * pow(alpha, 1.25) / pi * p / pow(SQR(p) + alpha, 3);
+    }
+  };
+};
+
+template <int dim, class Elements>
+struct bench_lewenstein_runner {
+  bench_data &data;
+  lewenstein_plan<dim,double,Elements> plan;
+
+  bench_lewenstein_runner(bench_data &d, const Elements &dp) : data(d), plan(d.N, &d.t[0], (int)d.weights.size(), &d.weights[0], d.ip, 1.0e-4, dp) {};
+
+  void operator()() {
+    plan.execute(data.points, &data.Et[0], 0, 0, &data.output[0]);
+  };
+};
+
+template <int dim>
+struct bench_yakovlev_runner {
+  bench_data &data;
+
+  bench_yakovlev_runner(bench_data &d) : data(d) {};
+
+  // yakovlev() is parallelized over the time axis
+  void operator()() {
+    for (int point=0; point<data.points; point++) {
+      yakovlev<dim,double>(data.N, &data.t[0], &data.Et[point*data.N*dim], (int)data.weights.size(), &data.weights[0], 0, &data.dtfraction[0], &data.at[0], data.ip, &data.output[point*data.N*dim]);
+    }
+  };
+};
+
+template <int dim>
+double bench_run_dim(const bench_case &c, bench_data &data, double min_time) {
+  if (c.method=="yakovlev") {
+    bench_yakovlev_runner<dim> run(data);
+    return bench_measure(run, min_time);
+  }
+
+  if (c.dipole=="H") {
+    dipole_elements_H<dim,double> dp(2*data.ip);
+    bench_lewenstein_runner<dim,dipole_elements_H<dim,double> > run(data, dp);
+    return bench_measure(run, min_time);
+  }
+
+  const int p_length = (int)data.p_real.size();
+  if (c.dipole=="symmetric_interpolate") {
+    dipole_elements_symmetric_interpolate<dim,double> dp(p_length, data.deltap, &data.p_real[0], &data.p_imag[0]);
+    bench_lewenstein_runner<dim,dipole_elements_symmetric_interpolate<dim,double> > run(data, dp);
+    return bench_measure(run, min_time);
+  }
+
+  const int table_length = 4*p_length;
+  vector<double> g_real(table_length), g_imag(table_length);
+  double ds = dipole_elements_tabulate_radial(p_length, data.deltap, &data.p_real[0], &data.p_imag[0], table_length, &g_real[0], &g_imag[0]);
+  dipole_elements_tabulated<dim,double> dp(table_length, ds, &g_real[0], &g_imag[0]);
+  bench_lewenstein_runner<dim,dipole_elements_tabulated<dim,double> > run(data, dp);
+  return bench_measure(run, min_time);
+}
+
+// wall time for all points of the combination
+double bench_run(const bench_case &c, int points, double min_time) {
+  bench_data data(c.N, c.dim, points, c.weights);
+
+  if (c.dim==1) return bench_run_dim<1>(c, data, min_time);
+  if (c.dim==2) return bench_run_dim<2>(c, data, min_time);
+  return bench_run_dim<3>(c, data, min_time);
+}
+
+// number of integrand evaluations per point, see lewenstein_plan::tau_end
+double bench_evaluations(const bench_case &c) {
+  if (c.method=="yakovlev") return c.N;
+
+  double evaluations = 0;
+  for (int t_i=0; t_i<c.N; t_i++) evaluations += min(c.weights, t_i+1) - 1;
+  return evaluations;
+}
+
+vector<bench_case> bench_cases(bool quick) {
+  vector<int> lengths;
+  lengths.push_back(1000);
+  if (!quick) lengths.push_back(4000);
+
+  const char *dipoles[] = {"H", "symmetric_interpolate", "tabulated"};
+
+  vector<bench_case> cases;
+  for (size_t length_i=0; length_i<lengths.size(); length_i++) {
+    const int N = lengths[length_i];
+    for (int long_weights=0; long_weights<=(quick ? 0 : 1); long_weights++) {
+      for (int dim=1; dim<=3; dim++) {
+        bench_case c;
+        c.N = N;
+        c.weights = long_weights ? N : N/4;
+        c.dim = dim;
+
+        c.method = "lewenstein";
+        for (int dipole_i=0; dipole_i<3; dipole_i++) {
+          c.dipole = dipoles[dipole_i];
+          cases.push_back(c);
+        }
+
+        c.method = "yakovlev";
+        c.dipole = "H";
+        cases.push_back(c);
+      }
+    }
+  }
+  return cases;
+}
+
+bool bench_parse(int argc, char **argv, bench_settings &settings) {
+  settings.min_time = 0.5;
+  settings.quick = false;
+
+  for (int i=1; i<argc; i++) {
+    string arg = argv[i];
+    if (arg=="--quick") {
+      settings.quick = true;
+    }
+    else if (i+1<argc && arg=="--threads") {
+      string list = argv[++i];
+      for (char *token=strtok(&list[0], ","); token; token=strtok(0, ",")) {
+        int threads = atoi(token);
+        if (threads<1) return false;
+        settings.threads.push_back(threads);
+      }
+    }
+    else if (i+1<argc && arg=="--min-time") {
+      settings.min_time = atof(argv[++i]);
+    }
+    else if (i+1<argc && arg=="--revision") {
+      settings.revision = argv[++i];
+    }
+    else if (i+1<argc && arg=="--output") {
+      settings.output = argv[++i];
+    }
+    else {
+      return false;
+    }
+  }
+
+  if (settings.threads.empty()) {
+    const int max_threads = bench_max_threads();
+    for (int threads=1; threads<max_threads; threads*=2) settings.threads.push_back(threads);
+    settings.threads.push_back(max_threads);
+  }
+  if (settings.revision.empty()) settings.revision = "-";
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bench_settings settings;
+  if (!bench_parse(argc, argv, settings)) {
+    fprintf(stderr, "usage: %s [--quick] [--threads 1,2,4] [--min-time seconds] [--revision name] [--output file]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *out = stdout;
+  if (!settings.output.empty()) {
+    out = fopen(settings.output.c_str(), "a");
+    if (!out) {
+      fprintf(stderr, "error: cannot open %s\n", settings.output.c_str());
+      return 1;
+    }
+  }
+  fseek(out, 0, SEEK_END);
+  if (ftell(out)<=0) {
+    fprintf(out, "revision\tcompiler\tisa\tmethod\tdipole\tdim\tN\tweights\tthreads\tpoints\tseconds\tpoints_per_s\tns_per_eval\tefficiency\tio_GBps\ttriad_GBps\n");
+  }
+
+  const char *isa_names[] = {"generic", "avx2", "avx512"};
+  const char *isa = isa_names[simd_detect()];
+
+  // the same batch for all thread counts, with some points per thread
+  const int max_threads = *max_element(settings.threads.begin(), settings.threads.end());
+  const int points = 4*max_threads;
+
+  // memory bandwidth for each thread count
+  vector<double> triad(settings.threads.size());
+  {
+    bench_triad run;
+    for (size_t i=0; i<settings.threads.size(); i++) {
+      bench_set_threads(settings.threads[i]);
+      triad[i] = 3.0*sizeof(double)*BENCH_TRIAD_LENGTH / bench_measure(run, 0.1) / 1.0e9;
+    }
+  }
+
+  const vector<bench_case> cases = bench_cases(settings.quick);
+  for (size_t case_i=0; case_i<cases.size(); case_i++) {
+    const bench_case &c = cases[case_i];
+    double reference = 0;
+
+    for (size_t i=0; i<settings.threads.size(); i++) {
+      const int threads = settings.threads[i];
+      bench_set_threads(threads);
+
+      // plans allocate their buffers for the current number of threads
+      const double seconds = bench_run(c, points, settings.min_time);
+      const double core_seconds = seconds*threads;
+      if (i==0) reference = core_seconds;
+
+      const double points_per_s = points / seconds;
+      const double ns_per_eval = core_seconds / (points*bench_evaluations(c)) * 1.0e9;
+      const double efficiency = reference / core_seconds;
+      const double io_GBps = 2.0*sizeof(double)*c.dim*c.N*points / seconds / 1.0e9;
+
+      fprintf(out, "%s\t%s\t%s\t%s\t%s\t%d\t%d\t%d\t%d\t%d\t%.6g\t%.6g\t%.6g\t%.4f\t%.4g\t%.4g\n", settings.revision.c_str(), BENCH_COMPILER, isa, c.method.c_str(), c.dipole.c_str(), c.dim, c.N, c.weights, threads, points, seconds, points_per_s, ns_per_eval, efficiency, io_GBps, triad[i]);
+      fflush(out);
+
+      fprintf(stderr, "%-10s %-21s dim=%d N=%-5d weights=%-5d threads=%-3d %10.4g points/s %8.3g ns/eval  efficiency %.2f\n", c.method.c_str(), c.dipole.c_str(), c.dim, c.N, c.weights, threads, points_per_s, ns_per_eval, efficiency);
+    }
+  }
+
+  if (out!=stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,451 @@
+// This file provides reading and writing of Matlab .mat files, so that native
+// programs can exchange data with the Matlab/Octave code without needing
+// Matlab's libraries.
+// Supported are Level 4 files and uncompressed Level 5 files (as written by
+// `save -v4` and `save -v6` in Matlab, or `save -v4` and `save -mat` in
+// Octave) in little endian byte order, containing numeric arrays (converted
+// to double), char arrays and structs. Compressed files (the default of
+// Matlab's save) are not supported, as this would require zlib.
+// Files are always written in Level 5 format.
+
+// include guard
+#ifndef MATFILE_HPP
+#define MATFILE_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// a variable of a .mat file; numeric data is stored in column-major order
+struct matfile_value {
+  enum value_kind { NUMERIC, CHAR, STRUCT };
+
+  value_kind kind;
+  vector<int> dims;
+  vector<double> real;
+  vector<double> imag;      // empty for real arrays
+  string text;              // for char arrays
+  vector<string> field_names;
+  vector<matfile_value> fields;
+
+  matfile_value() : kind(NUMERIC) {};
+
+  int numel() const {
+    int n = 1;
+    for (size_t i=0; i<dims.size(); i++) n *= dims[i];
+    return n;
+  };
+
+  // returns the struct field with the given name, or 0
+  const matfile_value *field(const string &name) const {
+    for (size_t i=0; i<field_names.size(); i++) {
+      if (field_names[i]==name) return &fields[i];
+    }
+    return 0;
+  };
+
+  static matfile_value scalar(double value) {
+    matfile_value v;
+    v.dims.push_back(1);
+    v.dims.push_back(1);
+    v.real.push_back(value);
+    return v;
+  };
+
+  // row vector (1 x n)
+  static matfile_value row(const vector<double> &values) {
+    matfile_value v;
+    v.dims.push_back(1);
+    v.dims.push_back((int)values.size());
+    v.real = values;
+    return v;
+  };
+
+  static matfile_value string_value(const string &s) {
+    matfile_value v;
+    v.kind = CHAR;
+    v.dims.push_back(s.empty() ? 0 : 1);
+    v.dims.push_back((int)s.size());
+    v.text = s;
+    return v;
+  };
+
+  static matfile_value struct_value() {
+    matfile_value v;
+    v.kind = STRUCT;
+    v.dims.push_back(1);
+    v.dims.push_back(1);
+    return v;
+  };
+};
+
+// data types of Level 5 files
+enum matfile_type {
+  MI_INT8=1, MI_UINT8=2, MI_INT16=3, MI_UINT16=4, MI_INT32=5, MI_UINT32=6,
+  MI_SINGLE=7, MI_DOUBLE=9, MI_INT64=12, MI_UINT64=13, MI_MATRIX=14,
+  MI_COMPRESSED=15, MI_UTF8=16, MI_UTF16=17, MI_UTF32=18
+};
+
+// array classes of Level 5 files
+enum matfile_class {
+  MX_CELL_CLASS=1, MX_STRUCT_CLASS=2, MX_OBJECT_CLASS=3, MX_CHAR_CLASS=4,
+  MX_SPARSE_CLASS=5, MX_DOUBLE_CLASS=6
+};
+
+class matfile_reader {
+  private:
+    vector<unsigned char> buffer;
+    string error;
+
+    // converts n numbers of the given type to double
+    bool convert(int type, const unsigned char *data, int bytes, vector<double> &out) {
+      int size;
+      switch (type) {
+        case MI_INT8: case MI_UINT8: case MI_UTF8: size = 1; break;
+        case MI_INT16: case MI_UINT16: case MI_UTF16: size = 2; break;
+        case MI_INT32: case MI_UINT32: case MI_SINGLE: case MI_UTF32: size = 4; break;
+        case MI_DOUBLE: case MI_INT64: case MI_UINT64: size = 8; break;
+        default:
+          error = "unsupported data type";
+          return false;
+      }
+
+      int n = bytes/size;
+      out.resize(n);
+      for (int i=0; i<n; i++) {
+        const unsigned char *p = data + i*size;
+        switch (type) {
+          case MI_INT8: out[i] = *(const signed char *)p; break;
+          case MI_UINT8: case MI_UTF8: out[i] = *p; break;
+          case MI_INT16: { short v; memcpy(&v,p,2); out[i] = v; break; }
+          case MI_UINT16: case MI_UTF16: { unsigned short v; memcpy(&v,p,2); out[i] = v; break; }
+          case MI_INT32: { int v; memcpy(&v,p,4); out[i] = v; break; }
+          case MI_UINT32: case MI_UTF32: { unsigned int v; memcpy(&v,p,4); out[i] = v; break; }
+          case MI_SINGLE: { float v; memcpy(&v,p,4); out[i] = v; break; }
+          case MI_DOUBLE: { double v; memcpy(&v,p,8); out[i] = v; break; }
+          case MI_INT64: { long long v; memcpy(&v,p,8); out[i] = (double)v; break; }
+          case MI_UINT64: { unsigned long long v; memcpy(&v,p,8); out[i] = (double)v; break; }
+        }
+      }
+      return true;
+    }
+
+    // reads the tag of a data element at pos; handles the small data element
+    // format, in which the data is stored within the tag
+    bool read_tag(size_t pos, size_t end, int &type, int &bytes, size_t &data, size_t &next) {
+      if (pos+8>end) {
+        error = "unexpected end of file";
+        return false;
+      }
+
+      unsigned int first, second;
+      memcpy(&first, &buffer[pos], 4);
+      memcpy(&second, &buffer[pos+4], 4);
+
+      if (first>>16) {
+        type = first & 0xffff;
+        bytes = first >> 16;
+        data = pos+4;
+        next = pos+8;
+      }
+      else {
+        type = first;
+        bytes = second;
+        data = pos+8;
+        next = data + (bytes+7)/8*8;
+      }
+
+      if (data+bytes>end) {
+        error = "unexpected end of file";
+        return false;
+      }
+      return true;
+    }
+
+    // parses the contents of an miMATRIX element
+    bool parse_matrix(size_t pos, size_t end, string &name, matfile_value &value) {
+      int type, bytes;
+      size_t data, next;
+
+      // array flags
+      if (!read_tag(pos, end, type, bytes, data, next)) return false;
+      unsigned int flags;
+      memcpy(&flags, &buffer[data], 4);
+      int array_class = flags & 0xff;
+      bool complex_flag = (flags & 0x800)!=0;
+      pos = next;
+
+      // dimensions
+      if (!read_tag(pos, end, type, bytes, data, next)) return false;
+      vector<double> dims;
+      if (!convert(type, &buffer[data], bytes, dims)) return false;
+      value.dims.assign(dims.begin(), dims.end());
+      pos = next;
+
+      // name
+      if (!read_tag(pos, end, type, bytes, data, next)) return false;
+      name = string((const char *)&buffer[data], bytes);
+      pos = next;
+
+      if (array_class==MX_STRUCT_CLASS) {
+        value.kind = matfile_value::STRUCT;
+        if (value.numel()!=1) {
+          error = "struct arrays are not supported";
+          return false;
+        }
+
+        if (!read_tag(pos, end, type, bytes, data, next)) return false;
+        int field_name_length;
+        memcpy(&field_name_length, &buffer[data], 4);
+        pos = next;
+
+        if (!read_tag(pos, end, type, bytes, data, next)) return false;
+        for (int i=0; i+field_name_length<=bytes; i+=field_name_length) {
+          value.field_names.push_back(string((const char *)&buffer[data+i]));
+        }
+        pos = next;
+
+        value.fields.resize(value.field_names.size());
+        for (size_t i=0; i<value.field_names.size(); i++) {
+          if (!read_tag(pos, end, type, bytes, data, next)) return false;
+          if (type!=MI_MATRIX) {
+            error = "invalid struct field";
+            return false;
+          }
+          string field_name;
+          if (bytes && !parse_matrix(data, data+bytes, field_name, value.fields[i])) return false;
+          if (!bytes) value.fields[i].dims.assign(2, 0);
+          pos = next;
+        }
+        return true;
+      }
+
+      if (array_class==MX_CELL_CLASS || array_class==MX_OBJECT_CLASS || array_class==MX_SPARSE_CLASS) {
+        error = "cell arrays, objects and sparse arrays are not supported";
+        return false;
+      }
+
+      // numeric or char data
+      if (!read_tag(pos, end, type, bytes, data, next)) return false;
+      if (!convert(type, &buffer[data], bytes, value.real)) return false;
+      pos = next;
+
+      if (complex_flag) {
+        if (!read_tag(pos, end, type, bytes, data, next)) return false;
+        if (!convert(type, &buffer[data], bytes, value.imag)) return false;
+      }
+
+      if (array_class==MX_CHAR_CLASS) {
+        value.kind = matfile_value::CHAR;
+        value.text.resize(value.real.size());
+        for (size_t i=0; i<value.real.size(); i++) value.text[i] = (char)value.real[i];
+        value.real.clear();
+      }
+
+      return true;
+    }
+
+    bool parse_level5(vector<string> &names, vector<matfile_value> &values) {
+      if (buffer[126]!='I' || buffer[127]!='M') {
+        error = "big endian files are not supported";
+        return false;
+      }
+
+      size_t pos = 128;
+      while (pos<buffer.size()) {
+        int type, bytes;
+        size_t data, next;
+        if (!read_tag(pos, buffer.size(), type, bytes, data, next)) return false;
+
+        if (type==MI_COMPRESSED) {
+          error = "compressed files are not supported, save with -v6 (Matlab) or -mat (Octave)";
+          return false;
+        }
+        if (type==MI_MATRIX) {
+          string name;
+          matfile_value value;
+          if (!parse_matrix(data, data+bytes, name, value)) return false;
+          names.push_back(name);
+          values.push_back(value);
+        }
+
+        pos = next;
+      }
+      return true;
+    }
+
+    bool parse_level4(vector<string> &names, vector<matfile_value> &values) {
+      size_t pos = 0;
+      while (pos+20<=buffer.size()) {
+        int header[5];
+        memcpy(header, &buffer[pos], 20);
+        int mopt = header[0], rows = header[1], cols = header[2], imagf = header[3], namlen = header[4];
+        pos += 20;
+
+        int m = (mopt/1000)%10, p = (mopt/10)%10, t = mopt%10;
+        if (m!=0 || mopt<0 || namlen<0 || rows<0 || cols<0) {
+          error = "invalid or big endian Level 4 file";
+          return false;
+        }
+        if (t==2) {
+          error = "sparse arrays are not supported";
+          return false;
+        }
+
+        static const int types[] = {MI_DOUBLE, MI_SINGLE, MI_INT32, MI_INT16, MI_UINT16, MI_UINT8};
+        static const int sizes[] = {8, 4, 4, 2, 2, 1};
+        if (p>5) {
+          error = "invalid Level 4 file";
+          return false;
+        }
+
+        size_t bytes = (size_t)rows*cols*sizes[p];
+        if (pos+namlen+bytes*(imagf ? 2 : 1)>buffer.size()) {
+          error = "unexpected end of file";
+          return false;
+        }
+
+        string name((const char *)&buffer[pos]);
+        pos += namlen;
+
+        matfile_value value;
+        value.dims.push_back(rows);
+        value.dims.push_back(cols);
+        if (!convert(types[p], &buffer[pos], (int)bytes, value.real)) return false;
+        pos += bytes;
+        if (imagf) {
+          if (!convert(types[p], &buffer[pos], (int)bytes, value.imag)) return false;
+          pos += bytes;
+        }
+
+        if (t==1) {
+          value.kind = matfile_value::CHAR;
+          value.text.resize(value.real.size());
+          for (size_t i=0; i<value.real.size(); i++) value.text[i] = (char)value.real[i];
+          value.real.clear();
+        }
+
+        names.push_back(name);
+        values.push_back(value);
+      }
+      return true;
+    }
+
+  public:
+    // reads all variables of the given file; returns false on error
+    bool read(const string &filename, vector<string> &names, vector<matfile_value> &values) {
+      FILE *fd = fopen(filename.c_str(), "rb");
+      if (!fd) {
+        error = "cannot open " + filename;
+        return false;
+      }
+
+      buffer.clear();
+      unsigned char chunk[65536];
+      size_t n;
+      while ((n = fread(chunk, 1, sizeof(chunk), fd))>0) buffer.insert(buffer.end(), chunk, chunk+n);
+      fclose(fd);
+
+      // Level 5 files start with a text header, Level 4 files with a small
+      // integer (the type of the first variable)
+      bool level5 = buffer.size()>=128 && (buffer[0]>=0x20 || buffer[1]>=0x20 || buffer[2]>=0x20 || buffer[3]>=0x20);
+      bool ok = level5 ? parse_level5(names, values) : parse_level4(names, values);
+      if (!ok) error = filename + ": " + error;
+
+      buffer.clear();
+      return ok;
+    }
+
+    const string &get_error() const {
+      return error;
+    }
+};
+
+class matfile_writer {
+  private:
+    vector<unsigned char> buffer;
+
+    void append(const void *data, size_t bytes) {
+      const unsigned char *p = (const unsigned char *)data;
+      buffer.insert(buffer.end(), p, p+bytes);
+    }
+
+    void pad() {
+      while (buffer.size()%8) buffer.push_back(0);
+    }
+
+    void element(int type, const void *data, int bytes) {
+      append(&type, 4);
+      append(&bytes, 4);
+      append(data, bytes);
+      pad();
+    }
+
+    // writes an miMATRIX element; its size is filled in at the end
+    void matrix(const string &name, const matfile_value &value) {
+      int type = MI_MATRIX, bytes = 0;
+      size_t start = buffer.size();
+      append(&type, 4);
+      append(&bytes, 4);
+
+      unsigned int flags[2] = {0, 0};
+      if (value.kind==matfile_value::STRUCT) flags[0] = MX_STRUCT_CLASS;
+      else if (value.kind==matfile_value::CHAR) flags[0] = MX_CHAR_CLASS;
+      else flags[0] = MX_DOUBLE_CLASS;
+      if (value.kind==matfile_value::NUMERIC && !value.imag.empty()) flags[0] |= 0x800;
+      element(MI_UINT32, flags, 8);
+
+      element(MI_INT32, &value.dims[0], 4*(int)value.dims.size());
+      element(MI_INT8, name.c_str(), (int)name.size());
+
+      if (value.kind==matfile_value::STRUCT) {
+        int field_name_length = 32;
+        element(MI_INT32, &field_name_length, 4);
+
+        vector<char> names(field_name_length*value.field_names.size(), 0);
+        for (size_t i=0; i<value.field_names.size(); i++) {
+          strncpy(&names[i*field_name_length], value.field_names[i].c_str(), field_name_length-1);
+        }
+        element(MI_INT8, names.empty() ? 0 : &names[0], (int)names.size());
+
+        for (size_t i=0; i<value.fields.size(); i++) matrix("", value.fields[i]);
+      }
+      else if (value.kind==matfile_value::CHAR) {
+        vector<unsigned short> chars(value.text.begin(), value.text.end());
+        element(MI_UINT16, chars.empty() ? 0 : &chars[0], 2*(int)chars.size());
+      }
+      else {
+        element(MI_DOUBLE, value.real.empty() ? 0 : &value.real[0], 8*(int)value.real.size());
+        if (!value.imag.empty()) element(MI_DOUBLE, &value.imag[0], 8*(int)value.imag.size());
+      }
+
+      bytes = (int)(buffer.size()-start-8);
+      memcpy(&buffer[start+4], &bytes, 4);
+    }
+
+  public:
+    matfile_writer() {
+      char header[128];
+      memset(header, ' ', 116);
+      const char *text = "MATLAB 5.0 MAT-file, written by HHGmax";
+      memcpy(header, text, strlen(text));
+      memset(header+116, 0, 8);
+      header[124] = 0x00; header[125] = 0x01; // version
+      header[126] = 'I'; header[127] = 'M';   // little endian
+      append(header, 128);
+    }
+
+    void add(const string &name, const matfile_value &value) {
+      matrix(name, value);
+    }
+
+    bool write(const string &filename) const {
+      FILE *fd = fopen(filename.c_str(), "wb");
+      if (!fd) return false;
+      bool ok = fwrite(&buffer[0], 1, buffer.size(), fd)==buffer.size();
+      return fclose(fd)==0 && ok;
+    }
+};
+
+#endif // end of include guard
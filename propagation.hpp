@@ -0,0 +1,237 @@
+// This file provides the z integration of hhgmax_harmonic_propagation.m
+// natively, as an accumulator that consumes the z slices of the dipole
+// response one at a time, e.g. as soon as they are finished or as they are
+// read from the cache. The complex field amplitude in the last z plane is
+//   U(omega) = i/2/epsilon0/c * omega * density / n * exp(i n k z_max)
+//              * int d(z,omega) exp(-i (n-1) k z) dz
+// with the complex refractive index n(omega) = 1 - delta + i kappa, where
+// kappa follows from the absorption coefficient, and the integral is computed
+// with the trapezoidal rule. As the z values are known in advance, each slice
+// is added with its weight of the trapezoidal rule, so that only U is kept in
+// memory (the size of one slice of the full grid) and the slices can be added
+// in any order. All quantities are in scaled atomic units, except for z in
+// millimeters.
+
+// include guard
+#ifndef PROPAGATION_HPP
+#define PROPAGATION_HPP
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+#include <math.h>
+
+// number of points of one frequency that are processed as one block; the
+// blocks of all frequencies are distributed over the threads
+#define PROPAGATION_BLOCK 1024
+
+// linear map from the points of a slice as stored in the cache to the points
+// of the full grid, which takes care of the symmetry options: the value of
+// the full point p is
+//   weight[2*p]*cache[index[2*p]] + weight[2*p+1]*cache[index[2*p+1]]
+struct propagation_grid_map {
+  int cache_points;
+  vector<int> index;
+  vector<double> weight;
+
+  propagation_grid_map() : cache_points(0) {};
+
+  int points() const {
+    return (int)index.size()/2;
+  };
+
+  // the full grid is stored in the cache as it is
+  static propagation_grid_map identity(int points) {
+    propagation_grid_map map;
+    map.cache_points = points;
+    map.index.resize(2*points);
+    map.weight.assign(2*points, 0.0);
+    for (int p=0; p<points; p++) {
+      map.index[2*p] = map.index[2*p+1] = p;
+      map.weight[2*p] = 1;
+    }
+    return map;
+  };
+};
+
+// linear interpolation like interp1(x, y, xi, 'linear', 'extrap')
+inline double propagation_interp(const vector<double> &x, const vector<double> &y, double xi) {
+  const int n = (int)x.size();
+  if (n==1) return y[0];
+  int i = (int)(upper_bound(x.begin(), x.end(), xi) - x.begin()) - 1;
+  i = max(0, min(i, n-2));
+  return y[i] + (y[i+1]-y[i]) * (xi-x[i]) / (x[i+1]-x[i]);
+}
+
+class harmonic_propagation {
+  private:
+    propagation_grid_map map;
+    vector<double> omega, zv;
+    vector<double> k, z_weights;
+    vector<complex<double> > n;
+    vector<complex<double> > U;
+    vector<bool> added;
+    double wavelength, density;
+    double s_unit, c_SAU, density_SAU;
+
+  public:
+    // grid - map from the points of the slices passed to add_slice to the
+    //        points of U (for several field components, the points of all
+    //        components)
+    // omega_axis - angular frequencies in scaled atomic units
+    // z_values - z values of all slices, in mm
+    // wavelength_mm - wavelength of the driving field in mm, which defines
+    //                 the scaled atomic units
+    // density_m3 - number density of the gas in m^-3
+    harmonic_propagation(const propagation_grid_map &grid, const vector<double> &omega_axis, const vector<double> &z_values, double wavelength_mm, double density_m3) :
+      map(grid), omega(omega_axis), zv(z_values), wavelength(wavelength_mm), density(density_m3)
+    {
+      const double pi = 4.0*atan(1.0);
+      const double c = 299792458;
+      const double hbar = 1.054571726e-34;
+      const double eq = 1.602176565e-19;
+      const double a0 = 5.2917721092e-11;
+      const double Ry = 13.60569253*eq;
+
+      // units of hhgmax_sau_convert.m
+      const double t_unit = (wavelength*1e-3) / c / (2*pi);
+      s_unit = a0 * sqrt(2*Ry/(hbar/t_unit));
+      c_SAU = c * t_unit / s_unit;
+      density_SAU = density * s_unit*s_unit*s_unit;
+
+      const int omegan = (int)omega.size();
+      k.resize(omegan);
+      for (int o=0; o<omegan; o++) k[o] = omega[o] * 2*pi/wavelength;
+      n.assign(omegan, complex<double>(1));
+
+      // weights of the trapezoidal rule in scaled atomic units; like
+      // hhgmax_harmonic_propagation.m, a single slice is taken as a target
+      // of 1 nm
+      const int zn = (int)zv.size();
+      z_weights.assign(zn, 0.0);
+      for (int zi=0; zi+1<zn; zi++) {
+        const double deltaz = (zv[zi+1]-zv[zi])*1e-3 / s_unit;
+        z_weights[zi] += deltaz/2;
+        z_weights[zi+1] += deltaz/2;
+      }
+      if (zn==1) z_weights[0] = 1e-9 / s_unit;
+
+      U.assign((size_t)map.points()*omegan, complex<double>(0));
+      added.assign(zn, false);
+    };
+
+    // sets the complex refractive index n = 1 - delta + i*alpha/2/k from the
+    // absorption coefficients alpha (in mm^-1) and the decrements delta of
+    // the real part, for each frequency; either may be 0
+    void set_refractive_index(const double *alpha, const double *delta) {
+      for (size_t o=0; o<omega.size(); o++) {
+        n[o] = complex<double>(1 - (delta ? delta[o] : 0), alpha ? alpha[o]/2/k[o] : 0);
+      }
+    };
+
+    // sets the refractive index from data of the gas for a pressure of 30 torr
+    // at 295 K versus photon energy in eV, as for
+    // hhgmax_harmonic_propagation.m: the transmission (with respect to
+    // intensity) of a path of 1 cm and the decrement delta of the real part of
+    // the refractive index. Both are scaled to the density and interpolated
+    // linearly to omega; empty vectors are left out.
+    void set_gas_data(const vector<double> &transmission_energy, const vector<double> &transmission, const vector<double> &delta_energy, const vector<double> &delta) {
+      const double eq = 1.602176565e-19;
+      const double hbar = 1.054571726e-34;
+      const double pi = 4.0*atan(1.0);
+      const double t_unit = (wavelength*1e-3) / 299792458.0 / (2*pi);
+      const double U_unit = hbar / t_unit;
+
+      const double torr = 1.3332e-3; // in bar
+      const double reference_density = 30*torr*1e5 / 1.3806488e-23 / 295;
+      const double scale = density/reference_density;
+
+      const int omegan = (int)omega.size();
+      vector<double> alpha(omegan, 0.0), delta_omega(omegan, 0.0);
+      vector<double> x, y;
+
+      if (!transmission.empty()) {
+        x.resize(transmission.size());
+        y.resize(transmission.size());
+        for (size_t i=0; i<x.size(); i++) {
+          x[i] = transmission_energy[i]*eq / U_unit;
+          y[i] = -log(transmission[i])/10 * scale;
+        }
+        for (int o=0; o<omegan; o++) alpha[o] = propagation_interp(x, y, omega[o]);
+      }
+
+      if (!delta.empty()) {
+        x.resize(delta.size());
+        y.resize(delta.size());
+        for (size_t i=0; i<x.size(); i++) {
+          x[i] = delta_energy[i]*eq / U_unit;
+          y[i] = delta[i] * scale;
+        }
+        for (int o=0; o<omegan; o++) delta_omega[o] = propagation_interp(x, y, omega[o]);
+      }
+
+      set_refractive_index(omegan ? &alpha[0] : 0, omegan ? &delta_omega[0] : 0);
+    };
+
+    // adds the dipole responses d(cache_point,omega_i) (point index fastest)
+    // of the slice at zv[zi]
+    void add_slice(int zi, const complex<double> *d) {
+      const complex<double> i(0, 1);
+      const int omegan = (int)omega.size();
+      const int points = map.points();
+      const int point_blocks = (points + PROPAGATION_BLOCK-1) / PROPAGATION_BLOCK;
+      const int *index = map.index.empty() ? 0 : &map.index[0];
+      const double *weight = map.weight.empty() ? 0 : &map.weight[0];
+      int block;
+
+      #pragma omp parallel for schedule(dynamic)
+      for (block=0; block<omegan*point_blocks; block++) {
+        const int o = block / point_blocks;
+        // n is not defined for omega==0, where the integrand is set to 0
+        if (omega[o]==0) continue;
+
+        const int first = (block % point_blocks) * PROPAGATION_BLOCK;
+        const int last = min(first+PROPAGATION_BLOCK, points);
+        const complex<double> factor = z_weights[zi] * exp(-i * (n[o]-1.0) * k[o] * zv[zi]);
+        const complex<double> *d_o = d + (size_t)map.cache_points*o;
+        complex<double> *U_o = &U[(size_t)points*o];
+
+        for (int p=first; p<last; p++) {
+          U_o[p] += factor * (weight[2*p]*d_o[index[2*p]] + weight[2*p+1]*d_o[index[2*p+1]]);
+        }
+      }
+
+      added[zi] = true;
+    };
+
+    // returns whether all slices were added
+    bool complete() const {
+      return find(added.begin(), added.end(), false)==added.end();
+    };
+
+    // applies the prefactor of the integral, after all slices were added;
+    // returns U(point,omega_i) (point index fastest)
+    const vector<complex<double> > &finish() {
+      const complex<double> i(0, 1);
+      const double epsilon0_SAU = 1/4.0/(4.0*atan(1.0));
+      const int omegan = (int)omega.size();
+      const int points = map.points();
+      const double z_max = zv.empty() ? 0 : zv[zv.size()-1];
+      int o;
+
+      #pragma omp parallel for
+      for (o=0; o<omegan; o++) {
+        // U is proportional to omega, which removes the singularity of n
+        const complex<double> prefactor = omega[o]==0 ? complex<double>(0) : i/2.0/epsilon0_SAU/c_SAU * omega[o] * density_SAU / n[o] * exp(i * n[o] * k[o] * z_max);
+        for (int p=0; p<points; p++) U[(size_t)points*o + p] *= prefactor;
+      }
+
+      return U;
+    };
+
+    double get_z_max() const {
+      return zv.empty() ? 0 : zv[zv.size()-1];
+    };
+};
+
+#endif // end of include guard
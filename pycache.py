@@ -0,0 +1,106 @@
+from __future__ import division
+
+import numpy as np
+
+# Reader/writer for the cache files of the 'tiled' backend of hhgmax_cache_file
+# (dipole_response_z*.hcc); see tiled_cache.hpp for a description of the file
+# format. The file is accessed by memory mapping, so only the tiles that are
+# needed are read from disk.
+
+header_size = 128
+version = 1
+
+class tiled_cache_file(object):
+  def __init__(self, filename, mode='r'):
+    self.filename = filename
+    self.mode = mode
+
+    header = np.fromfile(filename, dtype='<u8', count=16)
+    if header.size<16 or header[:1].tobytes()!=b'HHGCACHE':
+      raise ValueError('%s is not a tiled cache file' % filename)
+    if header[1]!=version:
+      raise ValueError('%s has an unsupported format version' % filename)
+
+    self.xn, self.yn, self.components, self.omegan, self.tile_points, self.tile_omega = [int(v) for v in header[2:8]]
+    self.point_blocks = -(-self.xn*self.yn // self.tile_points)
+    self.omega_blocks = -(-self.omegan // self.tile_omega)
+
+    # tiles(ob, pb, p_in, component, w)
+    shape = (self.omega_blocks, self.point_blocks, self.tile_points, self.components, self.tile_omega)
+    self.tiles = np.memmap(filename, dtype='<c16', mode=mode, offset=header_size, shape=shape)
+    self.header = np.memmap(filename, dtype='<u8', mode=mode, shape=(16,))
+
+  @classmethod
+  def create(cls, filename, xn, yn, components, omegan, tile_points=64, tile_omega=64):
+    # small slices are not padded to the full tile size
+    tile_points = max(min(tile_points, xn*yn), 1)
+    tile_omega = max(min(tile_omega, omegan), 1)
+
+    header = np.zeros(16, dtype='<u8')
+    header[:1] = np.frombuffer(b'HHGCACHE', dtype='<u8')
+    header[1:8] = [version, xn, yn, components, omegan, tile_points, tile_omega]
+
+    point_blocks = -(-xn*yn // tile_points)
+    omega_blocks = -(-omegan // tile_omega)
+    size = header_size + omega_blocks*point_blocks*tile_points*components*tile_omega*16
+
+    # the file is extended without writing, so that it is sparse
+    with open(filename, 'wb') as f:
+      f.write(header.tobytes())
+      f.truncate(size)
+
+    return cls(filename, 'r+')
+
+  @property
+  def finished(self):
+    return self.header[8]==1
+
+  def set_finished(self):
+    self.tiles.flush()
+    self.header[8] = 1
+    self.header.flush()
+
+  def write_point(self, xi, yi, d_omega):
+    """stores the spectrum d_omega[component, omega_i] of point (xi, yi); indices are 0-based"""
+    d_omega = np.asarray(d_omega).reshape(self.components, self.omegan)
+    p = yi + self.yn*xi
+    pb, p_in = divmod(p, self.tile_points)
+
+    for ob in range(self.omega_blocks):
+      w0 = ob*self.tile_omega
+      w1 = min(w0+self.tile_omega, self.omegan)
+      self.tiles[ob, pb, p_in, :, :w1-w0] = d_omega[:, w0:w1]
+
+  def read(self, omega_start, omega_stop):
+    """returns the spectra for omega_start<=omega_i<omega_stop as array [yi, xi, component, omega_i]"""
+    points = self.xn*self.yn
+    ob0 = omega_start // self.tile_omega
+    ob1 = -(-omega_stop // self.tile_omega)
+
+    # tiles(ob, pb, p_in, component, w) -> data(p, component, omega_i)
+    blocks = np.asarray(self.tiles[ob0:ob1])
+    data = blocks.transpose(1, 2, 3, 0, 4).reshape(self.point_blocks*self.tile_points, self.components, -1)
+    data = data[:points, :, omega_start-ob0*self.tile_omega:omega_stop-ob0*self.tile_omega]
+
+    # yi index is fastest within p
+    return data.reshape(self.xn, self.yn, self.components, -1).transpose(1, 0, 2, 3)
+
+if __name__=="__main__":
+  import os, tempfile
+
+  filename = os.path.join(tempfile.mkdtemp(), 'test.hcc')
+  xn, yn, components, omegan = 5, 3, 2, 100
+  data = np.random.randn(yn, xn, components, omegan) + 1j*np.random.randn(yn, xn, components, omegan)
+
+  f = tiled_cache_file.create(filename, xn, yn, components, omegan, tile_points=4, tile_omega=16)
+  for xi in range(xn):
+    for yi in range(yn):
+      f.write_point(xi, yi, data[yi, xi])
+  f.set_finished()
+  del f
+
+  f = tiled_cache_file(filename)
+  assert f.finished
+  assert np.all(f.read(0, omegan)==data)
+  assert np.all(f.read(17, 40)==data[:, :, :, 17:40])
+  print("Tiled cache test passed")
@@ -1,6 +1,6 @@
 from __future__ import division
 
-import ctypes, os, shutil
+import ctypes, os, shutil, time
 import numpy as np
 
 # constants
@@ -89,6 +89,38 @@ class dipole_elements_symmetric_interpolate(dipole_elements):
   def __del__(self):
      lewenstein_so.dipole_elements_symmetric_interpolate_double_destroy(self.dims, self.pointer)
 
+# wrap dipole elements tabulated over |p|^2
+lewenstein_so.dipole_elements_tabulated_double.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+lewenstein_so.dipole_elements_tabulated_double.restype = ctypes.c_void_p
+lewenstein_so.dipole_elements_double_destroy.argtypes = [ctypes.c_void_p]
+lewenstein_so.dipole_elements_double_destroy.restype = None
+
+class dipole_elements_tabulated(dipole_elements):
+  def __init__(self, dims, p, d, wavelength=None, table_length=None):
+     """ same arguments as dipole_elements_symmetric_interpolate, but interpolates cubically in |p|^2 with
+     table_length samples (default: 4 times as many as p), which is faster and more accurate """
+     if wavelength is not None:
+       p = sau_convert(p, 'p', 'SAU', wavelength)
+       d = sau_convert(d, 'd', 'SAU', wavelength)
+
+     self.dims = dims
+
+     N = p.size
+     assert d.size==N and N>=2
+     if table_length is None: table_length = 4*N
+
+     dp = np.min(np.diff(p))
+     assert np.isclose(dp, np.max(np.diff(p)), atol=0)
+
+     # the table is computed from a copy, so dr and di may be garbage collected
+     dr = np.require(d.real, np.double, ['C', 'A'])
+     di = np.require(d.imag, np.double, ['C', 'A'])
+
+     self.pointer = lewenstein_so.dipole_elements_tabulated_double(dims, N, dp, dr.ctypes.data, di.ctypes.data, table_length)
+
+  def __del__(self):
+     lewenstein_so.dipole_elements_double_destroy(self.pointer)
+
 # helper functions to generate weights
 def piecewise_cossqr(t, ts, ys):
   ts, ys = np.array(ts), np.array(ys)
@@ -116,6 +148,15 @@ def get_weights(tau,T=2*np.pi,periods_one=1,periods_soft=.5):
   tau_truncated = tau[tau/T<=periods_one+periods_soft]
   return piecewise_cossqr(tau_truncated/T, [0, periods_one, periods_one+periods_soft], [1., 1., 0.])
 
+# helper function for non-uniform tau grids (see lewenstein_plan): all samples
+# of tau below periods_fine periods, then every stride-th sample; the first and
+# last sample are always included
+def graded_tau_nodes(tau,T=2*np.pi,periods_fine=.5,stride=4):
+  tau = tau - tau[0]
+  fine = np.count_nonzero(tau<periods_fine*T)
+  index = np.arange(tau.size)
+  return index[(index<fine) | ((index-fine)%stride==0) | (index==tau.size-1)]
+
 # helper function for unit conversion
 def sau_convert(value, quantity, target, wavelength):
   # scaled atomic unit quantities expressed in SI units
@@ -137,11 +178,19 @@ def sau_convert(value, quantity, target, wavelength):
   else:
     raise ValueError('target must be SI or SAU')
 
-# wrap lewenstein function
+# wrap lewenstein function; available in double, single and mixed precision
+# (single precision integrand, double precision arguments and summation)
 lewenstein_so.lewenstein_double.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p]
 lewenstein_so.lewenstein_double.restype = None
+lewenstein_so.lewenstein_float.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_float, ctypes.c_float, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_float.restype = None
+lewenstein_so.lewenstein_mixed.argtypes = lewenstein_so.lewenstein_double.argtypes
+lewenstein_so.lewenstein_mixed.restype = None
+
+lewenstein_functions = {'double': lewenstein_so.lewenstein_double, 'single': lewenstein_so.lewenstein_float, 'mixed': lewenstein_so.lewenstein_mixed}
+precision_dtypes = {'double': np.double, 'single': np.single, 'mixed': np.double}
 
-def lewenstein(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4):
+def lewenstein(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4,precision='double'):
   # default value for weights
   if weights is None and wavelength is None:
     weights = get_weights(t)
@@ -164,11 +213,12 @@ def lewenstein(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None
   t = t - t[0]
 
   # make sure we have appropriate memory layout before passing to C code
-  t = np.require(t, np.double, ['C', 'A'])
-  Et = np.require(Et, np.double, ['C', 'A'])
-  weights = np.require(weights, np.double, ['C', 'A'])
-  at = np.require(at, np.double, ['C', 'A'])
-  output = np.require(output, np.double, ['C', 'A', 'W'])
+  dtype = precision_dtypes[precision]
+  t = np.require(t, dtype, ['C', 'A'])
+  Et = np.require(Et, dtype, ['C', 'A'])
+  weights = np.require(weights, dtype, ['C', 'A'])
+  at = np.require(at, dtype, ['C', 'A'])
+  output = np.require(output, dtype, ['C', 'A', 'W'])
 
   # get dimensions
   N = t.size
@@ -186,7 +236,77 @@ def lewenstein(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None
 
   # call C function
   assert dipole_elements.dims==dims
-  lewenstein_so.lewenstein_double(dims, N, t.ctypes.data, Et.ctypes.data, weights_length, weights.ctypes.data, at.ctypes.data, ip, epsilon_t, dipole_elements.pointer, output.ctypes.data)
+  lewenstein_functions[precision](dims, N, t.ctypes.data, Et.ctypes.data, weights_length, weights.ctypes.data, at.ctypes.data, ip, epsilon_t, dipole_elements.pointer, output.ctypes.data)
+
+  # unit conversion
+  if wavelength is not None:
+    output = sau_convert(output, 'd', 'SI', wavelength)
+
+  return output
+
+# wrap batched lewenstein function
+lewenstein_so.lewenstein_batch_double.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_batch_double.restype = None
+lewenstein_so.lewenstein_batch_float.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_batch_float.restype = None
+lewenstein_so.lewenstein_batch_mixed.argtypes = lewenstein_so.lewenstein_batch_double.argtypes
+lewenstein_so.lewenstein_batch_mixed.restype = None
+
+lewenstein_batch_functions = {'double': lewenstein_so.lewenstein_batch_double, 'single': lewenstein_so.lewenstein_batch_float, 'mixed': lewenstein_so.lewenstein_batch_mixed}
+
+def lewenstein_batch(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4,precision='double'):
+  # default value for weights
+  if weights is None and wavelength is None:
+    weights = get_weights(t)
+  elif weights is None and wavelength is not None:
+    weights = get_weights(t, wavelength/c)
+
+  # unit conversion
+  if wavelength is not None:
+    t = sau_convert(t, 't', 'SAU', wavelength)
+    Et = sau_convert(Et, 'E', 'SAU', wavelength)
+    ip = sau_convert(ip, 'U', 'SAU', wavelength)
+
+  # allocate memory for output
+  output = np.empty_like(Et)
+
+  # make sure t axis starts at zero
+  t = t - t[0]
+
+  # make sure we have appropriate memory layout before passing to C code
+  dtype = precision_dtypes[precision]
+  t = np.require(t, dtype, ['C', 'A'])
+  Et = np.require(Et, dtype, ['C', 'A'])
+  weights = np.require(weights, dtype, ['C', 'A'])
+  output = np.require(output, dtype, ['C', 'A', 'W'])
+
+  # get dimensions
+  N = t.size
+  points = Et.shape[0]
+  dims = Et.shape[2] if len(Et.shape)>2 else 1
+  weights_length = weights.size
+
+  # check dimensions
+  assert Et.shape[1]==N
+  assert dims in [1,2,3]
+  assert Et.size==points*N*dims
+
+  # ground state amplitude: none, shared between all points or one per point
+  if at is None:
+    at_pointer = None
+    at_stride = 0
+  else:
+    at = np.require(at, dtype, ['C', 'A'])
+    assert at.size in [N, points*N]
+    at_pointer = at.ctypes.data
+    at_stride = 0 if at.size==N else N
+
+  # default value for dipole elements
+  if dipole_elements is None: dipole_elements = dipole_elements_H(dims, ip=ip)
+
+  # call C function
+  assert dipole_elements.dims==dims
+  lewenstein_batch_functions[precision](dims, points, N, t.ctypes.data, Et.ctypes.data, weights_length, weights.ctypes.data, at_pointer, at_stride, ip, epsilon_t, dipole_elements.pointer, output.ctypes.data)
 
   # unit conversion
   if wavelength is not None:
@@ -194,11 +314,629 @@ def lewenstein(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None
 
   return output
 
+# compare single and mixed precision to double precision
+def precision_report(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4,dynamic_range=1e-6):
+  """ Computes the dipole response for the given driving field with all precisions. Returns a dict
+  that contains for 'single' and 'mixed' precision a dict with the maximum deviation from the double
+  precision result relative to its maximum ('dipole'), and the maximum relative deviation of the
+  spectral intensity, considering only frequencies where the intensity is larger than dynamic_range
+  times its maximum ('spectrum'). """
+
+  if dipole_elements is None:
+    dims = Et.shape[1] if len(Et.shape)>1 else 1
+    dipole_elements = dipole_elements_H(dims, ip=ip, wavelength=wavelength)
+
+  def compute(precision):
+    d = lewenstein(t,Et,ip,wavelength,weights,at,dipole_elements,epsilon_t,precision)
+    d = np.asarray(d, np.double).reshape(len(t), -1)
+    spectrum = np.sum(abs(np.fft.fft(d, axis=0))**2, axis=1)
+    return d, spectrum
+
+  reference_d, reference_spectrum = compute('double')
+  significant = reference_spectrum > dynamic_range*np.max(reference_spectrum)
+
+  report = {}
+  for precision in ['single', 'mixed']:
+    d, spectrum = compute(precision)
+    report[precision] = {
+      'dipole': np.max(abs(d-reference_d)) / np.max(abs(reference_d)),
+      'spectrum': np.max(abs(spectrum-reference_spectrum)[significant] / reference_spectrum[significant]),
+    }
+
+  return report
+
+# wrap static ionization rates w(|E|), from which lewenstein_plan computes the
+# ground state amplitude a(t) = sqrt(exp(-int w dt)) for each point; the rates
+# are stored in scaled atomic units
+lewenstein_so.ionization_rate_table_double.argtypes = [ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.ionization_rate_table_double.restype = ctypes.c_void_p
+lewenstein_so.ionization_rate_tong_lin_double.argtypes = [ctypes.c_double, ctypes.c_double, ctypes.c_int, ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double]
+lewenstein_so.ionization_rate_tong_lin_double.restype = ctypes.c_void_p
+lewenstein_so.tong_lin_atom_parameters.argtypes = [ctypes.c_char_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.tong_lin_atom_parameters.restype = ctypes.c_int
+lewenstein_so.ionization_rate_double_get.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.ionization_rate_double_get.restype = None
+lewenstein_so.ionization_ground_state_amplitude_double.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.ionization_ground_state_amplitude_double.restype = None
+lewenstein_so.ionization_rate_double_destroy.argtypes = [ctypes.c_void_p]
+lewenstein_so.ionization_rate_double_destroy.restype = None
+
+class ionization_rate(object):
+  pointer = None
+  wavelength = None
+
+  def __del__(self):
+    if self.pointer:
+      lewenstein_so.ionization_rate_double_destroy(self.pointer)
+
+  def __call__(self, E):
+    """ ionization rate for the field strengths E """
+    if self.wavelength is not None:
+      E = sau_convert(E, 'E', 'SAU', self.wavelength)
+
+    E = np.require(E, np.double, ['C', 'A'])
+    w = np.require(np.empty_like(E), np.double, ['C', 'A', 'W'])
+    lewenstein_so.ionization_rate_double_get(self.pointer, E.size, E.ctypes.data, w.ctypes.data)
+
+    if self.wavelength is not None:
+      w = sau_convert(w, 'omega', 'SI', self.wavelength)
+    return w
+
+  def ground_state_amplitude(self, t, Et):
+    """ Et: points x N (x dims); returns a(t) of shape points x N """
+    if self.wavelength is not None:
+      t = sau_convert(t, 't', 'SAU', self.wavelength)
+      Et = sau_convert(Et, 'E', 'SAU', self.wavelength)
+
+    t = np.require(t, np.double, ['C', 'A'])
+    Et = np.require(Et, np.double, ['C', 'A'])
+    N = t.size
+    points = Et.shape[0]
+    assert Et.shape[1]==N
+    dims = Et.size//(points*N)
+
+    at = np.empty((points, N))
+    lewenstein_so.ionization_ground_state_amplitude_double(self.pointer, dims, points, N, t.ctypes.data, Et.ctypes.data, at.ctypes.data)
+    return at
+
+class ionization_rate_table(ionization_rate):
+  def __init__(self, E, w, wavelength=None):
+    """ static ionization rate w at the increasing field strengths E (like the static_ionization_rate
+    option of hhgmax_dipole_response.m), interpolated linearly and NaN outside of E; in SI units if
+    the wavelength is given, otherwise in scaled atomic units """
+    if wavelength is not None:
+      E = sau_convert(E, 'E', 'SAU', wavelength)
+      w = sau_convert(w, 'omega', 'SAU', wavelength)
+
+    E = np.require(E, np.double, ['C', 'A'])
+    w = np.require(w, np.double, ['C', 'A'])
+    assert E.size==w.size and E.size>=2
+
+    self.wavelength = wavelength
+    self.pointer = lewenstein_so.ionization_rate_table_double(E.size, E.ctypes.data, w.ctypes.data)
+
+class tong_lin_ionization_rate(ionization_rate):
+  def __init__(self, wavelength, atom=None, ip=None, C=None, l=None, m=0, Z=1, alpha=None, E_max=None):
+    """ ionization rate of Tong, Lin (2005) as in hhgmax_tong_lin_ionization_rate.m, for one of
+    the atoms 'Xe', 'Ar', 'Ne', 'He', 'Kr' or for the given ip (in J), C and l; tabulated up to
+    the field strength E_max (in V/m, default 0.5 atomic units) and computed directly beyond.
+    The wavelength (in m) is needed for the units, and also used for the call arguments """
+    if atom is not None:
+      values = [ctypes.c_double(), ctypes.c_double(), ctypes.c_int(), ctypes.c_double(), ctypes.c_double()]
+      if not lewenstein_so.tong_lin_atom_parameters(atom.encode(), *[ctypes.addressof(v) for v in values]):
+        raise ValueError('atom %s is not implemented' % atom)
+      ip_eV, C, l, Z, atom_alpha = [v.value for v in values]
+      if alpha is None: alpha = atom_alpha
+    else:
+      assert ip is not None and C is not None and l is not None
+      ip_eV = ip/e
+      if alpha is None: alpha = 0
+
+    if E_max is None: E_max = 0.5*5.14220652e11
+
+    # atomic units per scaled atomic unit
+    E_unit = sau_convert(1, 'E', 'SI', wavelength) / 5.14220652e11
+    t_unit = sau_convert(1, 't', 'SI', wavelength) / 2.418884326505e-17
+
+    self.wavelength = wavelength
+    self.pointer = lewenstein_so.ionization_rate_tong_lin_double(ip_eV, C, l, m, Z, alpha, sau_convert(E_max, 'E', 'SAU', wavelength), E_unit, t_unit)
+
+# wrap the thread settings of all following calls
+lewenstein_so.lewenstein_threads_set.argtypes = [ctypes.c_int]
+lewenstein_so.lewenstein_threads_set.restype = None
+lewenstein_so.lewenstein_threads_get.argtypes = []
+lewenstein_so.lewenstein_threads_get.restype = ctypes.c_int
+lewenstein_so.lewenstein_threads_set_affinity.argtypes = [ctypes.c_int, ctypes.c_void_p]
+lewenstein_so.lewenstein_threads_set_affinity.restype = ctypes.c_int
+
+def set_threads(threads):
+  """ sets the number of threads of all following calls; 0 restores the default of the OpenMP
+  runtime (e.g. OMP_NUM_THREADS) """
+  lewenstein_so.lewenstein_threads_set(int(threads))
+
+def get_threads():
+  """ returns the number of threads of all following calls """
+  return lewenstein_so.lewenstein_threads_get()
+
+def set_affinity(cpus):
+  """ binds thread i of all following calls to the CPU cpus[i % len(cpus)]; an empty list switches
+  the binding off; returns False if binding threads is not supported on this platform """
+  cpus = np.ascontiguousarray(cpus, dtype=ctypes.c_int)
+  return bool(lewenstein_so.lewenstein_threads_set_affinity(cpus.size, cpus.ctypes.data))
+
+# wrap instrumentation of plans: timers, counters and a progress callback
+lewenstein_progress_callback = ctypes.CFUNCTYPE(None, ctypes.c_double, ctypes.c_void_p)
+lewenstein_so.lewenstein_stats_create.argtypes = []
+lewenstein_so.lewenstein_stats_create.restype = ctypes.c_void_p
+lewenstein_so.lewenstein_stats_reset.argtypes = [ctypes.c_void_p]
+lewenstein_so.lewenstein_stats_reset.restype = None
+lewenstein_so.lewenstein_stats_set_progress.argtypes = [ctypes.c_void_p, lewenstein_progress_callback, ctypes.c_void_p, ctypes.c_double]
+lewenstein_so.lewenstein_stats_set_progress.restype = None
+lewenstein_so.lewenstein_stats_get.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_stats_get.restype = ctypes.c_int
+lewenstein_so.lewenstein_stats_get_threads.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_stats_get_threads.restype = None
+lewenstein_so.lewenstein_stats_destroy.argtypes = [ctypes.c_void_p]
+lewenstein_so.lewenstein_stats_destroy.restype = None
+
+stats_keys = ['calls', 'points', 'prepare_seconds', 'tau_seconds', 'total_seconds', 'evaluations', 'zero_weight_evaluations', 'skipped_evaluations']
+
+class lewenstein_stats(object):
+  pointer = None
+  _callback = None
+
+  def __init__(self, progress=None, progress_interval=1.0):
+    """ collects timers and counters of all plans it is passed to (see lewenstein_plan.set_stats);
+    progress(fraction) is called at most every progress_interval seconds during execute and once
+    at its end """
+    self.pointer = lewenstein_so.lewenstein_stats_create()
+
+    # the ctypes callback must not be garbage collected before the stats
+    if progress is not None:
+      self._callback = lewenstein_progress_callback(lambda fraction, user: progress(fraction))
+      lewenstein_so.lewenstein_stats_set_progress(self.pointer, self._callback, None, progress_interval)
+
+  def __del__(self):
+    if self.pointer:
+      lewenstein_so.lewenstein_stats_destroy(self.pointer)
+
+  def reset(self):
+    lewenstein_so.lewenstein_stats_reset(self.pointer)
+
+  def get(self):
+    """ returns a dict with the entries of stats_keys, and thread_seconds, thread_evaluations and
+    thread_tiles with one entry per thread """
+    values = np.zeros(len(stats_keys))
+    threads = lewenstein_so.lewenstein_stats_get(self.pointer, values.ctypes.data)
+    result = dict(zip(stats_keys, values))
+
+    per_thread = [np.zeros(threads) for i in range(3)]
+    lewenstein_so.lewenstein_stats_get_threads(self.pointer, *[a.ctypes.data for a in per_thread])
+    result['thread_seconds'], result['thread_evaluations'], result['thread_tiles'] = per_thread
+    return result
+
+# wrap plans for repeated lewenstein calls with the same time axis, weights,
+# ip, epsilon_t and dipole elements
+lewenstein_so.lewenstein_plan_double_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_double, ctypes.c_double, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_create.restype = ctypes.c_void_p
+lewenstein_so.lewenstein_plan_double_create_grid.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_double, ctypes.c_double, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+lewenstein_so.lewenstein_plan_double_create_grid.restype = ctypes.c_void_p
+lewenstein_so.lewenstein_plan_double_execute.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_execute.restype = None
+lewenstein_so.lewenstein_plan_double_execute_strided.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double]
+lewenstein_so.lewenstein_plan_double_execute_strided.restype = None
+lewenstein_so.lewenstein_plan_double_add_species.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_add_species.restype = ctypes.c_int
+lewenstein_so.lewenstein_plan_double_execute_species.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double]
+lewenstein_so.lewenstein_plan_double_execute_species.restype = None
+lewenstein_so.lewenstein_plan_double_add_window.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_add_window.restype = ctypes.c_int
+lewenstein_so.lewenstein_plan_double_execute_windows.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double]
+lewenstein_so.lewenstein_plan_double_execute_windows.restype = None
+lewenstein_so.lewenstein_plan_double_set_ionization_rate.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_set_ionization_rate.restype = None
+lewenstein_so.lewenstein_plan_double_set_stats.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_set_stats.restype = None
+lewenstein_so.lewenstein_plan_double_set_accuracy.argtypes = [ctypes.c_void_p, ctypes.c_int]
+lewenstein_so.lewenstein_plan_double_set_accuracy.restype = None
+lewenstein_so.lewenstein_accuracy_for.argtypes = [ctypes.c_double]
+lewenstein_so.lewenstein_accuracy_for.restype = ctypes.c_int
+lewenstein_so.lewenstein_plan_double_destroy.argtypes = [ctypes.c_void_p]
+lewenstein_so.lewenstein_plan_double_destroy.restype = None
+
+# returns the array as double array without copying it if possible, and its
+# strides in elements; unaligned arrays are copied
+def element_strides(a):
+  a = np.asarray(a, np.double)
+  if not a.flags.aligned or any(stride % a.itemsize for stride in a.strides):
+    a = np.require(a, np.double, ['C', 'A'])
+  return a, [stride//a.itemsize for stride in a.strides]
+
+class lewenstein_plan(object):
+  pointer = None
+  _dipole_elements = None
+  _ionization_rate = None
+  _stats = None
+  _executor = None
+  _future = None
+  _species = None
+
+  def __init__(self,t,ip,dims=1,wavelength=None,weights=None,dipole_elements=None,epsilon_t=1e-4,tau_nodes=None,quadrature='trapezoid',periodic=False,ionization_rate=None,accuracy=0):
+    """ tau_nodes: indices into weights of a non-uniform tau grid (e.g. from graded_tau_nodes),
+    or None to use all; quadrature: 'trapezoid' or 'filon', which integrates the oscillation
+    of exp(-iS) between the nodes exactly and therefore allows coarser grids; periodic: t is
+    one period of a periodic driving field, equally spaced and without the endpoint, and the
+    dipole response is computed for this period as if the field had been repeated forever
+    (weights may then be longer than t); ionization_rate: an ionization_rate object, from which
+    the ground state amplitude is computed for each point if execute is called without at
+    (not in periodic mode); accuracy: tolerated absolute error of the sine and cosine of the
+    phase, 0 for exact values, at least 3e-12 or 1e-7 for faster approximations (see
+    accuracy_report) """
+    # default value for weights; in periodic mode, the tau axis continues beyond one period
+    tau = t[0] + (t[1]-t[0])*np.arange(3*t.size) if periodic else t
+    if weights is None and wavelength is None:
+      weights = get_weights(tau)
+    elif weights is None and wavelength is not None:
+      weights = get_weights(tau, wavelength/c)
+
+    # unit conversion
+    if wavelength is not None:
+      t = sau_convert(t, 't', 'SAU', wavelength)
+      ip = sau_convert(ip, 'U', 'SAU', wavelength)
+
+    # make sure t axis starts at zero
+    t = t - t[0]
+
+    # make sure we have appropriate memory layout before passing to C code
+    t = np.require(t, np.double, ['C', 'A'])
+    weights = np.require(weights, np.double, ['C', 'A'])
+
+    assert dims in [1,2,3]
+    assert quadrature in ['trapezoid', 'filon']
+
+    # tau grid: all tau_i if no nodes are given
+    if tau_nodes is None:
+      nodes_length = 0
+      nodes_pointer = None
+    else:
+      tau_nodes = np.require(tau_nodes, np.intc, ['C', 'A'])
+      nodes_length = tau_nodes.size
+      nodes_pointer = tau_nodes.ctypes.data
+
+    # default value for dipole elements
+    if dipole_elements is None: dipole_elements = dipole_elements_H(dims, ip=ip)
+    assert dipole_elements.dims==dims
+
+    # dipole elements must not be garbage collected before the plan
+    self._dipole_elements = dipole_elements
+
+    self.N = t.size
+    self.dims = dims
+    self.wavelength = wavelength
+    self.periodic = periodic
+    self.species = 1
+    self.windows = 1
+
+    # dipole elements and ionization rates of the species added by add_species
+    self._species = []
+
+    # unit conversion of execute, applied by the C code while reading and writing
+    self._E_scale = sau_convert(1.0, 'E', 'SAU', wavelength) if wavelength is not None else 1.0
+    self._d_scale = sau_convert(1.0, 'd', 'SI', wavelength) if wavelength is not None else 1.0
+    self.pointer = lewenstein_so.lewenstein_plan_double_create_grid(dims, self.N, t.ctypes.data, weights.size, weights.ctypes.data, ip, epsilon_t, dipole_elements.pointer, nodes_length, nodes_pointer, quadrature=='filon', periodic)
+
+    # the ionization rate must not be garbage collected before the plan
+    if ionization_rate is not None:
+      assert not periodic
+      self._ionization_rate = ionization_rate
+      lewenstein_so.lewenstein_plan_double_set_ionization_rate(self.pointer, ionization_rate.pointer)
+
+    assert accuracy>=0
+    lewenstein_so.lewenstein_plan_double_set_accuracy(self.pointer, lewenstein_so.lewenstein_accuracy_for(accuracy))
+
+  def __del__(self):
+    if self._executor is not None:
+      self._executor.shutdown(wait=True)
+    if self.pointer:
+      lewenstein_so.lewenstein_plan_double_destroy(self.pointer)
+
+  def _wait(self):
+    # the native buffers of the plan are shared by all calls, so the last call of
+    # execute_async must be finished before the plan is used again
+    if self._future is not None:
+      from concurrent.futures import wait
+      wait([self._future])
+      self._future = None
+
+  def set_stats(self,stats):
+    """ records timers and counters of execute in the lewenstein_stats object (None switches this off) """
+    self._wait()
+    self._stats = stats
+    lewenstein_so.lewenstein_plan_double_set_stats(self.pointer, stats.pointer if stats is not None else None)
+
+  def execute_batch(self,Et,at=None,out=None):
+    """ Et: points x N (x dims), at: None, N or points x N; returns dipole responses of the same shape
+    as Et, written to out if given (a double array of that shape). The arrays may have any strides,
+    e.g. views of a larger array, and are neither copied nor converted in Python (unless Et or at
+    are not double arrays) """
+    self._wait()
+    return self._execute_batch(Et, at, out)
+
+  def _execute_batch(self,Et,at=None,out=None):
+    # check dimensions
+    N = self.N
+    Et, Et_strides = element_strides(Et)
+    points = Et.shape[0]
+    assert Et.ndim in [2,3] and Et.shape[1]==N
+    assert Et.size==points*N*self.dims
+    if Et.ndim==2: Et_strides.append(0)
+
+    if out is None:
+      out = np.empty(Et.shape)
+    assert isinstance(out, np.ndarray) and out.dtype==np.double and out.flags.writeable and out.flags.aligned
+    assert out.shape==Et.shape and all(stride % out.itemsize==0 for stride in out.strides)
+    out_strides = [stride//out.itemsize for stride in out.strides] + [0]*(3-out.ndim)
+
+    # ground state amplitude: none (or computed from the ionization rate),
+    # shared between all points (point stride 0) or one per point
+    if at is None:
+      at_pointer = None
+      at_strides = [0, 0]
+    else:
+      at, at_strides = element_strides(at)
+      assert at.shape in [(N,), (points,N)]
+      if at.ndim==1: at_strides = [0] + at_strides
+      at_pointer = at.ctypes.data
+
+    # call C function
+    strides = [np.array(s, np.intp) for s in (Et_strides, at_strides, out_strides)]
+    lewenstein_so.lewenstein_plan_double_execute_strided(self.pointer, points, Et.ctypes.data, strides[0].ctypes.data, self._E_scale, at_pointer, strides[1].ctypes.data, out.ctypes.data, strides[2].ctypes.data, self._d_scale)
+
+    return out
+
+  def add_species(self,ip,dipole_elements=None,ionization_rate=None):
+    """ adds a species with another ionization potential (in SI units if the plan has a
+    wavelength), dipole elements (of the same class as the ones of the plan; hydrogen-like ones
+    for ip by default) and ionization rate, whose dipole responses execute_species computes
+    together with the ones of the plan's own species in one pass; returns the index of the
+    species (1, 2, ...). Species with the same dipole elements object should be added one after
+    another, which saves evaluating them again. """
+    if self.wavelength is not None:
+      ip = sau_convert(ip, 'U', 'SAU', self.wavelength)
+    if dipole_elements is None: dipole_elements = dipole_elements_H(self.dims, ip=ip)
+    assert ionization_rate is None or not self.periodic
+    self._wait()
+
+    index = lewenstein_so.lewenstein_plan_double_add_species(self.pointer, ip, dipole_elements.pointer, ionization_rate.pointer if ionization_rate is not None else None)
+    if index<0:
+      raise ValueError("the dipole elements of all species must be of the same class and dimensions")
+
+    # dipole elements and ionization rate must not be garbage collected before the plan
+    self._species.append((dipole_elements, ionization_rate))
+    self.species = index+1
+    return index
+
+  def execute_species(self,Et,at=None,out=None):
+    """ like execute_batch, but computes the dipole responses of all species (see add_species)
+    in one pass; Et: points x N (x dims), at: None or an array that can be broadcast to
+    species x points x N (e.g. N, points x N or species x 1 x N); returns an array of shape
+    species x Et.shape, written to out if given """
+    self._wait()
+
+    # check dimensions
+    N = self.N
+    species = self.species
+    Et, Et_strides = element_strides(Et)
+    points = Et.shape[0]
+    assert Et.ndim in [2,3] and Et.shape[1]==N
+    assert Et.size==points*N*self.dims
+    if Et.ndim==2: Et_strides.append(0)
+
+    if out is None:
+      out = np.empty((species,) + Et.shape)
+    assert isinstance(out, np.ndarray) and out.dtype==np.double and out.flags.writeable and out.flags.aligned
+    assert out.shape==(species,) + Et.shape and all(stride % out.itemsize==0 for stride in out.strides)
+    out_strides = [stride//out.itemsize for stride in out.strides] + [0]*(4-out.ndim)
+
+    # ground state amplitudes, with stride 0 along the broadcast dimensions
+    if at is None:
+      at_pointer = None
+      at_strides = [0, 0, 0]
+    else:
+      at, at_strides = element_strides(np.broadcast_to(np.asarray(at, np.double), (species, points, N)))
+      at_pointer = at.ctypes.data
+
+    # call C function
+    strides = [np.array(s, np.intp) for s in (Et_strides, at_strides, out_strides)]
+    lewenstein_so.lewenstein_plan_double_execute_species(self.pointer, species, points, Et.ctypes.data, strides[0].ctypes.data, self._E_scale, at_pointer, strides[1].ctypes.data, out.ctypes.data, strides[2].ctypes.data, self._d_scale)
+
+    return out
+
+  def add_window(self,weights):
+    """ adds a window: other weights on the tau axis of the plan (e.g. weights_short_trajectory),
+    padded with zeros and not longer than the weights of the plan, for which execute_windows
+    computes the dipole responses from the same evaluations of the integrand (trajectory
+    decomposition); returns the index of the window (1, 2, ...) """
+    weights = np.require(weights, np.double, ['C', 'A'])
+    self._wait()
+    index = lewenstein_so.lewenstein_plan_double_add_window(self.pointer, weights.size, weights.ctypes.data)
+    if index<0:
+      raise ValueError("a window must not be longer than the weights of the plan")
+
+    self.windows = index+1
+    return index
+
+  def execute_windows(self,Et,at=None,out=None):
+    """ like execute_batch, but computes the dipole responses for the weights of the plan and
+    each window (see add_window) in one pass; returns an array of shape windows x Et.shape,
+    written to out if given """
+    self._wait()
+
+    # check dimensions
+    N = self.N
+    windows = self.windows
+    Et, Et_strides = element_strides(Et)
+    points = Et.shape[0]
+    assert Et.ndim in [2,3] and Et.shape[1]==N
+    assert Et.size==points*N*self.dims
+    if Et.ndim==2: Et_strides.append(0)
+
+    if out is None:
+      out = np.empty((windows,) + Et.shape)
+    assert isinstance(out, np.ndarray) and out.dtype==np.double and out.flags.writeable and out.flags.aligned
+    assert out.shape==(windows,) + Et.shape and all(stride % out.itemsize==0 for stride in out.strides)
+    out_strides = [stride//out.itemsize for stride in out.strides] + [0]*(4-out.ndim)
+
+    # the stride between the species is 0 (only the first is computed)
+    out_strides.insert(1, 0)
+
+    # ground state amplitude as for execute_batch
+    if at is None:
+      at_pointer = None
+      at_strides = [0, 0, 0]
+    else:
+      at, at_strides = element_strides(at)
+      assert at.shape in [(N,), (points,N)]
+      if at.ndim==1: at_strides = [0] + at_strides
+      at_strides = [0] + at_strides
+      at_pointer = at.ctypes.data
+
+    # call C function
+    strides = [np.array(s, np.intp) for s in (Et_strides, at_strides, out_strides)]
+    lewenstein_so.lewenstein_plan_double_execute_windows(self.pointer, 1, windows, points, Et.ctypes.data, strides[0].ctypes.data, self._E_scale, at_pointer, strides[1].ctypes.data, out.ctypes.data, strides[2].ctypes.data, self._d_scale)
+
+    return out
+
+  def execute(self,Et,at=None,out=None):
+    """ Et: N (x dims), at: None or N; returns dipole response of the same shape as Et """
+    return self.execute_batch(Et[np.newaxis], at, None if out is None else out[np.newaxis])[0]
+
+  def execute_async(self,Et,at=None,out=None):
+    """ like execute_batch, but returns a concurrent.futures.Future of the result immediately, so
+    that the next batch can be prepared while the native threads compute this one (ctypes releases
+    the GIL during the call). The calls of a plan are run one after another in a background thread;
+    Et, at and out must not be changed before the future is done. The other methods of the plan
+    wait for the future before they use the plan. """
+    from concurrent.futures import ThreadPoolExecutor
+    if self._executor is None:
+      self._executor = ThreadPoolExecutor(max_workers=1)
+    self._future = self._executor.submit(self._execute_batch, Et, at, out)
+    return self._future
+
+# trajectory decomposition: dipole responses for several windows of weights in one pass
+def trajectory_decomposition(t,Et,ip,wavelength=None,windows=None,at=None,dipole_elements=None,epsilon_t=1e-4):
+  """ Computes the dipole responses like lewenstein_batch (Et: points x N (x dims), at: None, N
+  or points x N) for each of the weight vectors in windows, by default the full window of
+  get_weights and the windows of the short and the long trajectories, from the same evaluations
+  of the integrand. Returns an array of shape windows x Et.shape. """
+  if windows is None:
+    T = 2*np.pi if wavelength is None else wavelength/c
+    windows = [get_weights(t, T), weights_short_trajectory(t, T), weights_long_trajectory(t, T)]
+
+  # the weights of the plan cover all windows
+  weights = np.zeros(max(np.size(window) for window in windows))
+  weights[:np.size(windows[0])] = windows[0]
+
+  Et = np.asarray(Et)
+  plan = lewenstein_plan(t,ip,Et.shape[2] if Et.ndim>2 else 1,wavelength,weights,dipole_elements,epsilon_t)
+  for window in windows[1:]:
+    plan.add_window(window)
+  return plan.execute_windows(Et, at)
+
+# compare non-uniform tau grids to the uniform one
+def tau_grid_report(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4,dynamic_range=1e-6,periods_fine=.5,strides=[2,4,8,16],quadrature='trapezoid'):
+  """ Computes the dipole response for the given driving field with the uniform tau grid and
+  with graded_tau_nodes for each of the given strides. Returns a dict that contains for each
+  stride a dict with the deviations from the uniform result as in precision_report ('dipole',
+  'spectrum') and the speedup of the plan execution ('speedup'). """
+
+  if weights is None and wavelength is None:
+    weights = get_weights(t)
+  elif weights is None and wavelength is not None:
+    weights = get_weights(t, wavelength/c)
+  T = 2*np.pi if wavelength is None else wavelength/c
+
+  dims = Et.shape[1] if len(Et.shape)>1 else 1
+  if dipole_elements is None: dipole_elements = dipole_elements_H(dims, ip=ip, wavelength=wavelength)
+
+  def compute(tau_nodes, quadrature):
+    plan = lewenstein_plan(t,ip,dims,wavelength,weights,dipole_elements,epsilon_t,tau_nodes,quadrature)
+    start = time.time()
+    d = plan.execute(Et,at)
+    duration = time.time()-start
+    d = np.asarray(d, np.double).reshape(len(t), -1)
+    spectrum = np.sum(abs(np.fft.fft(d, axis=0))**2, axis=1)
+    return d, spectrum, duration
+
+  reference_d, reference_spectrum, reference_duration = compute(None, 'trapezoid')
+  significant = reference_spectrum > dynamic_range*np.max(reference_spectrum)
+
+  report = {}
+  for stride in strides:
+    tau_nodes = graded_tau_nodes(t[:len(weights)],T,periods_fine,stride)
+    d, spectrum, duration = compute(tau_nodes, quadrature)
+    report[stride] = {
+      'dipole': np.max(abs(d-reference_d)) / np.max(abs(reference_d)),
+      'spectrum': np.max(abs(spectrum-reference_spectrum)[significant] / reference_spectrum[significant]),
+      'speedup': reference_duration / duration,
+    }
+
+  return report
+
+def select_tau_grid(t,Et,ip,tolerance,wavelength=None,weights=None,periods_fine=.5,strides=[2,4,8,16],quadrature='trapezoid',**kwargs):
+  """ Returns the nodes of the coarsest graded tau grid whose dipole response deviates from the
+  uniform one by at most tolerance (relative to its maximum) for the given driving field, or None
+  if there is none. Further arguments are passed to tau_grid_report. """
+
+  if weights is None and wavelength is None:
+    weights = get_weights(t)
+  elif weights is None and wavelength is not None:
+    weights = get_weights(t, wavelength/c)
+  T = 2*np.pi if wavelength is None else wavelength/c
+
+  report = tau_grid_report(t,Et,ip,wavelength,weights,periods_fine=periods_fine,strides=strides,quadrature=quadrature,**kwargs)
+  accepted = [stride for stride in strides if report[stride]['dipole']<=tolerance]
+  if not accepted: return None
+  return graded_tau_nodes(t[:len(weights)],T,periods_fine,max(accepted))
+
+# compare the approximations of the phase factor to the exact one
+def accuracy_report(t,Et,ip,wavelength=None,weights=None,at=None,dipole_elements=None,epsilon_t=1e-4,dynamic_range=1e-6,accuracies=[3e-12,1e-7],tau_nodes=None,quadrature='trapezoid'):
+  """ Computes the dipole response for the given driving field with the exact phase factor and
+  with each of the given accuracies of lewenstein_plan. Returns a dict that contains for each
+  accuracy a dict with the deviations from the exact result as in precision_report ('dipole',
+  'spectrum') and the speedup of the plan execution ('speedup'). """
+
+  dims = Et.shape[1] if len(Et.shape)>1 else 1
+  if dipole_elements is None: dipole_elements = dipole_elements_H(dims, ip=ip, wavelength=wavelength)
+
+  def compute(accuracy):
+    plan = lewenstein_plan(t,ip,dims,wavelength,weights,dipole_elements,epsilon_t,tau_nodes,quadrature,accuracy=accuracy)
+    start = time.time()
+    d = plan.execute(Et,at)
+    duration = time.time()-start
+    d = np.asarray(d, np.double).reshape(len(t), -1)
+    spectrum = np.sum(abs(np.fft.fft(d, axis=0))**2, axis=1)
+    return d, spectrum, duration
+
+  reference_d, reference_spectrum, reference_duration = compute(0)
+  significant = reference_spectrum > dynamic_range*np.max(reference_spectrum)
+
+  report = {}
+  for accuracy in accuracies:
+    d, spectrum, duration = compute(accuracy)
+    report[accuracy] = {
+      'dipole': np.max(abs(d-reference_d)) / np.max(abs(reference_d)),
+      'spectrum': np.max(abs(spectrum-reference_spectrum)[significant] / reference_spectrum[significant]),
+      'speedup': reference_duration / duration,
+    }
+
+  return report
+
 # wrap yakovlev function
-lewenstein_so.yakovlev_double.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p]
-lewenstein_so.yakovlev_double.restype = None
+lewenstein_so.yakovlev_double_accuracy.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p, ctypes.c_int]
+lewenstein_so.yakovlev_double_accuracy.restype = None
 
-def yakovlev(t,Et,ip,at,wavelength=None,weights=None,dtfraction=None):
+def yakovlev(t,Et,ip,at,wavelength=None,weights=None,dtfraction=None,accuracy=0):
   # default value for weights
   if weights is None and wavelength is None:
     weights = get_weights(t)
@@ -243,11 +981,12 @@ def yakovlev(t,Et,ip,at,wavelength=None,weights=None,dtfraction=None):
   assert at.size==N
   assert dtfraction.size==N
   assert Et.shape[0]==N
-  assert dims==1
+  assert dims in (1,2,3)
   assert Et.size==N*dims
 
   # call C function
-  lewenstein_so.yakovlev_double(dims, N, t.ctypes.data, Et.ctypes.data, weights_length, weights.ctypes.data, min_tau_i, dtfraction.ctypes.data, at.ctypes.data, ip, output.ctypes.data)
+  assert accuracy>=0
+  lewenstein_so.yakovlev_double_accuracy(dims, N, t.ctypes.data, Et.ctypes.data, weights_length, weights.ctypes.data, min_tau_i, dtfraction.ctypes.data, at.ctypes.data, ip, output.ctypes.data, lewenstein_so.lewenstein_accuracy_for(accuracy))
 
   # unit conversion
   if wavelength is not None:
@@ -297,6 +1036,178 @@ if __name__=="__main__":
   assert np.allclose(d, reference_d, atol=1e-4)
   print("Test passed")
 
+  # batched computation must reproduce single-point results
+  Et_batch = np.array([Et, -Et, 2*Et])
+  d_batch = lewenstein_batch(t,Et_batch,ip,None,weights)
+  for point in range(Et_batch.shape[0]):
+    assert np.allclose(d_batch[point], lewenstein(t,Et_batch[point],ip,None,weights))
+  print("Batch test passed")
+
+  # plan must reproduce results of lewenstein
+  plan = lewenstein_plan(t,ip,1,None,weights)
+  for point in range(Et_batch.shape[0]):
+    assert np.allclose(plan.execute(Et_batch[point]), lewenstein(t,Et_batch[point],ip,None,weights))
+  print("Plan test passed")
+
+  # single and mixed precision must agree with double precision to a few digits
+  for precision in ['single', 'mixed']:
+    assert np.allclose(lewenstein(t,Et,ip,None,weights,precision=precision), d, rtol=1e-4, atol=1e-4)
+    assert np.allclose(lewenstein_batch(t,Et_batch,ip,None,weights,precision=precision), d_batch, rtol=1e-4, atol=1e-4)
+  print("Precision test passed")
+
+  # a graded tau grid containing all tau_i must reproduce the uniform plan;
+  # Filon quadrature must agree with the trapezoidal rule for slow phases
+  t = np.linspace(0,4*np.pi,400)
+  Et = 0.1*np.sin(t)
+  weights = get_weights(t)
+  assert np.all(graded_tau_nodes(np.arange(7.),periods_fine=3/(2*np.pi),stride=2)==[0,1,2,3,5,6])
+  plan = lewenstein_plan(t,ip,1,None,weights)
+  plan_nodes = lewenstein_plan(t,ip,1,None,weights,tau_nodes=graded_tau_nodes(t[:len(weights)],stride=1))
+  plan_filon = lewenstein_plan(t,ip,1,None,weights,quadrature='filon')
+  assert np.all(plan_nodes.execute(Et)==plan.execute(Et))
+  assert np.allclose(plan_filon.execute(Et), plan.execute(Et), rtol=1e-3, atol=1e-3*np.max(abs(plan.execute(Et))))
+  print("Tau grid test passed")
+
+  # tabulated dipole elements of the hydrogen-like potential must agree with the analytic ones
+  alpha = 2*ip
+  Dp = np.arange(0,10,1e-3)
+  Dd = 1j*(2**(7/2)*alpha**(5/4)/np.pi) * Dp / (Dp**2+alpha)**3
+  d_H = lewenstein(t,Et,ip,None,weights)
+  d_tab = lewenstein(t,Et,ip,None,weights,dipole_elements=dipole_elements_tabulated(1, Dp, Dd))
+  assert np.allclose(d_tab, d_H, rtol=1e-5, atol=1e-5*np.max(abs(d_H)))
+  print("Tabulated dipole elements test passed")
+
+  # periodic mode must reproduce the last period of a repeated driving field
+  t_period = t[:200]
+  Et_period = 0.1*np.sin(t_period) + 0.03*np.cos(3*t_period)
+  repetitions = 4
+  t_repeated = t[0] + (t[1]-t[0])*np.arange(repetitions*t_period.size)
+  weights = get_weights(t_repeated, periods_one=2)
+  d_repeated = lewenstein_plan(t_repeated,ip,1,None,weights).execute(np.tile(Et_period, repetitions))[-t_period.size:]
+  d_periodic = lewenstein_plan(t_period,ip,1,None,weights,periodic=True).execute(Et_period)
+  assert np.allclose(d_periodic, d_repeated, rtol=1e-10, atol=1e-10*np.max(abs(d_repeated)))
+  print("Periodic test passed")
+
+  # the ground state amplitude computed from the ionization rate inside the plan must agree with
+  # interpolation and cumulative trapezoidal integration in numpy
+  Et_batch = np.array([Et, 0.5*Et])
+  E_table = np.linspace(0, 0.2, 50)
+  rate = ionization_rate_table(E_table, 0.01*E_table**2)
+  w = np.interp(abs(Et_batch), E_table, 0.01*E_table**2)
+  at = np.sqrt(np.exp(-np.concatenate([np.zeros((2,1)), np.cumsum((w[:,1:]+w[:,:-1])/2*np.diff(t), axis=1)], axis=1)))
+  assert np.allclose(rate.ground_state_amplitude(t, Et_batch), at, rtol=1e-12, atol=0)
+  weights = get_weights(t)
+  d_rate = lewenstein_plan(t,ip,1,None,weights,ionization_rate=rate).execute_batch(Et_batch)
+  d_at = lewenstein_plan(t,ip,1,None,weights).execute_batch(Et_batch, at)
+  assert np.allclose(d_rate, d_at, rtol=1e-12, atol=1e-12*np.max(abs(d_at)))
+  print("Ionization rate test passed")
+
+  # instrumentation must count all pairs (t_i, tau_i) up to the end of the weights, and report
+  # progress up to the end
+  progress = []
+  stats = lewenstein_stats(progress.append, progress_interval=0)
+  plan = lewenstein_plan(t,ip,1,None,weights)
+  plan.set_stats(stats)
+  plan.execute_batch(Et_batch)
+  pairs = Et_batch.shape[0] * np.sum(np.minimum(np.arange(2, t.size+1), weights.size))
+  info = stats.get()
+  assert info['calls']==1 and info['points']==Et_batch.shape[0]
+  assert info['evaluations']==pairs and info['skipped_evaluations']==0
+  assert np.sum(info['thread_evaluations'])==pairs
+  assert progress[-1]==1 and np.all(np.diff(progress)>=0)
+  plan = lewenstein_plan(t,ip,1,None,weights,tau_nodes=graded_tau_nodes(t[:len(weights)]))
+  plan.set_stats(stats)
+  stats.reset()
+  plan.execute_batch(Et_batch)
+  info = stats.get()
+  assert info['evaluations']+info['skipped_evaluations']==pairs and info['skipped_evaluations']>0
+  print("Instrumentation test passed")
+
+  # strided views, caller-provided output arrays and futures must reproduce contiguous arrays,
+  # also with unit conversion
+  plan = lewenstein_plan(t,ip,1,None,weights)
+  d_batch = plan.execute_batch(Et_batch)
+  stacked = np.empty((t.size, 4))
+  stacked[:,1::2] = Et_batch.T
+  out = np.zeros((3, 2, t.size))
+  view = out[1]
+  assert plan.execute_batch(stacked[:,1::2].T, out=view) is view
+  assert np.all(out[1]==d_batch) and np.all(out[[0,2]]==0)
+  assert np.all(plan.execute_batch(Et_batch[::-1], np.ones((2,t.size))[:,::-1])==d_batch[::-1])
+  futures = [plan.execute_async(Et_batch[i::2]) for i in range(2)]
+  assert np.all(futures[0].result()==d_batch[:1]) and np.all(futures[1].result()==d_batch[1:])
+  future = plan.execute_async(Et_batch)
+  assert np.all(plan.execute(Et_batch[1])==d_batch[1]) and np.all(future.result()==d_batch)
+  wavelength = 1000e-9
+  t_SI = sau_convert(t, 't', 'SI', wavelength)
+  Et_SI = sau_convert(np.asfortranarray(Et_batch), 'E', 'SI', wavelength)
+  plan_SI = lewenstein_plan(t_SI,sau_convert(ip,'U','SI',wavelength),1,wavelength,weights)
+  assert np.allclose(plan_SI.execute_batch(Et_SI), sau_convert(d_batch, 'd', 'SI', wavelength), rtol=1e-12, atol=0)
+  print("Strided test passed")
+
+  # results must not depend on the number of threads or their binding
+  set_threads(3)
+  assert get_threads()==3
+  d_threads = plan.execute_batch(np.tile(Et_batch, (3,1)))
+  set_affinity(sorted(os.sched_getaffinity(0)) if hasattr(os, 'sched_getaffinity') else [0])
+  assert np.all(plan.execute_batch(Et_batch)==d_batch)
+  set_affinity([])
+  set_threads(0)
+  assert get_threads()>=1
+  assert np.all(d_threads==np.tile(d_batch, (3,1)))
+  print("Threads test passed")
+
+  # several species computed in one pass must reproduce separate plans, with shared and with
+  # their own dipole elements, and with per-species ground state amplitudes
+  plan = lewenstein_plan(t,ip,1,None,weights)
+  assert plan.add_species(0.8*ip, plan._dipole_elements)==1
+  assert plan.add_species(1.5*ip)==2
+  at = np.array([np.ones(t.size), np.cos(np.linspace(0,1,t.size)), np.ones(t.size)])[:,np.newaxis]
+  d_species = plan.execute_species(Et_batch, at)
+  assert d_species.shape==(3,)+Et_batch.shape
+  d_separate = [lewenstein_plan(t,ip,1,None,weights).execute_batch(Et_batch),
+                lewenstein_plan(t,0.8*ip,1,None,weights,dipole_elements=plan._dipole_elements).execute_batch(Et_batch, np.tile(at[1], (2,1))),
+                lewenstein_plan(t,1.5*ip,1,None,weights).execute_batch(Et_batch)]
+  for s in range(3):
+    assert np.allclose(d_species[s], d_separate[s], rtol=1e-12, atol=1e-12*np.max(abs(d_separate[s])))
+  try:
+    plan.add_species(ip, dipole_elements_tabulated(1, Dp, Dd))
+    assert False
+  except ValueError:
+    pass
+  print("Species test passed")
+
+  # the dipole responses of several windows computed in one pass must reproduce separate plans,
+  # and the short and the long trajectories must add up to both of them
+  windows = [get_weights(t), weights_short_trajectory(t), weights_long_trajectory(t)]
+  d_windows = trajectory_decomposition(t, Et_batch, ip, windows=windows, at=at[1,0])
+  assert d_windows.shape==(3,)+Et_batch.shape
+  for window, d_window in zip(windows, d_windows):
+    weights = np.zeros(windows[0].size)
+    weights[:window.size] = window
+    d_separate = lewenstein_plan(t,ip,1,None,weights).execute_batch(Et_batch, at[1,0])
+    assert np.allclose(d_window, d_separate, rtol=1e-12, atol=1e-12*np.max(abs(d_separate)))
+  weights = np.zeros(windows[0].size)
+  weights[:windows[1].size] += windows[1]
+  weights[:windows[2].size] += windows[2]
+  d_both = lewenstein_plan(t,ip,1,None,weights).execute_batch(Et_batch, at[1,0])
+  assert np.allclose(d_windows[1]+d_windows[2], d_both, rtol=1e-12, atol=1e-12*np.max(abs(d_both)))
+  try:
+    lewenstein_plan(t,ip,1,None,windows[1]).add_window(windows[0])
+    assert False
+  except ValueError:
+    pass
+  print("Trajectory decomposition test passed")
+
+  # the approximated phase factors must stay close to the exact one
+  for accuracy, errors in accuracy_report(t,Et,ip,None,weights).items():
+    assert errors['dipole'] < 1e3*accuracy
+  at = np.cos(np.linspace(0,1,t.size))
+  d_yakovlev = yakovlev(t,Et,ip,at,None,weights)
+  for accuracy in [3e-12, 1e-7]:
+    assert np.allclose(yakovlev(t,Et,ip,at,None,weights,accuracy=accuracy), d_yakovlev, rtol=0, atol=1e3*accuracy*np.max(abs(d_yakovlev)))
+  print("Accuracy test passed")
+
   # plot dipole response for pulse (using SI units)
   wavelength = 1000e-9
   T = wavelength/c
@@ -315,9 +1226,20 @@ if __name__=="__main__":
   Dd = 1j*(2**(7/2)*alpha**(5/4)/np.pi) * Dp / (Dp**2+alpha)**3
   dint = dipole_elements_symmetric_interpolate(1, Dp, Dd)
   d2 = lewenstein(t,Et,ip,wavelength,dipole_elements=dint)
+  d3 = lewenstein(t,Et,ip,wavelength,dipole_elements=dipole_elements_tabulated(1, Dp, Dd))
+
+  for precision, errors in precision_report(t,Et,ip,wavelength).items():
+    print("%s precision: dipole error %.1e, spectrum error %.1e" % (precision, errors['dipole'], errors['spectrum']))
+
+  for stride, errors in sorted(tau_grid_report(t,Et,ip,wavelength).items()):
+    print("tau grid stride %d: dipole error %.1e, spectrum error %.1e, speedup %.1f" % (stride, errors['dipole'], errors['spectrum'], errors['speedup']))
+
+  for accuracy, errors in sorted(accuracy_report(t,Et,ip,wavelength).items()):
+    print("accuracy %.0e: dipole error %.1e, spectrum error %.1e, speedup %.2f" % (accuracy, errors['dipole'], errors['spectrum'], errors['speedup']))
 
   pylab.semilogy(np.fft.fftfreq(len(t), t[1]-t[0])/(1/T), abs(np.fft.fft(d))**2)
   pylab.semilogy(np.fft.fftfreq(len(t), t[1]-t[0])/(1/T), abs(np.fft.fft(d2))**2, label='interpolated d')
+  pylab.semilogy(np.fft.fftfreq(len(t), t[1]-t[0])/(1/T), abs(np.fft.fft(d3))**2, label='tabulated d')
   pylab.legend()
   pylab.xlim((0,100))
   pylab.show()
@@ -0,0 +1,227 @@
+// This file provides helpers for writing loops that the compiler is able to
+// vectorize, and for compiling such loops for several instruction sets of
+// which the best one supported by the CPU is chosen at runtime.
+// Vectorizable loops must not contain branches or calls to library functions,
+// therefore sine and cosine are provided as polynomial approximations here.
+// Functions that contain such loops are written once as SIMD_INLINE template
+// and then instantiated by wrappers marked with SIMD_TARGET_AVX2 or
+// SIMD_TARGET_AVX512, see lewenstein_tau_sum in lewenstein.hpp.
+
+// include guard
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+  #include <malloc.h>
+#endif
+
+// runtime dispatch is only available for GCC/Clang on x86; elsewhere, only the
+// generic code path is compiled (which is vectorized for the baseline
+// instruction set of the target, e.g. SSE2 on x86-64)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(SIMD_NO_DISPATCH)
+  #define SIMD_DISPATCH
+  #define SIMD_INLINE inline __attribute__((always_inline))
+  #define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+  #define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,fma")))
+#else
+  #define SIMD_INLINE inline
+#endif
+
+// instruction set levels, in ascending order
+enum simd_isa { SIMD_GENERIC=0, SIMD_AVX2=1, SIMD_AVX512=2 };
+
+// returns the best instruction set level supported by the CPU; it can be
+// lowered by setting the environment variable HHGMAX_SIMD to generic or avx2
+inline simd_isa simd_detect() {
+  simd_isa isa = SIMD_GENERIC;
+
+#ifdef SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) isa = SIMD_AVX2;
+  if (isa==SIMD_AVX2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) isa = SIMD_AVX512;
+#endif
+
+  const char *requested = getenv("HHGMAX_SIMD");
+  if (requested) {
+    if (!strcmp(requested,"generic")) isa = SIMD_GENERIC;
+    else if (!strcmp(requested,"avx2") && isa>SIMD_AVX2) isa = SIMD_AVX2;
+  }
+
+  return isa;
+}
+
+// aligned memory for arrays accessed by vectorized loops
+inline void *simd_malloc(size_t size) {
+#ifdef _WIN32
+  return _aligned_malloc(size, 64);
+#else
+  void *ptr;
+  if (posix_memalign(&ptr, 64, size)) return 0;
+  return ptr;
+#endif
+}
+
+inline void simd_free(void *ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+// arguments of simd_sincos must not be larger than this, otherwise the
+// reduction to [-pi/4,pi/4] gets inaccurate
+#define SIMD_SINCOS_MAX 1.0e8
+
+// reduces x to r = x - q*pi/2 with |r| <= pi/4, with q rounded to nearest by
+// adding and subtracting 1.5*2^52 (needs default rounding mode and no
+// -ffast-math), using the three-part reduction by pi/2 of the Cephes library
+template <typename Type>
+SIMD_INLINE Type simd_sincos_reduce(Type x, int &qi) {
+  const Type magic = 6755399441055744.0;
+  Type q = (x * 0.63661977236758134308 + magic) - magic;
+  qi = (int)q;
+  return ((x - q*1.57079625129699707031) - q*7.54978941586159635335e-8) - q*5.39030285815811905290e-15;
+}
+
+// sets sine and cosine of x from those of the reduced argument: swap for odd
+// q, change signs according to q
+template <typename Type>
+SIMD_INLINE void simd_sincos_quadrant(int qi, Type sr, Type cr, Type &s, Type &c) {
+  Type swap = Type(qi & 1);
+  s = (sr + swap*(cr-sr)) * Type(1 - (qi & 2));
+  c = (cr + swap*(sr-cr)) * Type(1 - ((qi+1) & 2));
+}
+
+// sine and cosine without branches, using the polynomials of the Cephes
+// library; accurate to about 1e-16 relative to the larger of both results
+template <typename Type>
+SIMD_INLINE void simd_sincos(Type x, Type &s, Type &c) {
+  int qi;
+  Type r = simd_sincos_reduce(x, qi);
+
+  // polynomials for |r| <= pi/4
+  Type z = r*r;
+  Type sr = r + r*z*((((((1.58962301576546568060e-10*z - 2.50507477628578072866e-8)*z + 2.75573136213857245213e-6)*z - 1.98412698295895385996e-4)*z + 8.33333333332211858878e-3)*z) - 1.66666666666666307295e-1);
+  Type cr = Type(1) - Type(0.5)*z + z*z*((((((-1.13585365213876817300e-11*z + 2.08757008419747316778e-9)*z - 2.75573141792967388112e-7)*z + 2.48015872888517045348e-5)*z - 1.38888888888730564116e-3)*z) + 4.16666666666665929218e-2);
+
+  simd_sincos_quadrant(qi, sr, cr, s, c);
+}
+
+// single precision variant, with the reduction split into parts that have few
+// enough bits for q*part to be exact in single precision, and the polynomials
+// of the single precision Cephes functions; accurate to about 1e-7 for
+// arguments up to SIMD_SINCOS_MAX_FLOAT
+#define SIMD_SINCOS_MAX_FLOAT 1.0e5f
+
+template <>
+SIMD_INLINE void simd_sincos<float>(float x, float &s, float &c) {
+  const float magic = 12582912.0f; // 1.5*2^23
+  float q = (x * 0.63661977236758134308f + magic) - magic;
+  int qi = (int)q;
+  float r = ((x - q*1.5703125f) - q*4.837512969970703125e-4f) - q*7.54978995489188216e-8f;
+
+  float z = r*r;
+  float sr = r + r*z*((-1.9515295891e-4f*z + 8.3321608736e-3f)*z - 1.6666654611e-1f);
+  float cr = 1.0f - 0.5f*z + z*z*((2.443315711809948e-5f*z - 1.388731625493765e-3f)*z + 4.166664568298827e-2f);
+
+  simd_sincos_quadrant(qi, sr, cr, s, c);
+}
+
+// Accuracy tiers of the approximations below, chosen at run time (e.g. by
+// lewenstein_plan::set_accuracy) and passed on as template argument, so that
+// each tier is a separate loop without branches:
+//   SIMD_ACCURACY_EXACT - full double precision (simd_sincos, 1/sqrt)
+//   SIMD_ACCURACY_HIGH  - errors below SIMD_ACCURACY_HIGH_ERROR
+//   SIMD_ACCURACY_FAST  - errors below SIMD_ACCURACY_FAST_ERROR
+// The errors of the sine and cosine are absolute (for arguments up to
+// SIMD_SINCOS_MAX), those of the reciprocal square root relative. In single
+// precision, all tiers use the single precision functions.
+enum simd_accuracy { SIMD_ACCURACY_EXACT=0, SIMD_ACCURACY_HIGH=1, SIMD_ACCURACY_FAST=2 };
+
+#define SIMD_ACCURACY_HIGH_ERROR 3.0e-12
+#define SIMD_ACCURACY_FAST_ERROR 1.0e-7
+
+// returns the fastest tier whose error bound is at most tolerance
+inline simd_accuracy simd_accuracy_for(double tolerance) {
+  if (tolerance>=SIMD_ACCURACY_FAST_ERROR) return SIMD_ACCURACY_FAST;
+  if (tolerance>=SIMD_ACCURACY_HIGH_ERROR) return SIMD_ACCURACY_HIGH;
+  return SIMD_ACCURACY_EXACT;
+}
+
+// sine and cosine of the given accuracy tier, with the reduction of
+// simd_sincos and polynomials of lower degree fitted on [-pi/4,pi/4]
+// (maximum errors of the polynomials: 2.5e-12 and 1.1e-13 for the tier
+// SIMD_ACCURACY_HIGH, 1.9e-9 and 7.1e-8 for the tier SIMD_ACCURACY_FAST)
+template <int accuracy, typename Type>
+SIMD_INLINE void simd_sincos_accuracy(Type x, Type &s, Type &c) {
+  if (accuracy==SIMD_ACCURACY_EXACT) {
+    simd_sincos(x, s, c);
+    return;
+  }
+
+  int qi;
+  Type r = simd_sincos_reduce(x, qi);
+
+  Type z = r*r, sr, cr;
+  if (accuracy==SIMD_ACCURACY_HIGH) {
+    sr = r + r*z*(((2.71582276537907413744e-6*z - 1.98390182660155368942e-4)*z + 8.33332813087447887845e-3)*z - 1.66666666265795015978e-1);
+    cr = Type(1) - Type(0.5)*z + z*z*(((-2.72082056888603344423e-7*z + 2.47994918339684235935e-5)*z - 1.38888836280574227804e-3)*z + 4.16666666210592576136e-2);
+  }
+  else {
+    sr = r + r*z*((-1.94934967119277362951e-4*z + 8.33195797688082023802e-3)*z - 1.66666501925265247985e-1);
+    cr = Type(1) - Type(0.5)*z + z*z*(-1.36504759429450519236e-3*z + 4.16611670901036873493e-2);
+  }
+
+  simd_sincos_quadrant(qi, sr, cr, s, c);
+}
+
+template <int accuracy>
+SIMD_INLINE void simd_sincos_accuracy(float x, float &s, float &c) {
+  simd_sincos(x, s, c);
+}
+
+// reciprocal square root of positive, finite x of the given accuracy tier:
+// the exponent is halved by integer arithmetic on the bits (with the constant
+// of Lomont, "Fast inverse square root", 2003; relative error 3.4e-2), and
+// the result refined by one step of third order (to 1.1e-4) and one more
+// step of third order (tier SIMD_ACCURACY_HIGH, to 2.8e-12) or one Newton
+// step (tier SIMD_ACCURACY_FAST, to 1.6e-8)
+template <int accuracy, typename Type>
+SIMD_INLINE Type simd_rsqrt(Type x) {
+  if (accuracy==SIMD_ACCURACY_EXACT) return Type(1)/sqrt(x);
+
+  unsigned long long bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5fe6ec85e7de30daULL - (bits>>1);
+  Type y;
+  memcpy(&y, &bits, sizeof(y));
+
+  Type e = Type(1) - x*y*y;
+  y += y*e*(Type(0.5) + Type(0.375)*e);
+  if (accuracy==SIMD_ACCURACY_HIGH) {
+    e = Type(1) - x*y*y;
+    return y + y*e*(Type(0.5) + Type(0.375)*e);
+  }
+  return y*(Type(1.5) - Type(0.5)*x*y*y);
+}
+
+template <int accuracy>
+SIMD_INLINE float simd_rsqrt(float x) {
+  if (accuracy==SIMD_ACCURACY_EXACT) return 1.0f/sqrtf(x);
+
+  unsigned int bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5f375a86u - (bits>>1);
+  float y;
+  memcpy(&y, &bits, sizeof(y));
+
+  float e = 1.0f - x*y*y;
+  y += y*e*(0.5f + 0.375f*e);
+  return y*(1.5f - 0.5f*x*y*y);
+}
+
+#endif // end of include guard
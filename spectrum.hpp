@@ -0,0 +1,104 @@
+// This file provides the last step of hhgmax_dipole_response.m natively: the
+// conversion of the time-dependent dipole response d(t) into the spectrum
+// d(omega) for the kept frequency bins, including the soft window, the
+// Fourier transform (with Matlab's sign convention, conjugated) and the
+// phase correction for a time axis starting at t0.
+// If only a few frequency bins are needed (e.g. a narrow omega_ranges
+// option), they are evaluated directly, which is cheaper than the full FFT.
+
+// include guard
+#ifndef SPECTRUM_HPP
+#define SPECTRUM_HPP
+
+#include "fft.hpp"
+
+template <typename Type>
+class dipole_spectrum {
+  private:
+    typedef complex<Type> cType;
+
+    int length;
+    vector<int> bins;
+    vector<Type> window;
+    vector<cType> factors;
+
+    // direct evaluation of the bins uses a table of the twiddle factors
+    // exp(-2*pi*i*j/length), otherwise the full FFT is computed; one bin costs
+    // length multiplications, which is compared to the estimated cost of the
+    // FFT (the measured break-even point is about 1.5-2 times the estimate)
+    bool direct;
+    vector<cType> twiddle;
+    fft<Type> full;
+
+  public:
+    // fft_length - number of samples of d(t) to be transformed
+    // bins_count, bins_data - kept frequency bins (0-based, as returned by
+    //                         hhgmax_get_omega_axis minus one)
+    // window_length, window_data - soft window applied to the last samples
+    // t0 - start of the time axis, deltat - time step
+    dipole_spectrum(int fft_length, int bins_count, const int *bins_data, int window_length, const Type *window_data, double t0, double deltat) :
+      length(fft_length), bins(bins_data, bins_data+bins_count), window(window_data, window_data+window_length),
+      direct(bins_count*(double)fft_length < 1.5*fft<Type>::cost(fft_length)),
+      full(direct ? 1 : fft_length)
+    {
+      const double pi = 4.0*atan(1.0);
+      const complex<double> i(0, 1);
+
+      // omega axis as computed by hhgmax_get_omega_axis.m; integration of fft
+      // starts at 0, we want to start at t0, therefore apply the exponential
+      // term; multiply by deltat to get units right
+      double domega = 2*pi/deltat/length;
+      factors.resize(bins_count);
+      for (int b=0; b<bins_count; b++) {
+        double omega = (bins[b]>length/2.0 ? bins[b]-length : bins[b]) * domega;
+        factors[b] = cType(exp(-i*omega*t0) * deltat);
+      }
+
+      if (direct) {
+        twiddle.resize(length);
+        for (int j=0; j<length; j++) twiddle[j] = cType(cos(2*pi*j/length), -sin(2*pi*j/length));
+      }
+    };
+
+    int size() const {
+      return (int)bins.size();
+    };
+
+    bool is_direct() const {
+      return direct;
+    };
+
+    // transforms fft_length samples d[j*stride] and stores the kept bins in
+    // output
+    void transform(const Type *d, int stride, cType *output) const {
+      const int window_start = length - (int)window.size();
+
+      if (direct) {
+        vector<Type> x(length);
+        for (int j=0; j<length; j++) x[j] = d[j*stride];
+        for (int j=window_start; j<length; j++) x[j] *= window[j-window_start];
+
+        for (size_t b=0; b<bins.size(); b++) {
+          cType sum = 0;
+          int index = 0;
+          for (int j=0; j<length; j++) {
+            sum += x[j] * twiddle[index];
+            index += bins[b];
+            if (index>=length) index -= length;
+          }
+          output[b] = conj(sum) * factors[b];
+        }
+      }
+      else {
+        vector<cType> x(length);
+        for (int j=0; j<length; j++) x[j] = d[j*stride];
+        for (int j=window_start; j<length; j++) x[j] *= window[j-window_start];
+
+        full.transform(&x[0]);
+
+        for (size_t b=0; b<bins.size(); b++) output[b] = conj(x[bins[b]]) * factors[b];
+      }
+    };
+};
+
+#endif // end of include guard
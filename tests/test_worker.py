@@ -0,0 +1,126 @@
+from __future__ import print_function
+
+# Tests sharing the work of the native dipole_response program between
+# several --worker processes: the slices must be identical to those of a
+# single process, no files may be left in the queue directory, and the blocks
+# of a killed worker must be computed by the others once its leases expire.
+# The integration along z must be redone by every run of the workers.
+# Needs the dipole_response program built by make in the HHGmax directory.
+
+import os
+import sys
+import time
+import shutil
+import signal
+import tempfile
+import subprocess
+import numpy as np
+
+program = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'dipole_response')
+
+# writes a Level 4 .mat file of real double matrices
+def save_mat4(filename, variables):
+  with open(filename, 'wb') as f:
+    for name, value in variables.items():
+      value = np.atleast_2d(np.asarray(value, dtype='<f8'))
+      f.write(np.array([0, value.shape[0], value.shape[1], 0, len(name)+1], dtype='<i4').tobytes())
+      f.write(name.encode('ascii') + b'\0')
+      f.write(value.tobytes(order='F'))
+
+def write_config(directory, cache, backend, lease_seconds=600, pressure=None):
+  filename = os.path.join(directory, 'config_%s.txt' % cache)
+  with open(filename, 'w') as f:
+    if pressure is not None:
+      f.write('propagation.pressure = %g\n' % pressure)
+      f.write("propagation.output = '%s'\n" % os.path.join(directory, cache + '.mat'))
+    f.write('''wavelength = 1e-3
+ionization_potential = 12.13
+components = 1
+tau_interval_length = 1.0
+tau_window_length = 0.5
+t_window_length = 0.5
+omega_ranges = [0 20; 25 30]
+driving_field = 'hhgmax.gh_driving_field'
+axes = '%s'
+zv = [-0.1 0 0.1]
+peak_intensity = 1e14
+beam_waist = 0.03
+mode = 'TEM00'
+pulse_shape = 'constant'
+cache.directory = '%s'
+cache.backend = '%s'
+queue.block_points = 4
+queue.lease_seconds = %d
+queue.poll_seconds = 1
+''' % (os.path.join(directory, 'axes.mat'), os.path.join(directory, cache), backend, lease_seconds))
+  return filename
+
+def start(config, worker=True):
+  args = [program, '--worker', config] if worker else [program, config]
+  return subprocess.Popen(args, stdout=open(os.devnull, 'w'))
+
+def slice_files(cache):
+  return sorted(name for name in os.listdir(cache) if name.startswith('dipole_response_z'))
+
+def read(filename):
+  with open(filename, 'rb') as f:
+    return f.read()
+
+def compare(cache, reference):
+  assert slice_files(cache)==slice_files(reference)
+  assert len(slice_files(reference))>0
+  for name in slice_files(reference):
+    assert read(os.path.join(cache, name))==read(os.path.join(reference, name)), name
+  assert os.listdir(os.path.join(cache, 'queue'))==[]
+
+directory = tempfile.mkdtemp()
+try:
+  t = np.linspace(-4*2*np.pi, 4*2*np.pi, 1000)
+  xv = np.linspace(-0.02, 0.02, 4)
+  save_mat4(os.path.join(directory, 'axes.mat'), {'t_cmc': t, 'xv': xv, 'yv': xv})
+
+  for backend in ['fallback', 'tiled']:
+    reference = write_config(directory, 'reference_' + backend, backend)
+    assert start(reference, worker=False).wait()==0
+
+    # several workers started at the same time
+    config = write_config(directory, 'workers_' + backend, backend)
+    workers = [start(config) for i in range(3)]
+    assert [w.wait() for w in workers]==[0]*3
+    compare(os.path.join(directory, 'workers_' + backend), os.path.join(directory, 'reference_' + backend))
+
+    # a worker killed while holding a lease; its blocks are computed by the
+    # other workers after the lease expired
+    config = write_config(directory, 'killed_' + backend, backend, lease_seconds=2)
+    queue = os.path.join(directory, 'killed_' + backend, 'queue')
+    killed = start(config)
+    while killed.poll() is None and not (os.path.isdir(queue) and [name for name in os.listdir(queue) if name.endswith('.lease')]):
+      time.sleep(0.01)
+    assert killed.poll() is None
+    killed.send_signal(signal.SIGKILL)
+    killed.wait()
+    leases = [name for name in os.listdir(queue) if name.endswith('.lease')]
+    assert len(leases)>0
+
+    workers = [start(config) for i in range(2)]
+    assert [w.wait() for w in workers]==[0]*2
+    compare(os.path.join(directory, 'killed_' + backend), os.path.join(directory, 'reference_' + backend))
+
+  # integration along z by the workers, repeated with another pressure on the
+  # same cache
+  for pressure in [1, 2]:
+    reference = write_config(directory, 'propagation_reference', 'tiled', pressure=pressure)
+    assert start(reference, worker=False).wait()==0
+
+    config = write_config(directory, 'propagation_workers', 'tiled', pressure=pressure)
+    workers = [start(config) for i in range(3)]
+    assert [w.wait() for w in workers]==[0]*3
+    compare(os.path.join(directory, 'propagation_workers'), os.path.join(directory, 'propagation_reference'))
+    output = read(os.path.join(directory, 'propagation_workers.mat'))
+    assert output==read(os.path.join(directory, 'propagation_reference.mat'))
+    if pressure==1: first_output = output
+    else: assert output!=first_output
+finally:
+  shutil.rmtree(directory)
+
+print('ok')
@@ -0,0 +1,107 @@
+// This file provides the thread settings of the native code: the number of
+// threads of its parallel regions and optionally the CPUs the threads are
+// bound to. Their threads are the persistent team of the OpenMP runtime,
+// which is kept alive between the parallel regions, so with a fixed number
+// of threads, the same threads (with the same binding, and the memory they
+// touched first) are reused by all calls. On NUMA machines, each thread is
+// then close to the workspaces it initializes (see lewenstein_plan), and
+// several processes on one node can be given disjoint sets of CPUs instead
+// of oversubscribing them. Binding threads is only implemented for Linux.
+
+// include guard
+#ifndef THREADS_HPP
+#define THREADS_HPP
+
+#include <vector>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+#ifdef __linux__
+  #include <sched.h>
+#endif
+
+struct lewenstein_thread_settings {
+  int threads;          // 0 for the default of the OpenMP runtime
+  std::vector<int> cpus; // thread i is bound to cpus[i % cpus.size()]
+  int generation;       // incremented on every change of cpus
+
+  lewenstein_thread_settings() : threads(0), generation(0) {};
+};
+
+inline lewenstein_thread_settings &lewenstein_threads_settings() {
+  static lewenstein_thread_settings settings;
+  return settings;
+}
+
+// sets the number of threads of the following calls; 0 restores the default
+// (e.g. OMP_NUM_THREADS)
+inline void lewenstein_set_threads(int threads) {
+  lewenstein_threads_settings().threads = threads>0 ? threads : 0;
+}
+
+// the number of threads of the following calls
+inline int lewenstein_get_threads() {
+  const int threads = lewenstein_threads_settings().threads;
+#ifdef _OPENMP
+  return threads>0 ? threads : omp_get_max_threads();
+#else
+  (void)threads;
+  return 1;
+#endif
+}
+
+// number of the calling thread within its team, and size of the team
+inline int lewenstein_thread_num() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+inline int lewenstein_team_size() {
+#ifdef _OPENMP
+  return omp_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
+// binds thread i of the following parallel regions to the CPU cpus[i % n];
+// n=0 switches the binding off (threads that were bound keep their binding);
+// returns false if binding is not supported on this platform
+inline bool lewenstein_set_affinity(int n, const int *cpus) {
+  lewenstein_thread_settings &settings = lewenstein_threads_settings();
+  settings.cpus.assign(cpus, cpus+n);
+  settings.generation++;
+#ifdef __linux__
+  return true;
+#else
+  return n==0;
+#endif
+}
+
+// called by each thread at the start of a parallel region: binds the thread
+// to its CPU, unless it is already bound to it
+inline void lewenstein_bind_thread() {
+#if defined(__linux__) && defined(_OPENMP)
+  static int bound_generation = 0, bound_thread = -1;
+  #pragma omp threadprivate(bound_generation, bound_thread)
+
+  const lewenstein_thread_settings &settings = lewenstein_threads_settings();
+  const int thread = lewenstein_thread_num();
+  if (settings.cpus.empty() || (bound_generation==settings.generation && bound_thread==thread)) return;
+
+  const int cpu = settings.cpus[thread % settings.cpus.size()];
+  if (cpu<0 || cpu>=CPU_SETSIZE) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+  bound_generation = settings.generation;
+  bound_thread = thread;
+#endif
+}
+
+#endif // end of include guard
@@ -0,0 +1,264 @@
+// This file implements the 'tiled' backend of the dipole response cache (see
+// hhgmax_cache_file.m), which stores the spectra of all points of a z slice
+// in a single file that can be filled point by point and read by omega range
+// without transposing it first.
+//
+// File format (all numbers little-endian):
+//   header of 16 uint64 values (128 bytes):
+//     0: magic, the characters HHGCACHE
+//     1: format version (1)
+//     2-5: xn, yn, components, omegan
+//     6-7: tile_points, tile_omega
+//     8: finished flag (1 when all points were written)
+//     9-15: reserved (0)
+//   followed by tiles of tile_points x components x tile_omega complex
+//   doubles (real and imaginary part interleaved). Points are numbered
+//   p = yi + yn*xi (0-based), so that point blocks are pb = p / tile_points
+//   and omega blocks are ob = omega_i / tile_omega. The tile (ob, pb) starts
+//   at byte 128 + (ob*point_blocks + pb)*tile_bytes, and within a tile, the
+//   value for (p % tile_points, component, omega_i % tile_omega) has index
+//   ((p_in*components + c)*tile_omega + w) (in complex numbers). Tiles at the
+//   edges are padded to full size.
+//
+// Writing a point thus touches one contiguous run of components*tile_omega
+// values per omega block, and reading an omega range reads whole tiles.
+// The file is accessed by memory mapping, so that different threads may write
+// different points concurrently.
+
+// include guard
+#ifndef TILED_CACHE_HPP
+#define TILED_CACHE_HPP
+
+#include <algorithm>
+#include <complex>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/types.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// default tile size; a tile then has 64 kB per component
+#define TILED_CACHE_TILE_POINTS 64
+#define TILED_CACHE_TILE_OMEGA 64
+
+#define TILED_CACHE_HEADER_SIZE 128
+#define TILED_CACHE_VERSION 1
+
+class tiled_cache_file {
+  private:
+    string error;
+    unsigned long long header[16];
+    unsigned char *map;
+    size_t map_size;
+
+#ifdef _WIN32
+    HANDLE file_handle, mapping_handle;
+#else
+    int fd;
+#endif
+
+    int point_blocks() const {
+      return (int)((header[2]*header[3] + header[6]-1) / header[6]);
+    }
+
+    int omega_blocks() const {
+      return (int)((header[5] + header[7]-1) / header[7]);
+    }
+
+    size_t tile_size() const {
+      return (size_t)(header[6]*header[4]*header[7]); // in complex numbers
+    }
+
+    complex<double> *tile(int ob, int pb) const {
+      return (complex<double> *)(map + TILED_CACHE_HEADER_SIZE) + ((size_t)ob*point_blocks() + pb)*tile_size();
+    }
+
+    bool map_file(const string &filename, bool create, bool writable) {
+#ifdef _WIN32
+      file_handle = CreateFileA(filename.c_str(), writable ? GENERIC_READ|GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, 0, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+      if (file_handle==INVALID_HANDLE_VALUE) return fail("cannot open " + filename);
+
+      if (!create) {
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_handle, &size);
+        map_size = (size_t)size.QuadPart;
+      }
+      mapping_handle = CreateFileMappingA(file_handle, 0, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)((unsigned long long)map_size>>32), (DWORD)map_size, 0);
+      if (!mapping_handle) return fail("cannot map " + filename);
+      map = (unsigned char *)MapViewOfFile(mapping_handle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, map_size);
+      if (!map) return fail("cannot map " + filename);
+#else
+      fd = ::open(filename.c_str(), writable ? (O_RDWR | (create ? O_CREAT|O_TRUNC : 0)) : O_RDONLY, 0666);
+      if (fd<0) return fail("cannot open " + filename);
+
+      if (create) {
+        // the file is extended without writing, so that it is sparse
+        if (ftruncate(fd, (off_t)map_size)) return fail("cannot allocate " + filename);
+      }
+      else {
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size<0) return fail("cannot open " + filename);
+        map_size = (size_t)size;
+      }
+      if (map_size<TILED_CACHE_HEADER_SIZE) return fail(filename + " is not a tiled cache file");
+
+      void *ptr = mmap(0, map_size, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr==MAP_FAILED) return fail("cannot map " + filename);
+      map = (unsigned char *)ptr;
+#endif
+      return true;
+    }
+
+    bool fail(const string &message) {
+      error = message;
+      close();
+      return false;
+    }
+
+  public:
+    tiled_cache_file() : map(0), map_size(0) {
+#ifdef _WIN32
+      file_handle = INVALID_HANDLE_VALUE;
+      mapping_handle = 0;
+#else
+      fd = -1;
+#endif
+      memset(header, 0, sizeof(header));
+    };
+
+    ~tiled_cache_file() {
+      close();
+    };
+
+    // creates a new file (replacing an existing one) and keeps it open for
+    // writing; all values are zero until written
+    bool create(const string &filename, int xn, int yn, int components, int omegan, int tile_points=TILED_CACHE_TILE_POINTS, int tile_omega=TILED_CACHE_TILE_OMEGA) {
+      close();
+
+      memset(header, 0, sizeof(header));
+      memcpy(header, "HHGCACHE", 8);
+      header[1] = TILED_CACHE_VERSION;
+      header[2] = xn;
+      header[3] = yn;
+      header[4] = components;
+      header[5] = omegan;
+      // small slices are not padded to the full tile size
+      header[6] = max(min(tile_points, xn*yn), 1);
+      header[7] = max(min(tile_omega, omegan), 1);
+
+      map_size = TILED_CACHE_HEADER_SIZE + (size_t)omega_blocks()*point_blocks()*tile_size()*sizeof(complex<double>);
+      if (!map_file(filename, true, true)) return false;
+
+      memcpy(map, header, sizeof(header));
+      return true;
+    };
+
+    // opens an existing file
+    bool open(const string &filename, bool writable=false) {
+      close();
+
+      if (!map_file(filename, false, writable)) return false;
+
+      memcpy(header, map, sizeof(header));
+      if (memcmp(header, "HHGCACHE", 8)) return fail(filename + " is not a tiled cache file");
+      if (header[1]!=TILED_CACHE_VERSION) return fail(filename + " has an unsupported format version");
+      if (map_size<TILED_CACHE_HEADER_SIZE + (size_t)omega_blocks()*point_blocks()*tile_size()*sizeof(complex<double>)) {
+        return fail(filename + " is truncated");
+      }
+
+      return true;
+    };
+
+    void close() {
+#ifdef _WIN32
+      if (map) UnmapViewOfFile(map);
+      if (mapping_handle) CloseHandle(mapping_handle);
+      if (file_handle!=INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+      mapping_handle = 0;
+      file_handle = INVALID_HANDLE_VALUE;
+#else
+      if (map) munmap(map, map_size);
+      if (fd>=0) ::close(fd);
+      fd = -1;
+#endif
+      map = 0;
+    };
+
+    int xn() const { return (int)header[2]; };
+    int yn() const { return (int)header[3]; };
+    int components() const { return (int)header[4]; };
+    int omegan() const { return (int)header[5]; };
+
+    bool finished() const {
+      return header[8]==1;
+    };
+
+    // marks the file as complete, after all data has been written to disk
+    bool set_finished() {
+      header[8] = 1;
+#ifdef _WIN32
+      if (!FlushViewOfFile(map, map_size)) return false;
+      memcpy(map, header, sizeof(header));
+      return FlushViewOfFile(map, TILED_CACHE_HEADER_SIZE)!=0;
+#else
+      if (msync(map, map_size, MS_SYNC)) return false;
+      memcpy(map, header, sizeof(header));
+      return msync(map, TILED_CACHE_HEADER_SIZE, MS_SYNC)==0;
+#endif
+    };
+
+    // stores the spectrum d_omega(C,omega_i) (component index fastest) of the
+    // point (xi, yi), with 0-based indices
+    void write_point(int xi, int yi, const complex<double> *d_omega) {
+      const int C = components(), tile_points = (int)header[6], tile_omega = (int)header[7];
+      const int p = yi + yn()*xi;
+
+      for (int ob=0; ob<omega_blocks(); ob++) {
+        complex<double> *run = tile(ob, p/tile_points) + (size_t)(p%tile_points)*C*tile_omega;
+        const int w_end = min(tile_omega, omegan()-ob*tile_omega);
+        for (int c=0; c<C; c++) {
+          for (int w=0; w<w_end; w++) run[c*tile_omega + w] = d_omega[c + C*(ob*tile_omega + w)];
+        }
+      }
+    };
+
+    // reads omega_count frequencies starting at omega_start (0-based) for all
+    // points into output(yi,xi,C,omega_i) (yi index fastest), which is the
+    // layout returned by hhgmax_cache_file_get_slice
+    void read_omega(int omega_start, int omega_count, complex<double> *output) const {
+      const int C = components(), tile_points = (int)header[6], tile_omega = (int)header[7];
+      const int points = xn()*yn();
+
+      for (int ob=omega_start/tile_omega; ob*tile_omega<omega_start+omega_count; ob++) {
+        const int w_begin = max(omega_start - ob*tile_omega, 0);
+        const int w_end = min(omega_start+omega_count - ob*tile_omega, tile_omega);
+
+        for (int pb=0; pb<point_blocks(); pb++) {
+          const complex<double> *data = tile(ob, pb);
+          const int p_end = min(tile_points, points-pb*tile_points);
+
+          for (int p_in=0; p_in<p_end; p_in++) {
+            const int p = pb*tile_points + p_in;
+            for (int c=0; c<C; c++) {
+              for (int w=w_begin; w<w_end; w++) {
+                output[p + points*(c + C*(ob*tile_omega + w - omega_start))] = data[(p_in*C + c)*tile_omega + w];
+              }
+            }
+          }
+        }
+      }
+    };
+
+    const string &get_error() const {
+      return error;
+    };
+};
+
+#endif // end of include guard
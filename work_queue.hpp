@@ -0,0 +1,253 @@
+// This file provides a work queue based on files in a shared directory, which
+// allows several processes (on one machine or on several nodes sharing a
+// file system) to divide work among themselves without a scheduler or network
+// service. Each work item is identified by a name, and for an item <name>,
+//   <name>.lease - exists while a worker computes the item; it contains the id
+//                  of the worker. It is written to a temporary file first and
+//                  then linked to its name, which fails if the lease exists,
+//                  so that only one worker can claim the item and the lease
+//                  is never seen half written. The worker renews the lease by
+//                  touching the file. Leases that were not renewed for
+//                  lease_seconds are considered expired, e.g. because the
+//                  worker crashed, and may be taken over by another worker.
+//                  A worker only proceeds, renews or releases a lease if the
+//                  file contains its id, so that a worker whose lease was
+//                  taken over does not remove the lease of its successor.
+//   <name>.dat - the result of the item, written to a temporary file first and
+//                then renamed, so that it appears atomically.
+// The clocks of all nodes must be roughly synchronized, and lease_seconds
+// must be longer than the time between two renewals.
+
+// include guard
+#ifndef WORK_QUEUE_HPP
+#define WORK_QUEUE_HPP
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+  #include <process.h>
+  #include <direct.h>
+  #include <sys/utime.h>
+  #include <windows.h>
+#else
+  #include <unistd.h>
+  #include <utime.h>
+#endif
+
+class work_queue {
+  private:
+    string directory;
+    int lease_seconds;
+    string worker_id;
+
+    string path(const string &name, const string &suffix) const {
+      return directory + "/" + name + suffix;
+    }
+
+    static bool exists(const string &filename, time_t *mtime=0) {
+      struct stat info;
+      if (stat(filename.c_str(), &info)) return false;
+      if (mtime) *mtime = info.st_mtime;
+      return true;
+    }
+
+    bool expired(time_t mtime) const {
+      return difftime(time(0), mtime)>=lease_seconds;
+    }
+
+    // moves the file to target only if target does not exist yet
+    static bool move_exclusive(const string &filename, const string &target) {
+#ifdef _WIN32
+      // rename does not replace existing files on Windows
+      return rename(filename.c_str(), target.c_str())==0;
+#else
+      // unlike open with O_EXCL, link is atomic on NFS, too
+      bool ok = link(filename.c_str(), target.c_str())==0;
+      remove(filename.c_str());
+      return ok;
+#endif
+    }
+
+    // creates a complete lease of this worker, only if the lease does not
+    // exist yet
+    bool write_lease(const string &lease) const {
+      string temp = lease + "." + worker_id;
+      FILE *fd = fopen(temp.c_str(), "wb");
+      if (!fd) return false;
+
+      string content = worker_id + "\n";
+      bool ok = fwrite(content.c_str(), 1, content.size(), fd)==content.size();
+      ok = fclose(fd)==0 && ok;
+
+      if (!ok || !move_exclusive(temp, lease)) {
+        remove(temp.c_str());
+        return false;
+      }
+      return true;
+    }
+
+    // returns the id of the worker holding the lease, or "" if there is none
+    static string owner(const string &lease) {
+      FILE *fd = fopen(lease.c_str(), "rb");
+      if (!fd) return "";
+
+      char buffer[512];
+      size_t n = fread(buffer, 1, sizeof(buffer)-1, fd);
+      fclose(fd);
+      buffer[n] = 0;
+      char *end = strchr(buffer, '\n');
+      if (end) *end = 0;
+      return buffer;
+    }
+
+  public:
+    work_queue(const string &dir, int lease) : directory(dir), lease_seconds(lease) {
+      char hostname[256] = "localhost";
+      int pid;
+#ifdef _WIN32
+      const char *computername = getenv("COMPUTERNAME");
+      if (computername) {
+        strncpy(hostname, computername, sizeof(hostname)-1);
+        hostname[sizeof(hostname)-1] = 0;
+      }
+      pid = _getpid();
+#else
+      gethostname(hostname, sizeof(hostname)-1);
+      pid = getpid();
+#endif
+      char id[320];
+      sprintf(id, "%s.%d", hostname, pid);
+      worker_id = id;
+    };
+
+    // creates the queue directory if necessary
+    bool init() {
+      if (exists(directory)) return true;
+#ifdef _WIN32
+      _mkdir(directory.c_str());
+#else
+      mkdir(directory.c_str(), 0777);
+#endif
+      return exists(directory);
+    };
+
+    const string &get_worker_id() const {
+      return worker_id;
+    };
+
+    // returns whether the result of the item was committed
+    bool is_done(const string &name) const {
+      return exists(path(name, ".dat"));
+    };
+
+    // returns whether the item is claimed by a worker whose lease has not
+    // expired yet
+    bool is_leased(const string &name) const {
+      time_t mtime;
+      return exists(path(name, ".lease"), &mtime) && !expired(mtime);
+    };
+
+    // returns whether this worker holds the lease of the item
+    bool holds(const string &name) const {
+      return owner(path(name, ".lease"))==worker_id;
+    };
+
+    // tries to claim the item; returns false if another worker holds it
+    bool claim(const string &name) {
+      string lease = path(name, ".lease");
+      if (write_lease(lease)) return holds(name);
+
+      // take over expired lease: only one worker succeeds in renaming it
+      time_t mtime;
+      if (!exists(lease, &mtime) || !expired(mtime)) return false;
+      string stale = path(name, ".stale." + worker_id);
+      if (rename(lease.c_str(), stale.c_str())) return false;
+
+      // between the check and the rename, another worker may have taken over
+      // the lease already; then, its fresh lease is put back
+      if (!exists(stale, &mtime) || !expired(mtime)) {
+        if (!move_exclusive(stale, lease)) remove(stale.c_str());
+        return false;
+      }
+      remove(stale.c_str());
+
+      // another worker may have created a lease after the rename
+      write_lease(lease);
+      return holds(name);
+    };
+
+    // does nothing if the lease was taken over; if that happens right after
+    // the check, only the fresh lease of the new owner is touched
+    void renew(const string &name) {
+      if (holds(name)) utime(path(name, ".lease").c_str(), 0);
+    };
+
+    // the lease is renamed before checking its owner, so that a lease taken
+    // over in the meantime is put back instead of removed
+    void release(const string &name) {
+      string lease = path(name, ".lease");
+      string released = path(name, ".released." + worker_id);
+      if (rename(lease.c_str(), released.c_str())) return;
+      if (owner(released)!=worker_id && move_exclusive(released, lease)) return;
+      remove(released.c_str());
+    };
+
+    // stores the result of the item atomically
+    bool commit(const string &name, const void *data, size_t size) {
+      string temp = path(name, ".part." + worker_id);
+      FILE *fd = fopen(temp.c_str(), "wb");
+      if (!fd) return false;
+
+      bool ok = fwrite(data, 1, size, fd)==size;
+      ok = fclose(fd)==0 && ok;
+
+#ifdef _WIN32
+      // rename does not replace existing files on Windows; if the result
+      // exists, another worker computed the same item after a lease timeout
+      if (ok && exists(path(name, ".dat"))) {
+        remove(temp.c_str());
+        return true;
+      }
+#endif
+      if (!ok || rename(temp.c_str(), path(name, ".dat").c_str())) {
+        remove(temp.c_str());
+        return false;
+      }
+      return true;
+    };
+
+    // reads the committed result of the item
+    bool read(const string &name, vector<char> &data) const {
+      FILE *fd = fopen(path(name, ".dat").c_str(), "rb");
+      if (!fd) return false;
+
+      data.clear();
+      char buffer[65536];
+      size_t n;
+      while ((n = fread(buffer, 1, sizeof(buffer), fd))>0) data.insert(data.end(), buffer, buffer+n);
+      fclose(fd);
+      return true;
+    };
+
+    // deletes the result of the item
+    void discard(const string &name) {
+      remove(path(name, ".dat").c_str());
+    };
+
+    static void wait(int seconds) {
+#ifdef _WIN32
+      Sleep(seconds*1000);
+#else
+      sleep(seconds);
+#endif
+    };
+};
+
+#endif // end of include guard